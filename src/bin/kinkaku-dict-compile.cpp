@@ -0,0 +1,89 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku.h>
+
+using namespace std;
+using namespace kinkaku;
+
+void printUsage() {
+    cerr << 
+"kinkaku-dict-compile:" << endl << 
+"  Compile dictionaries into a binary file that can be mapped into memory" << endl <<
+"" << endl <<
+"Usage: kinkaku-dict-compile [OPTIONS] OUTPUT DICT [DICT ...]" << endl <<
+"" << endl <<
+"Options: " << endl <<
+"  -model   Number characters the same as this model, so the compiled" << endl <<
+"           dictionary can be used as-is when analyzing with it" << endl <<
+"  -encode  The text encoding of the dictionaries (utf8/euc/sjis; default: utf8)" << endl <<
+"  -numtags The number of tags in each entry (default: that of -model)" << endl <<
+"  -debug   The debugging level (0=silent, 1=normal)" << endl << endl;
+    exit(1);
+}
+
+int main(int argc, const char **argv) {
+
+#ifndef KINKAKU_SAFE
+    try {
+#endif
+        KinkakuConfig * config = new KinkakuConfig;
+        config->setDebug(0);
+        config->setOnTraining(false);
+        const char * model = 0;
+        int numTags = -1;
+        vector<string> args;
+        for(int i = 1; i < argc; i++) {
+            if(argv[i][0] != '-') { args.push_back(argv[i]); continue; }
+            if(i == argc-1) printUsage();
+            if(!strcmp(argv[i], "-model"))        model = argv[++i];
+            else if(!strcmp(argv[i], "-encode"))  config->setEncoding(argv[++i]);
+            else if(!strcmp(argv[i], "-numtags")) numTags = atoi(argv[++i]);
+            else if(!strcmp(argv[i], "-debug"))   config->setDebug(atoi(argv[++i]));
+            else printUsage();
+        }
+        if(args.size() < 2)
+            printUsage();
+
+        Kinkaku kinkaku(config);
+        if(model)
+            kinkaku.readModel(model);
+        if(numTags >= 0)
+            config->setNumTags(numTags);
+        kinkaku.compileDictionary(vector<string>(args.begin()+1, args.end()), args[0]);
+        return 0;
+#ifndef KINKAKU_SAFE
+    } catch (exception &e) {
+        cerr << endl;
+        cerr << " Kinkaku Error: " << e.what() << endl;
+        return 1;
+    }
+#endif
+}
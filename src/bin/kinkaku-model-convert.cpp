@@ -0,0 +1,85 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku.h>
+#include <kinkaku/model-io.h>
+
+using namespace std;
+using namespace kinkaku;
+
+void printUsage() {
+    cerr << 
+"kinkaku-model-convert:" << endl << 
+"  Write a binary model in the mapped or compact format, or back again" << endl <<
+"" << endl <<
+"Usage: kinkaku-model-convert [OPTIONS] INPUT OUTPUT" << endl <<
+"" << endl <<
+"Options: " << endl <<
+"  -modbin  Write a binary model (default)" << endl <<
+"  -modmap  Write a binary model that can be mapped into memory when loaded" << endl <<
+"  -modcompact Write a small binary model for distribution" << endl <<
+"  -debug   The debugging level (0=silent, 1=normal)" << endl << endl;
+    exit(1);
+}
+
+int main(int argc, const char **argv) {
+
+#ifndef KINKAKU_SAFE
+    try {
+#endif
+        KinkakuConfig * config = new KinkakuConfig;
+        config->setDebug(0);
+        config->setOnTraining(false);
+        ModelIO::Format form = ModelIO::FORMAT_BINARY;
+        vector<string> args;
+        for(int i = 1; i < argc; i++) {
+            if(argv[i][0] != '-') { args.push_back(argv[i]); continue; }
+            if(!strcmp(argv[i], "-modbin"))       form = ModelIO::FORMAT_BINARY;
+            else if(!strcmp(argv[i], "-modmap"))  form = ModelIO::FORMAT_MAPPED;
+            else if(!strcmp(argv[i], "-modcompact")) form = ModelIO::FORMAT_COMPACT;
+            else if(!strcmp(argv[i], "-debug") && i != argc-1) config->setDebug(atoi(argv[++i]));
+            else printUsage();
+        }
+        if(args.size() != 2)
+            printUsage();
+
+        Kinkaku kinkaku(config);
+        kinkaku.readModel(args[0].c_str());
+        config->setModelFormat(form);
+        kinkaku.writeModel(args[1].c_str());
+        return 0;
+#ifndef KINKAKU_SAFE
+    } catch (exception &e) {
+        cerr << endl;
+        cerr << " Kinkaku Error: " << e.what() << endl;
+        return 1;
+    }
+#endif
+}
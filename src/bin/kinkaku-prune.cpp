@@ -0,0 +1,175 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku.h>
+#include <kinkaku/kinkaku-eval.h>
+#include <kinkaku/model-io.h>
+
+using namespace std;
+using namespace kinkaku;
+
+void printUsage() {
+    cerr << 
+"kinkaku-prune:" << endl << 
+"  Remove small weights from a trained model, and measure the smaller" << endl <<
+"  model's size, speed and accuracy" << endl <<
+"" << endl <<
+"Usage: kinkaku-prune [OPTIONS] INPUT OUTPUT" << endl <<
+"" << endl <<
+"Options: " << endl <<
+"  -threshold  Remove weights whose quantized magnitude is below this" << endl <<
+"  -topk       Keep only this many of the largest weights of each model" << endl <<
+"  -eval       A corpus in full format to measure speed and accuracy on" << endl <<
+"  -modbin     Write a binary model (default)" << endl <<
+"  -modmap     Write a binary model that can be mapped into memory when loaded" << endl <<
+"  -modcompact Write a small binary model for distribution" << endl <<
+"  -debug      The debugging level (0=silent, 1=normal)" << endl << endl <<
+"-threshold and -topk can be given several times, in which case each model" << endl <<
+"is written to OUTPUT.tTHRESHOLD or OUTPUT.kTOPK" << endl << endl;
+    exit(1);
+}
+
+class PruneSetting {
+public:
+    PruneSetting(double t, unsigned k) : threshold(t), topK(k) { }
+    double threshold;
+    unsigned topK;
+    string getName() const {
+        ostringstream oss;
+        if(topK) oss << "k" << topK;
+        else oss << "t" << threshold;
+        return oss.str();
+    }
+};
+
+double getTime() {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+long getFileSize(const string & file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 ? (long)st.st_size : -1;
+}
+
+void printResult(const string & name, size_t removed, const string & file, double loadTime, const KinkakuEvalResult * res) {
+    cout << name << "\t" << removed << "\t" << getFileSize(file) << "\t" << fixed << setprecision(3) << loadTime;
+    if(res) {
+        cout << "\t" << setprecision(0) << (res->seconds > 0 ? res->chars/res->seconds : 0)
+             << "\t" << setprecision(4) << res->getBoundaryAccuracy();
+        for(unsigned i = 0; i < res->tags.size(); i++)
+            cout << "\t" << res->getTagAccuracy(i);
+    }
+    cout << endl;
+    cout.unsetf(ios::floatfield);
+}
+
+Kinkaku * createKinkaku(int debug) {
+    KinkakuConfig * config = new KinkakuConfig;
+    config->setDebug(debug);
+    config->setOnTraining(false);
+    return new Kinkaku(config);
+}
+
+// Load a model, timing the load, and evaluate it on the corpus if there is one
+void measureModel(const string & name, size_t removed, const string & file, const string & evalFile, int debug) {
+    Kinkaku * kinkaku = createKinkaku(debug);
+    double start = getTime();
+    kinkaku->readModel(file.c_str());
+    double loadTime = getTime() - start;
+    KinkakuEvalResult res;
+    if(evalFile.length())
+        evaluateCorpus(*kinkaku, evalFile, res);
+    printResult(name, removed, file, loadTime, evalFile.length() ? &res : 0);
+    delete kinkaku;
+}
+
+int main(int argc, const char **argv) {
+
+#ifndef KINKAKU_SAFE
+    try {
+#endif
+        ModelIO::Format form = ModelIO::FORMAT_BINARY;
+        int debug = 0;
+        string evalFile;
+        vector<PruneSetting> settings;
+        vector<string> args;
+        for(int i = 1; i < argc; i++) {
+            if(argv[i][0] != '-') { args.push_back(argv[i]); continue; }
+            if(!strcmp(argv[i], "-modbin"))       form = ModelIO::FORMAT_BINARY;
+            else if(!strcmp(argv[i], "-modmap"))  form = ModelIO::FORMAT_MAPPED;
+            else if(!strcmp(argv[i], "-modcompact")) form = ModelIO::FORMAT_COMPACT;
+            else if(!strcmp(argv[i], "-threshold") && i != argc-1) settings.push_back(PruneSetting(atof(argv[++i]), 0));
+            else if(!strcmp(argv[i], "-topk") && i != argc-1 && atoi(argv[i+1]) > 0) settings.push_back(PruneSetting(0, atoi(argv[++i])));
+            else if(!strcmp(argv[i], "-eval") && i != argc-1) evalFile = argv[++i];
+            else if(!strcmp(argv[i], "-debug") && i != argc-1) debug = atoi(argv[++i]);
+            else printUsage();
+        }
+        if(args.size() != 2 || settings.size() == 0)
+            printUsage();
+
+        cout << "setting\tremoved\tbytes\tload_sec";
+        if(evalFile.length()) {
+            cout << "\tchars_per_sec\tboundary_acc";
+            Kinkaku * kinkaku = createKinkaku(debug);
+            kinkaku->readModel(args[0].c_str());
+            for(int i = 0; i < kinkaku->getConfig()->getNumTags(); i++)
+                cout << "\ttag" << i+1 << "_acc";
+            delete kinkaku;
+        }
+        cout << endl;
+        measureModel("none", 0, args[0], evalFile, debug);
+
+        for(unsigned i = 0; i < settings.size(); i++) {
+            string outFile = args[1];
+            if(settings.size() > 1)
+                outFile += "." + settings[i].getName();
+            Kinkaku * kinkaku = createKinkaku(debug);
+            kinkaku->readModel(args[0].c_str());
+            size_t removed = kinkaku->pruneModel(settings[i].threshold, settings[i].topK);
+            kinkaku->getConfig()->setModelFormat(form);
+            kinkaku->writeModel(outFile.c_str());
+            delete kinkaku;
+            measureModel(settings[i].getName(), removed, outFile, evalFile, debug);
+        }
+        return 0;
+#ifndef KINKAKU_SAFE
+    } catch (exception &e) {
+        cerr << endl;
+        cerr << " Kinkaku Error: " << e.what() << endl;
+        return 1;
+    }
+#endif
+}
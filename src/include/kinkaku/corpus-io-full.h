@@ -39,6 +39,8 @@ protected:
 	bool allTags_;
 	KinkakuString bounds_;
 	bool printWords_;
+	// the line being written, kept to reuse its storage
+	std::string line_;
 
 public:
 
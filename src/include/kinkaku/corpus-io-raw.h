@@ -33,6 +33,10 @@ namespace kinkaku {
 
 class RawCorpusIO : public CorpusIO {
 
+private:
+
+	std::string line_;
+
 public:
 
 	RawCorpusIO(StringUtil * util) : CorpusIO(util) { }
@@ -41,6 +45,7 @@ public:
 	RawCorpusIO(StringUtil * util, std::iostream & str, bool out) : CorpusIO(util,str,out) { }
 
 	KinkakuSentence * readSentence();
+	bool readSentence(KinkakuSentence & sent);
 	void writeSentence(const KinkakuSentence * sent, double conf = 0.0);
 
 };
@@ -78,6 +78,9 @@ public:
 	static CorpusIO* createIO(std::iostream & str, Format form, const KinkakuConfig & conf, bool output, StringUtil* util);
 
 	virtual KinkakuSentence * readSentence() = 0;
+	// Read the next sentence into sent, reusing its storage where the
+	// format allows, and return false at the end of the input
+	virtual bool readSentence(KinkakuSentence & sent);
 	virtual void writeSentence(const KinkakuSentence * sent, double conf = 0.0) = 0;
 
 	void setUnkTag(const std::string & tag) { unkTag_ = tag; }
@@ -30,12 +30,102 @@
 #include <kinkaku/kinkaku-string.h>
 #include <kinkaku/string-util.h>
 #include <map>
-#include <deque>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <algorithm>
 
 namespace kinkaku  {
 
 class KinkakuModel;
 class KinkakuString;
+class MappedFile;
+class MappedArena;
+
+// The values of one field of a dictionary entry, such as its tags on
+// one level. Like FeatVec, it either owns its values or is a view of a
+// range of values stored elsewhere, here the pool that compactEntries
+// makes for the entries of a dictionary, and views are copied before
+// they grow. Views may be written through operator[], as the pool
+// belongs to the dictionary and is never part of a mapped file.
+template <class T>
+class EntryVec {
+
+public:
+
+	EntryVec() : data_(0), size_(0), capacity_(0) { }
+	EntryVec(T * data, unsigned n) : data_(data), size_(n), capacity_(0) { }
+	EntryVec(const EntryVec & rhs) : data_(0), size_(0), capacity_(0) {
+		assign(rhs.data_, rhs.size_);
+	}
+	~EntryVec() {
+		if(capacity_) delete [] data_;
+	}
+
+	EntryVec & operator=(const EntryVec & rhs) {
+		if(this != &rhs) {
+			size_ = 0;
+			assign(rhs.data_, rhs.size_);
+		}
+		return *this;
+	}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	size_t capacity() const { return capacity_; }
+	bool isView() const { return data_ && !capacity_; }
+
+	T & operator[](size_t i) { return data_[i]; }
+	const T & operator[](size_t i) const { return data_[i]; }
+	T * data() { return data_; }
+	const T * data() const { return data_; }
+	T * begin() { return data_; }
+	T * end() { return data_+size_; }
+	const T * begin() const { return data_; }
+	const T * end() const { return data_+size_; }
+
+	void reserve(size_t n) {
+		if(n <= capacity_ || n <= size_) return;
+		T * next = new T[n];
+		std::copy(data_, data_+size_, next);
+		if(capacity_) delete [] data_;
+		data_ = next;
+		capacity_ = n;
+	}
+	void resize(size_t n, const T & val = T()) {
+		if(n > size_) {
+			reserve(n);
+			std::fill(data_+size_, data_+n, val);
+		}
+		size_ = n;
+	}
+	void push_back(const T & val) {
+		if(size_ >= capacity_)
+			reserve(size_ ? size_*2 : 1);
+		data_[size_++] = val;
+	}
+	void clear() {
+		if(!capacity_) data_ = 0;
+		size_ = 0;
+	}
+	void swap(EntryVec & rhs) {
+		std::swap(data_, rhs.data_);
+		std::swap(size_, rhs.size_);
+		std::swap(capacity_, rhs.capacity_);
+	}
+
+private:
+
+	void assign(const T * data, size_t n) {
+		reserve(n);
+		std::copy(data, data+n, data_);
+		size_ = n;
+	}
+
+	T * data_;
+	unsigned size_, capacity_;
+
+};
 
 class TagEntry {
 public:
@@ -44,8 +134,8 @@ public:
 	virtual ~TagEntry() { }
 
 	KinkakuString word;
-	std::vector< std::vector<KinkakuString> > tags;
-	std::vector< std::vector<unsigned char> > tagInDicts;
+	EntryVec< EntryVec<KinkakuString> > tags;
+	EntryVec< EntryVec<unsigned char> > tagInDicts;
 	unsigned char inDict;
 
 	virtual void setNumTags(int i) {
@@ -74,7 +164,9 @@ class ModelTagEntry : public TagEntry {
 
 public:
 
-	ModelTagEntry(const KinkakuString & str) : TagEntry(str) { }
+	static const unsigned NO_MODEL_SLOT = (unsigned)-1;
+
+	ModelTagEntry(const KinkakuString & str) : TagEntry(str), modelSlot(NO_MODEL_SLOT) { }
 	~ModelTagEntry();
 
 	void setNumTags(int i) {
@@ -83,6 +175,9 @@ public:
 	}
 
 	std::vector<KinkakuModel *> tagMods;
+	// for models read from a file, the first of the entry's slots in the
+	// LocalModelTable, with tagMods left empty
+	unsigned modelSlot;
 
 };
 
@@ -100,33 +195,41 @@ public:
 		probs.resize(i);
 	}
 
-	std::vector< std::vector< double > > probs;
+	EntryVec< EntryVec< double > > probs;
 
 };
 
+// states with at least this many gotos (and the root, with any number) are
+// given a dense table directly indexed by character, as long as their
+// character range is no more than DICTIONARY_DENSE_RATIO times the number
+// of gotos
+#define DICTIONARY_DENSE_FANOUT 16
+#define DICTIONARY_DENSE_RATIO 8
+
+// levels of the trie with fewer states than this are linked serially
+#define DICTIONARY_PARALLEL_MIN 4096
+
+// The gotos of each state are a range in an array shared by the whole
+// dictionary, and dense is an offset into the dense goto tables (0 if the
+// state uses only the sorted gotos). A state only stores its own entry
+// (output, if isBranch) and outputLink, the nearest state on its failure
+// chain that has an entry (0 if there is none). States are written to
+// files as they are, so this is an aggregate with no padding, and every
+// byte of a value-initialized state is zero.
 class DictionaryState {
 
 public:
 
-	DictionaryState() : failure(0), gotos(), output(), isBranch(false) { }
-	typedef std::vector< std::pair< KinkakuChar, unsigned> > Gotos;
 	unsigned failure;
-	Gotos gotos;
-	std::vector< unsigned > output;
+	unsigned gotoBegin, gotoEnd;
+	unsigned output, outputLink;
+	unsigned dense;
+	KinkakuChar denseBase;
 	bool isBranch;
+	// fills the last byte, and is always 0
+	unsigned char reserved;
 
-	inline unsigned step(KinkakuChar input) {
-		Gotos::const_iterator l=gotos.begin(), r=gotos.end(), m;
-		KinkakuChar check;
-		while(r != l) {
-			m = l+std::distance(l,r)/2;
-			check = m->first;
-			if(input<check) r=m;
-			else if(input>check) l=m+1;
-			else return m->second;
-		}
-		return 0;
-	}
+	unsigned numGotos() const { return gotoEnd-gotoBegin; }
 
 };
 
@@ -136,22 +239,64 @@ class Dictionary {
 public:
 
 	typedef std::map<KinkakuString, Entry*> WordMap;
-	typedef typename WordMap::const_iterator wm_const_iterator;
+	typedef std::vector< std::pair<KinkakuString, Entry*> > WordList;
+	typedef std::vector< std::pair< KinkakuChar, unsigned> > Gotos;
 	typedef std::vector< std::pair<unsigned,Entry*> > MatchResult;
 
 private:
 
 	StringUtil * util_;
-	std::vector<DictionaryState*> states_;
+	std::vector<DictionaryState> states_;
+	Gotos gotos_;
+	std::vector<unsigned> dense_;
 	std::vector<Entry*> entries_;
 	unsigned char numDicts_;
 
-	void buildGoto(wm_const_iterator start, wm_const_iterator end, unsigned lev, unsigned nid);
-	void buildFailures();
+	// the arrays used for lookup, which point either to the vectors above
+	// or into a mapped file (in which case those are empty)
+	const DictionaryState * stateArr_;
+	const std::pair<KinkakuChar,unsigned> * gotoArr_;
+	const unsigned * denseArr_;
+	unsigned numStates_, numGotos_, numDense_;
+	MappedFile * mapped_;
+	// the bytes of the arena block that the arrays were packed into
+	size_t packedSize_;
+	// entries allocated together, which are not deleted one by one
+	Entry * entryBlock_;
+
+	// The block that compactEntries moved the values of the entries'
+	// vectors into, and the entries themselves if it was given an arena,
+	// with the objects made there that are destroyed with it
+	class EntryPool {
+	public:
+		EntryPool() : block(0), size(0), entries(0), numEntries(0), tagLevels(0), numTagLevels(0), inDictLevels(0), numInDictLevels(0), probLevels(0), numProbLevels(0), tags(0), numTags(0) { }
+		MappedFile * block;
+		size_t size;
+		Entry * entries;
+		unsigned numEntries;
+		EntryVec<KinkakuString> * tagLevels;
+		unsigned numTagLevels;
+		EntryVec<unsigned char> * inDictLevels;
+		unsigned numInDictLevels;
+		EntryVec<double> * probLevels;
+		unsigned numProbLevels;
+		KinkakuString * tags;
+		unsigned numTags;
+		bool hasEntry(const Entry * ent) const { return ent >= entries && ent < entries+numEntries; }
+	};
+	EntryPool pool_;
+
+	void buildGotos(const WordList & input, std::vector<unsigned> & levels);
+	void buildFailures(const std::vector<unsigned> & levels);
+	void buildDense(unsigned state, bool force);
+	void updateArrays();
+	void unmap();
+	bool checkArrays(unsigned numEntries) const;
+	static void clearPool(EntryPool & pool);
 
 public:
 
-	Dictionary(StringUtil * util) : util_(util), numDicts_(0) { };
+	Dictionary(StringUtil * util) : util_(util), numDicts_(0), stateArr_(0), gotoArr_(0), denseArr_(0), numStates_(0), numGotos_(0), numDense_(0), mapped_(0), packedSize_(0), entryBlock_(0) { };
 	void clearData();
 
 	~Dictionary() {
@@ -159,18 +304,83 @@ public:
 	};
 
 	void buildIndex(const WordMap & input);
+	void buildIndex(WordList & input);
+	void buildDenseGotos();
+	void buildOutputLinks();
+
+	// Move the tags (and their dictionary flags and probabilities) of all
+	// entries into one pool, leaving each entry's vectors views of it, and
+	// share one copy of each distinct tag string. Given an arena, the pool
+	// is taken from it and the entries are moved there too.
+	void compactEntries(MappedArena * arena = 0, bool hugePages = false);
+	size_t getMemoryUsage() const;
+	// the memory of the entries and their pool
+	size_t getEntryMemoryUsage() const;
+	static size_t getEntryMemoryUsage(const std::vector<Entry*> & entries);
 	void print();
 
-	const Entry * findEntry(KinkakuString str) const;
-	Entry * findEntry(KinkakuString str);
+	// Write the finished automaton and its entries to a binary file that
+	// readCompiled() maps into memory and uses without rebuilding
+	void writeCompiled(const std::string & file) const;
+	void readCompiled(const std::string & file);
+	static bool isCompiled(const std::string & file);
+	bool isMapped() const { return mapped_ != 0; }
+
+	// Use an automaton stored in a mapped file as-is, keeping the file
+	// open until the dictionary is cleared
+	void setMappedArrays(MappedFile * file, const DictionaryState * states, unsigned numStates, const std::pair<KinkakuChar,unsigned> * gotos, unsigned numGotos, const unsigned * dense, unsigned numDense);
+	// Take ownership of entries allocated with new[]
+	void setEntryBlock(Entry * block, unsigned numEntries);
+	// Move the automaton into a single arena block, with extra bytes after
+	// it (8-byte aligned) that are returned for the caller to fill. The
+	// block is taken from arena, shared with the rest of the model, or
+	// allocated alone if there is none.
+	char * packArrays(size_t extra, MappedArena * arena, bool hugePages);
+	// Copy the automaton with its padding zeroed, for writing to files
+	void getPackedArrays(std::vector<DictionaryState> & states, Gotos & gotos) const;
+	// Recover the words and entries from the automaton in sorted order,
+	// which works for dictionaries that do not store their keys
+	void getWordList(WordList & list) const;
+
+	inline unsigned step(unsigned state, KinkakuChar input) const {
+		const DictionaryState & st = stateArr_[state];
+		if(st.dense) {
+			unsigned pos = (unsigned)(KinkakuChar)(input-st.denseBase);
+			return pos < denseArr_[st.dense-1] ? denseArr_[st.dense+pos] : 0;
+		}
+		const std::pair<KinkakuChar,unsigned> *l=gotoArr_+st.gotoBegin, *r=gotoArr_+st.gotoEnd, *m;
+		KinkakuChar check;
+		while(r != l) {
+			m = l+(r-l)/2;
+			check = m->first;
+			if(input<check) r=m;
+			else if(input>check) l=m+1;
+			else return m->second;
+		}
+		return 0;
+	}
+
+	const Entry * findEntry(const KinkakuStringView & str) const;
+	Entry * findEntry(const KinkakuStringView & str);
 	unsigned getTagID(KinkakuString str, KinkakuString tag, int lev);
 
-	MatchResult match( const KinkakuString & chars ) const;
+	MatchResult match( const KinkakuStringView & chars ) const;
+	// the same, filling ret so that its storage can be reused
+	void match( const KinkakuStringView & chars, MatchResult & ret ) const;
 
 	std::vector<Entry*> & getEntries() { return entries_; }
-	std::vector<DictionaryState*> & getStates() { return states_; }
+	std::vector<DictionaryState> & getStates() { return states_; }
+	Gotos & getGotos() { return gotos_; }
 	const std::vector<Entry*> & getEntries() const { return entries_; }
-	const std::vector<DictionaryState*> & getStates() const { return states_; }
+	const std::vector<DictionaryState> & getStates() const { return states_; }
+	const Gotos & getGotos() const { return gotos_; }
+	unsigned getNumStates() const { return numStates_; }
+	unsigned getNumGotos() const { return numGotos_; }
+	unsigned getNumDense() const { return numDense_; }
+	const DictionaryState * getStateArray() const { return stateArr_; }
+	const std::pair<KinkakuChar,unsigned> * getGotoArray() const { return gotoArr_; }
+	const unsigned * getDenseArray() const { return denseArr_; }
+	bool isDense(unsigned state) const { return stateArr_[state].dense != 0; }
 	unsigned char getNumDicts() const { return numDicts_; }
 	void setNumDicts(unsigned char numDicts) { numDicts_ = numDicts; }
 	void checkEqual(const Dictionary<Entry> & rhs) const;
@@ -36,6 +36,8 @@ namespace kinkaku {
 
 class KinkakuString;
 class ModelTagEntry;
+class MappedFile;
+class StringUtil;
 
 class FeatureLookup {
 
@@ -43,28 +45,45 @@ protected:
 
 	Dictionary<FeatVec> *charDict_, *typeDict_, *selfDict_;
 	FeatVec *dictVector_, *biases_, *tagDictVector_, *tagUnkVector_;
+	// the file that the vectors are views of, if any
+	MappedFile * mapped_;
 
 public:
 
-	FeatureLookup() : charDict_(NULL), typeDict_(NULL), selfDict_(NULL), dictVector_(NULL), biases_(NULL), tagDictVector_(NULL), tagUnkVector_(NULL) { }
+	FeatureLookup() : charDict_(NULL), typeDict_(NULL), selfDict_(NULL), dictVector_(NULL), biases_(NULL), tagDictVector_(NULL), tagUnkVector_(NULL), mapped_(NULL) { }
 	~FeatureLookup();
 
 	void checkEqual(const FeatureLookup & rhs) const;
 
+	// the heap memory of the dictionaries and vectors, not counting arrays
+	// used in place from a mapped file
+	size_t getMemoryUsage() const;
+
+	// Zero the n-gram weights whose magnitude is below threshold, or
+	// outside the topK largest if topK is not 0, and rebuild the n-gram
+	// dictionaries without the entries left with no weights. Returns the
+	// number of weights removed.
+	size_t pruneNgrams(StringUtil * util, double threshold, unsigned topK);
+
 	const Dictionary<FeatVec> * getCharDict() const { return charDict_; }
 	const Dictionary<FeatVec> * getTypeDict() const { return typeDict_; }
 	const Dictionary<FeatVec> * getSelfDict() const { return selfDict_; }
 	const FeatVec * getDictVector() const { return dictVector_; }
 	const FeatVal getBias(int id) const { return (*biases_)[id]; }
-	const std::vector<FeatVal> * getBiases() const { return biases_; }
+	const FeatVec * getBiases() const { return biases_; }
 	const FeatVal getTagUnkFeat(int tag) const { return (*tagUnkVector_)[tag]; }
-	const std::vector<FeatVal> * getTagDictVector() const { return tagDictVector_; }
-	const std::vector<FeatVal> * getTagUnkVector() const { return tagUnkVector_; }
+	const FeatVec * getTagDictVector() const { return tagDictVector_; }
+	const FeatVec * getTagUnkVector() const { return tagUnkVector_; }
 
 	void addNgramScores(const Dictionary<FeatVec> * dict, const KinkakuString & str, int window, std::vector<FeatSum> & score);
 	void addDictionaryScores(const Dictionary<ModelTagEntry>::MatchResult & matches, int numDicts, int max, std::vector<FeatSum> & score);
 	void addTagNgrams(const KinkakuString & chars, const Dictionary<FeatVec> * dict, std::vector<FeatSum> & scores, int window, int startChar, int endChar);
-	void addSelfWeights(const KinkakuString & chars, std::vector<FeatSum> & scores, int isType);
+	// the same, with the buffers given at the end used as working
+	// storage so that repeated calls do not allocate
+	void addNgramScores(const Dictionary<FeatVec> * dict, const KinkakuString & str, int window, std::vector<FeatSum> & score, Dictionary<FeatVec>::MatchResult & matches);
+	void addDictionaryScores(const Dictionary<ModelTagEntry>::MatchResult & matches, int numDicts, int max, std::vector<FeatSum> & score, std::vector<char> & on);
+	void addTagNgrams(const KinkakuString & chars, const Dictionary<FeatVec> * dict, std::vector<FeatSum> & scores, int window, int startChar, int endChar, KinkakuString & context, Dictionary<FeatVec>::MatchResult & matches);
+	void addSelfWeights(const KinkakuStringView & chars, std::vector<FeatSum> & scores, int isType);
 	void addTagDictWeights(const std::vector<std::pair<int,int> > & exists, std::vector<FeatSum> & scores);
 	void setCharDict(Dictionary<FeatVec> * charDict) { charDict_ = charDict; }
 	void setTypeDict(Dictionary<FeatVec> * typeDict) { typeDict_ = typeDict; }
@@ -80,6 +99,7 @@ public:
 	void setBiases(FeatVec * biases) { biases_ = biases; }
 	void setTagDictVector(FeatVec * tagDictVector) { tagDictVector_ = tagDictVector; }
 	void setTagUnkVector(FeatVec * tagUnkVector) { tagUnkVector_ = tagUnkVector; }
+	void setMappedFile(MappedFile * mapped);
 
 };
 
@@ -29,6 +29,8 @@
 
 #include <kinkaku/config.h>
 #include <stdint.h>
+#include <cstddef>
+#include <algorithm>
 
 namespace kinkaku {
 
@@ -39,7 +41,97 @@ namespace kinkaku {
 	typedef int16_t FeatVal;
 	typedef int32_t FeatSum;
 #endif
-	typedef std::vector<FeatVal> FeatVec;
+
+// A vector of feature weights. Besides owning its values like a
+// std::vector, it can be a view of values stored elsewhere, such as a
+// weight pool in a mapped model, in which case the values are copied
+// before the vector grows. Views must not be written through operator[].
+class FeatVec {
+
+public:
+
+	FeatVec() : data_(0), size_(0), capacity_(0) { }
+	explicit FeatVec(size_t n, FeatVal val = 0) : data_(0), size_(0), capacity_(0) {
+		resize(n, val);
+	}
+	FeatVec(const FeatVal * data, size_t n) : data_(const_cast<FeatVal*>(data)), size_(n), capacity_(0) { }
+	FeatVec(const FeatVec & rhs) : data_(0), size_(0), capacity_(0) {
+		assign(rhs.data_, rhs.size_);
+	}
+	~FeatVec() {
+		if(capacity_) delete [] data_;
+	}
+
+	FeatVec & operator=(const FeatVec & rhs) {
+		if(this != &rhs) {
+			size_ = 0;
+			assign(rhs.data_, rhs.size_);
+		}
+		return *this;
+	}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	size_t capacity() const { return capacity_; }
+	bool isView() const { return data_ && !capacity_; }
+
+	FeatVal & operator[](size_t i) { return data_[i]; }
+	const FeatVal & operator[](size_t i) const { return data_[i]; }
+	FeatVal * data() { return data_; }
+	const FeatVal * data() const { return data_; }
+	FeatVal * begin() { return data_; }
+	FeatVal * end() { return data_+size_; }
+	const FeatVal * begin() const { return data_; }
+	const FeatVal * end() const { return data_+size_; }
+
+	void reserve(size_t n) {
+		if(n <= capacity_ || n <= size_) return;
+		FeatVal * next = new FeatVal[n];
+		std::copy(data_, data_+size_, next);
+		if(capacity_) delete [] data_;
+		data_ = next;
+		capacity_ = n;
+	}
+	void resize(size_t n, FeatVal val = 0) {
+		if(n > size_) {
+			reserve(n);
+			std::fill(data_+size_, data_+n, val);
+		}
+		size_ = n;
+	}
+	void push_back(FeatVal val) {
+		if(size_ >= capacity_)
+			reserve(size_ ? size_*2 : 4);
+		data_[size_++] = val;
+	}
+	void shrink() {
+		if(capacity_ <= size_) return;
+		FeatVec(*this).swap(*this);
+	}
+	void swap(FeatVec & rhs) {
+		std::swap(data_, rhs.data_);
+		std::swap(size_, rhs.size_);
+		std::swap(capacity_, rhs.capacity_);
+	}
+
+	bool operator==(const FeatVec & rhs) const {
+		return size_ == rhs.size_ && std::equal(data_, data_+size_, rhs.data_);
+	}
+	bool operator!=(const FeatVec & rhs) const { return !(*this == rhs); }
+
+private:
+
+	void assign(const FeatVal * data, size_t n) {
+		reserve(n);
+		std::copy(data, data+n, data_);
+		size_ = n;
+	}
+
+	FeatVal * data_;
+	size_t size_, capacity_;
+
+};
+
 }
 
 #endif
\ No newline at end of file
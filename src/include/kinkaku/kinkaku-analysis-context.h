@@ -0,0 +1,75 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef KINKAKU_ANALYSIS_CONTEXT_H__
+#define KINKAKU_ANALYSIS_CONTEXT_H__
+
+#include <kinkaku/kinkaku-struct.h>
+#include <kinkaku/feature-vector.h>
+#include <kinkaku/dictionary.h>
+#include <kinkaku/corpus-io.h>
+#include <string>
+#include <vector>
+
+namespace kinkaku {
+
+// The sentence and working buffers of one thread of analysis, which keep
+// their storage from one sentence to the next. Once they have grown to
+// the size of the input, analyzing a sentence does not allocate.
+class KinkakuAnalysisContext {
+
+private:
+
+    KinkakuSentence sentence_;
+
+public:
+
+    // words that are not in use, with the storage of their strings and
+    // tag lists kept for the next words
+    KinkakuSentence::Words spareWords;
+
+    std::vector<FeatSum> scores;
+    KinkakuString types;
+    KinkakuString tagContext;
+    Dictionary<FeatVec>::MatchResult ngramMatches;
+    Dictionary<ModelTagEntry>::MatchResult dictMatches, userMatches;
+    std::vector<char> dictOn;
+    std::vector< std::pair<int,int> > tagDictMatches;
+
+    KinkakuAnalysisContext() { }
+
+    // Read the next sentence from in into the context's sentence, which is
+    // returned, or null at the end of the input
+    KinkakuSentence * readSentence(CorpusIO & in) {
+        sentence_.clearWords(spareWords);
+        return in.readSentence(sentence_) ? &sentence_ : 0;
+    }
+
+};
+
+}
+
+#endif
@@ -48,6 +48,7 @@ private:
     unsigned debug_;
 
     StringUtil * util_; 
+    bool ownsUtil_;
 
     std::vector<std::string> corpora_;
     std::vector<CorpForm> corpusFormats_; 
@@ -56,6 +57,9 @@ private:
 
     std::vector<std::string> subwordDicts_; 
 
+    std::vector<std::string> userDicts_; 
+    int userDictId_;
+
     std::string model_; 
     char modelForm_; 
 
@@ -93,6 +97,9 @@ private:
     std::vector<bool> global_;
     unsigned tagMax_;
 
+    size_t modelCache_;
+    bool hugePages_;
+
     void ch(const char * n, const char* v);
 
 public:
@@ -103,6 +110,7 @@ public:
     void addCorpus(const std::string & corp, CorpForm format);
     void addDictionary(const std::string & corp);
     void addSubwordDict(const std::string & corp);
+    void addUserDictionary(const std::string & corp);
 
     void parseTrainCommandLine(int argc, const char ** argv);
     void parseRunCommandLine(int argc, const char ** argv);
@@ -118,6 +126,8 @@ public:
     const std::vector<CorpForm> & getCorpusFormats() const { return corpusFormats_; }
     const std::vector<std::string> & getDictionaryFiles() const { return dicts_; }
     const std::vector<std::string> & getSubwordDictFiles() const { return subwordDicts_; }
+    const std::vector<std::string> & getUserDictionaryFiles() const { return userDicts_; }
+    int getUserDictionaryId() const { return userDictId_; }
     const std::string & getModelFile();
     const char getModelFormat() const { return modelForm_; }
     const unsigned getDebug() const { return debug_; }
@@ -140,6 +150,8 @@ public:
     const std::string & getUnkTag() const { return unkTag_; }
     const std::string & getDefaultTag() const { return defTag_; }
     const std::string & getWsConstraint() const { return wsConstraint_; }
+    const size_t getModelCache() const { return modelCache_; }
+    const bool getHugePages() const { return hugePages_; }
 
     const double getBias() const { return bias_; }
     const double getEpsilon() const { return eps_; }
@@ -149,6 +161,7 @@ public:
     const bool getDoUnk() const { return doUnk_; }
     const bool getDoTags() const { return doTags_; }
     const bool getDoTag(int i) const { return doTags_ && (i >= (int)doTag_.size() || doTag_[i]); }
+    const std::vector<bool> & getDoTagList() const { return doTag_; }
     const char* getWordBound() const { return wordBound_.c_str(); } 
     const char* getTagBound() const { return tagBound_.c_str(); } 
     const char* getElemBound() const { return elemBound_.c_str(); } 
@@ -178,6 +191,7 @@ public:
     void setTypeWindow(char v) { typeW_ = v; }
     void setTypeN(char v) { typeN_ = v; }
     void setDictionaryN(char v) { dictN_ = v; }
+    void setUserDictionaryId(int v) { userDictId_ = v; }
     void setUnkN(char v) { unkN_ = v; }
     void setTagMax(unsigned v) { tagMax_ = v; }
     void setUnkBeam(unsigned v) { unkBeam_ = v; }
@@ -207,11 +221,15 @@ public:
     void setFeatureIn(const std::string & featIn) { featIn_ = featIn; }
     void setFeatureOut(const std::string & featOut) { featOut_ = featOut; }
     void setWsConstraint(const std::string & wsConstraint) { wsConstraint_ = wsConstraint; }
+    void setModelCache(size_t modelCache) { modelCache_ = modelCache; }
+    void setHugePages(bool hugePages) { hugePages_ = hugePages; }
 
     std::ostream * getFeatureOutStream();
     void closeFeatureOutStream();
 
     void setEncoding(const char* str);
+    // Use a string utility owned by someone else, such as a shared model
+    void shareStringUtil(StringUtil * util);
 
 };
 
@@ -0,0 +1,60 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef KINKAKU_EVAL_H__
+#define KINKAKU_EVAL_H__
+
+#include <string>
+#include <vector>
+
+namespace kinkaku {
+
+class Kinkaku;
+
+// The speed and accuracy of a model on a corpus with gold words and tags
+class KinkakuEvalResult {
+
+public:
+
+    KinkakuEvalResult() : seconds(0), chars(0), bounds(0), boundsCorrect(0) { }
+
+    double seconds;
+    unsigned chars, bounds, boundsCorrect;
+    std::vector<unsigned> tags, tagsCorrect;
+
+    double getBoundaryAccuracy() const { return bounds ? (double)boundsCorrect/bounds : 0; }
+    double getTagAccuracy(int lev) const { return tags[lev] ? (double)tagsCorrect[lev]/tags[lev] : 0; }
+
+};
+
+// Analyze a corpus in full format and compare the result to its words and
+// tags. Models that do segmentation start from the raw text, and the others
+// are given the gold words to tag.
+void evaluateCorpus(Kinkaku & kinkaku, const std::string & file, KinkakuEvalResult & res);
+
+}
+
+#endif
@@ -44,9 +44,13 @@ public:
 
     void train(const std::vector<KinkakuString> & corpus);
 
-    double score(const KinkakuString & str) const;
+    double score(const KinkakuStringView & str) const;
 
-    double scoreSingle(const KinkakuString & val, int pos);
+    double scoreSingle(const KinkakuStringView & val, int pos);
+
+    // the weight of an n-gram, or null if the model does not have it
+    const double * findProb(const KinkakuStringView & ngram) const;
+    const double * findFallback(const KinkakuStringView & ngram) const;
 
     const KinkakuDoubleMap & getProbs() const { return probs_; }
     const KinkakuDoubleMap & getFallbacks() const { return fallbacks_; }
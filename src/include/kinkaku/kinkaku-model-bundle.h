@@ -0,0 +1,103 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef KINKAKU_MODEL_BUNDLE_H__
+#define KINKAKU_MODEL_BUNDLE_H__
+
+#include <kinkaku/kinkaku-string.h>
+#include <pthread.h>
+#include <vector>
+
+namespace kinkaku {
+
+class KinkakuConfig;
+template <class T> class Dictionary;
+class ModelTagEntry;
+class ProbTagEntry;
+class KinkakuModel;
+class KinkakuLM;
+class LocalModelTable;
+class ModelIO;
+
+// Everything read from a model file, which does not change once it is
+// read and can be shared by any number of Kinkaku instances, each with
+// its own configuration. Each instance that attaches holds a reference,
+// and the last one to release it deletes the model. The only exception
+// is Kinkaku::pruneModel, which changes a model held by no other instance.
+class KinkakuModelBundle {
+
+    friend class Kinkaku;
+    friend class ModelSectionTask;
+
+public:
+
+    // Read a model using the settings in config (encoding, memory and
+    // loading options), which the bundle then owns and which is filled
+    // with the settings stored in the model. Parts that config turns off
+    // (-nows, -notags, -notag, -nounk) are skipped when the model has a
+    // table of sections, and left off in config either way.
+    static KinkakuModelBundle * read(const char * file, KinkakuConfig * config);
+
+    void addRef();
+    void release();
+    // whether more than one reference is held
+    bool isShared();
+
+    const KinkakuConfig * getConfig() const { return config_; }
+    const KinkakuModel * getWSModel() const { return wsModel_; }
+    const Dictionary<ModelTagEntry> * getDictionary() const { return dict_; }
+    const Dictionary<ProbTagEntry> * getSubwordDictionary() const { return subwordDict_; }
+    const std::vector<KinkakuModel*> & getGlobalModels() const { return globalMods_; }
+    const std::vector< std::vector<KinkakuString> > & getGlobalTags() const { return globalTags_; }
+    const std::vector<KinkakuLM*> & getSubwordModels() const { return subwordModels_; }
+
+private:
+
+    KinkakuModelBundle(KinkakuConfig * config);
+    ~KinkakuModelBundle();
+
+    // Read section i of the model (see ModelIO::getNumSections), or
+    // return whether it is needed
+    void readSection(ModelIO * modin, unsigned i);
+    bool needSection(unsigned i) const;
+
+    KinkakuConfig * config_;
+    KinkakuModel * wsModel_;
+    Dictionary<ModelTagEntry> * dict_;
+    LocalModelTable * localMods_;
+    Dictionary<ProbTagEntry> * subwordDict_;
+    std::vector<KinkakuLM*> subwordModels_;
+    std::vector<KinkakuModel*> globalMods_;
+    std::vector< std::vector<KinkakuString> > globalTags_;
+
+    unsigned count_;
+    pthread_mutex_t mutex_;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef KINKAKU_MODEL_STATS_H__
+#define KINKAKU_MODEL_STATS_H__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+namespace kinkaku {
+
+template <class T> class Dictionary;
+class ModelTagEntry;
+class ProbTagEntry;
+class FeatVec;
+class FeatureLookup;
+class KinkakuModel;
+class KinkakuLM;
+
+// The structure and memory of one part of a model, or of several models
+// of the same kind added together. Bytes are the memory used by the
+// process, so weights used in place from a mapped file are counted as
+// elements but not as bytes.
+class ModelComponentStats {
+
+public:
+
+    ModelComponentStats(const std::string & n = "") : name(n), models(0), states(0), gotos(0), outputs(0), featVecs(0), elements(0), nonZero(0), bytes(0) { }
+
+    std::string name;
+    size_t models;
+    size_t states, gotos, outputs;
+    size_t featVecs, elements, nonZero;
+    size_t bytes;
+
+    void addDictionary(const Dictionary<ModelTagEntry> * dict);
+    void addDictionary(const Dictionary<ProbTagEntry> * dict);
+    void addDictionary(const Dictionary<FeatVec> * dict);
+    void addFeatureLookup(const FeatureLookup * look);
+    void addModel(const KinkakuModel * mod);
+    void addLM(const KinkakuLM * lm);
+    void add(const ModelComponentStats & rhs);
+
+};
+
+class KinkakuModelStats {
+
+public:
+
+    std::vector<ModelComponentStats> components;
+    // the number of local models with 0 weights, then with 1, 2-3, 4-7 ...
+    std::vector<size_t> localModelSizes;
+
+    void addLocalModelSize(size_t elements);
+    void print(std::ostream & out) const;
+
+};
+
+}
+
+#endif
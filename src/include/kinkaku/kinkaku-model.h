@@ -144,7 +144,10 @@ public:
     void setMultiplier(double m) { multiplier_ = m; }
 
     void buildFeatureLookup(StringUtil * util, int charw, int typew, int numDicts, int maxLen);
-    Dictionary<std::vector<FeatVal> > * 
+    // Prune the n-gram weights of the lookup (see FeatureLookup::pruneNgrams),
+    // dropping the trained weights so that the lookup is not rebuilt
+    size_t pruneFeatureLookup(StringUtil * util, double threshold, unsigned topK);
+    Dictionary<FeatVec> * 
         makeDictionaryFromPrefixes(const std::vector<KinkakuString> & prefs, StringUtil* util, bool adjustPos);
     
 
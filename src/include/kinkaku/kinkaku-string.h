@@ -29,30 +29,85 @@
 
 #include <vector>
 #include <cstddef>
+#include <cstring>
+#include <new>
 
 namespace kinkaku {
 
 typedef unsigned short KinkakuChar;
 
 class StringUtil;
+class KinkakuString;
 
+// A non-owning range of characters, used to look up part of a string in
+// place. The viewed string must outlive the view and not be modified.
+class KinkakuStringView {
+
+private:
+    const KinkakuChar* chars_;
+    unsigned length_;
+
+public:
+    KinkakuStringView() : chars_(0), length_(0) { }
+    KinkakuStringView(const KinkakuChar* chars, unsigned length) : chars_(chars), length_(length) { }
+    inline KinkakuStringView(const KinkakuString & str);
+
+    inline unsigned length() const { return length_; }
+    inline const KinkakuChar* data() const { return chars_; }
+
+    inline const KinkakuChar & operator[](int i) const {
+#ifdef KINKAKU_SAFE
+        if(i < 0 || (unsigned)i >= length_)
+            throw std::runtime_error("string view index out of bounds");
+#endif
+        return chars_[i];
+    }
+
+    inline KinkakuStringView substr(unsigned s) const {
+        return KinkakuStringView(chars_+s, length_-s);
+    }
+    inline KinkakuStringView substr(unsigned s, unsigned l) const {
+#ifdef KINKAKU_SAFE
+        if(s+l > length_)
+            throw std::runtime_error("string view substr out of bounds");
+#endif
+        return KinkakuStringView(chars_+s, l);
+    }
+
+    inline size_t getHash() const {
+        size_t hash = 5381;
+        for(unsigned i = 0; i < length_; i++)
+            hash = ((hash << 5) + hash) + chars_[i];
+        return hash;
+    }
+
+};
+
+// The reference count and characters of a heap-allocated string, held
+// in a single block with the characters directly after the header. The
+// count is changed atomically, as strings in a shared model are copied
+// by every thread that analyzes with it.
 class KinkakuStringImpl {
 
 public:
-    unsigned length_;
     unsigned count_;
-    KinkakuChar* chars_;
+    // the number of characters the block has room for
+    unsigned capacity_;
 
-    KinkakuStringImpl() : length_(0), count_(1), chars_(0) { }
-    KinkakuStringImpl(unsigned length);
-    KinkakuStringImpl(const KinkakuStringImpl & impl);
-    ~KinkakuStringImpl() {
-        if(chars_)
-            delete [] chars_;
-    }
+    static KinkakuStringImpl* create(unsigned length);
+    static KinkakuStringImpl* create(const KinkakuChar* chars, unsigned length);
+    static void destroy(KinkakuStringImpl* impl) { ::operator delete(impl); }
 
-    unsigned dec() { return --count_; }
-    unsigned inc() { return ++count_; }
+    KinkakuChar* getChars() { return reinterpret_cast<KinkakuChar*>(this+1); }
+    const KinkakuChar* getChars() const { return reinterpret_cast<const KinkakuChar*>(this+1); }
+
+    unsigned dec() { return __atomic_sub_fetch(&count_, 1, __ATOMIC_ACQ_REL); }
+    unsigned inc() { return __atomic_add_fetch(&count_, 1, __ATOMIC_RELAXED); }
+    // whether no other string holds this block
+    bool isUnique() const { return __atomic_load_n(&count_, __ATOMIC_ACQUIRE) == 1; }
+
+private:
+    KinkakuStringImpl(unsigned capacity) : count_(1), capacity_(capacity) { }
 
 };
 
@@ -60,24 +115,62 @@ class KinkakuString {
 
 public:
     friend class StringUtil;
+
+    // strings up to this length are stored inside the object itself
+    static const unsigned INLINE_LENGTH = 6;
+    // set in the length of strings whose characters are on the heap, as a
+    // block that has been reused may hold a short string
+    static const unsigned HEAP_FLAG = 0x80000000u;
     
 private:
-    KinkakuStringImpl* impl_;
+    struct Inline {
+        unsigned length;
+        KinkakuChar chars[INLINE_LENGTH];
+    };
+    struct Heap {
+        unsigned length;
+        KinkakuStringImpl* impl;
+    };
+    union Storage {
+        Inline small;
+        Heap heap;
+    };
+    Storage store_;
+
+    inline bool isInline() const { return !(store_.small.length & HEAP_FLAG); }
+    inline void release() {
+        if(!isInline() && !store_.heap.impl->dec())
+            KinkakuStringImpl::destroy(store_.heap.impl);
+    }
+    KinkakuChar* unshare();
 
 public:
 
     typedef std::vector<KinkakuString> Tokens;
 
-    KinkakuString() : impl_(0) { }
-    KinkakuString(const KinkakuString & str) { 
-        impl_ = str.impl_;
-        if(impl_) impl_->inc();
+    KinkakuString() { store_.small.length = 0; }
+    KinkakuString(const KinkakuString & str) : store_(str.store_) { 
+        if(!isInline()) store_.heap.impl->inc();
+    }
+    KinkakuString(unsigned length) {
+        store_.small.length = length;
+        if(length > INLINE_LENGTH) {
+            store_.heap.length |= HEAP_FLAG;
+            store_.heap.impl = KinkakuStringImpl::create(length);
+        }
+    }
+    explicit KinkakuString(const KinkakuStringView & view) {
+        store_.small.length = view.length();
+        if(view.length() > INLINE_LENGTH) {
+            store_.heap.length |= HEAP_FLAG;
+            store_.heap.impl = KinkakuStringImpl::create(view.data(), view.length());
+        } else {
+            std::memcpy(store_.small.chars, view.data(), sizeof(KinkakuChar)*view.length());
+        }
     }
-    KinkakuString(unsigned length) { impl_ = new KinkakuStringImpl(length); }
     
     ~KinkakuString() {
-        if(impl_ && !impl_->dec())
-            delete impl_;
+        release();
     }
 
     Tokens tokenize(const KinkakuString & delim, bool includeDelim = false) const;
@@ -89,76 +182,105 @@ public:
     
     inline KinkakuChar & operator[](int i) {
 #ifdef KINKAKU_SAFE
-        if(impl_ == 0 || i < 0 || (unsigned)i >= impl_->length_)
+        if(i < 0 || (unsigned)i >= length())
             throw std::runtime_error("string index out of bounds");
 #endif
-        return getImpl()->chars_[i];
+        return data()[i];
     }
     
     inline const KinkakuChar & operator[](int i) const {
 #ifdef KINKAKU_SAFE
-        if(impl_ == 0 || i < 0 || (unsigned)i >= impl_->length_)
+        if(i < 0 || (unsigned)i >= length())
             throw std::runtime_error("string index out of bounds");
 #endif
-        return impl_->chars_[i];
+        return data()[i];
     }
     
     KinkakuString & operator= (const KinkakuString &str) {
-        if(impl_ && !impl_->dec())
-            delete impl_;
-        impl_ = str.impl_;
-        if(impl_) impl_->inc();
+        if(!str.isInline())
+            str.store_.heap.impl->inc();
+        release();
+        store_ = str.store_;
         return *this;
     }
 
 
     inline unsigned length() const {
-        return (impl_?impl_->length_:0); 
+        return store_.small.length & ~HEAP_FLAG;
+    }
+
+    // Change the length, keeping the characters up to the new length and
+    // the heap block if it is not shared and large enough
+    void resize(unsigned length);
+    // Replace the characters with those of view, which must not be part of
+    // this string, reusing the storage like resize
+    void assign(const KinkakuStringView & view);
+
+    void swap(KinkakuString & str) {
+        Storage tmp = store_;
+        store_ = str.store_;
+        str.store_ = tmp;
+    }
+
+    inline const KinkakuChar* data() const {
+        return isInline() ? store_.small.chars : store_.heap.impl->getChars();
+    }
+    // a writable pointer, copying the characters first if they are shared
+    inline KinkakuChar* data() {
+        if(isInline())
+            return store_.small.chars;
+        if(!store_.heap.impl->isUnique())
+            return unshare();
+        return store_.heap.impl->getChars();
     }
 
     size_t getHash() const;
 
+    // the shared heap block, or null for strings stored inline
     inline const KinkakuStringImpl * getImpl() const {
-        return impl_;
+        return isInline() ? 0 : store_.heap.impl;
     } 
     KinkakuStringImpl * getImpl();
 
+    inline size_t getHeapSize() const {
+        return isInline() ? 0 : sizeof(KinkakuStringImpl) + store_.heap.impl->capacity_*sizeof(KinkakuChar);
+    }
+
     bool beginsWith(const KinkakuString & s) const;
 
 };
 
+inline KinkakuStringView::KinkakuStringView(const KinkakuString & str) : chars_(str.data()), length_(str.length()) { }
+
 inline KinkakuString operator+(const KinkakuString& a, const KinkakuChar& b) {
-    const KinkakuStringImpl * aimp = a.getImpl();
-    if(aimp == 0) {
-        KinkakuString ret(1);
-        ret[0] = b;
-        return ret;
-    }
-    KinkakuString ret(aimp->length_+1);
-    ret.splice(a,0);
-    ret[aimp->length_]=b;
+    const unsigned al = a.length();
+    KinkakuString ret(al+1);
+    KinkakuChar* out = ret.data();
+    std::memcpy(out, a.data(), sizeof(KinkakuChar)*al);
+    out[al] = b;
     return ret;
 }
 
 inline KinkakuString operator+(const KinkakuString& a, const KinkakuString& b) {
-    const KinkakuStringImpl * aimp = a.getImpl();
-    if(aimp == 0)
+    const unsigned al = a.length(), bl = b.length();
+    if(al == 0)
         return b;
-    const KinkakuStringImpl * bimp = b.getImpl();
-    if(bimp == 0)
+    if(bl == 0)
         return a;
-    KinkakuString ret(aimp->length_+bimp->length_);
-    ret.splice(a,0);
-    ret.splice(b,aimp->length_);
+    KinkakuString ret(al+bl);
+    KinkakuChar* out = ret.data();
+    std::memcpy(out, a.data(), sizeof(KinkakuChar)*al);
+    std::memcpy(out+al, b.data(), sizeof(KinkakuChar)*bl);
     return ret;
 }
 
 inline bool operator<(const KinkakuString & a, const KinkakuString & b) {
     unsigned i;
     const unsigned al = a.length(), bl = b.length(), ml=std::min(al,bl);
+    const KinkakuChar * ac = a.data(), * bc = b.data();
     for(i = 0; i < ml; i++) {
-        if(a[i] < b[i]) return true;
-        else if(b[i] < a[i]) return false;
+        if(ac[i] < bc[i]) return true;
+        else if(bc[i] < ac[i]) return false;
     }
     return (bl != i);
 }
@@ -168,8 +290,9 @@ inline bool operator==(const KinkakuString & a, const KinkakuString & b) {
     const unsigned al = a.length();
     if(al!=b.length())
         return false;
+    const KinkakuChar * ac = a.data(), * bc = b.data();
     for(i = 0; i < al; i++)
-        if(a[i] != b[i]) return false;
+        if(ac[i] != bc[i]) return false;
     return true;
 }
 
@@ -177,11 +300,19 @@ inline bool operator!=(const KinkakuString & a, const KinkakuString & b) {
     return !(a==b);
 }
 
+inline bool operator==(const KinkakuStringView & a, const KinkakuStringView & b) {
+    return a.length() == b.length()
+        && std::memcmp(a.data(), b.data(), sizeof(KinkakuChar)*a.length()) == 0;
+}
+
 class KinkakuStringHash {
 public:
     size_t operator()(const KinkakuString & x) const {
         return x.getHash();
     }
+    size_t operator()(const KinkakuStringView & x) const {
+        return x.getHash();
+    }
 };
 
 }
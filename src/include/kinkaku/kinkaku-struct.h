@@ -29,6 +29,7 @@
 
 #include <kinkaku/config.h>
 #include <kinkaku/kinkaku-string.h>
+#include <algorithm>
 #include <string>
 #include <map>
 
@@ -90,6 +91,7 @@ inline bool operator<(const KinkakuTag & a, const KinkakuTag & b) {
 
 class KinkakuWord {
 public:
+    KinkakuWord() : isCertain(true), unknown(false) { }
     KinkakuWord(const KinkakuString & s, const KinkakuString & n) : surface(s), norm(n), isCertain(true), unknown(false) { }
 
     KinkakuString surface;
@@ -122,6 +124,24 @@ public:
     bool getUnknown() const { return unknown; }
     bool hasTag(int lev) const { return (int)tags.size() > lev && tags[lev].size() > 0; }
 
+    void swap(KinkakuWord & w) {
+        surface.swap(w.surface);
+        norm.swap(w.norm);
+        tags.swap(w.tags);
+        std::swap(isCertain, w.isCertain);
+        std::swap(unknown, w.unknown);
+    }
+    // Make this the word with the given characters and no tags, keeping
+    // the storage of its strings and tag lists
+    void reset(const KinkakuStringView & s, const KinkakuStringView & n) {
+        surface.assign(s);
+        norm.assign(n);
+        for(unsigned i = 0; i < tags.size(); i++)
+            tags[i].clear();
+        isCertain = true;
+        unknown = false;
+    }
+
 };
 
 class KinkakuSentence {
@@ -142,6 +162,11 @@ public:
     KinkakuSentence(const KinkakuString & str, const KinkakuString & norm_str) : surface(str), norm(norm_str), wsConfs(std::max(str.length(),(unsigned)1)-1,0) { }
 
     void refreshWS(double confidence);
+    // The same, but with the words that are no longer needed moved into
+    // spare, and new words taken from spare when it has any
+    void refreshWS(double confidence, Words & spare);
+    // move all the words into spare
+    void clearWords(Words & spare);
 
 };
 
@@ -48,6 +48,9 @@ void checkValueVecEqual(const std::vector<T> & a, const std::vector<T> & b);
 template <class T>
 void checkValueVecEqual(const std::vector<T> * a, const std::vector<T> * b);
 
+class FeatVec;
+void checkValueVecEqual(const FeatVec * a, const FeatVec * b);
+
 template <class T>
 void checkPointerVecEqual(const std::vector<T*> & a, const std::vector<T*> & b);
 
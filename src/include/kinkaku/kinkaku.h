@@ -29,7 +29,9 @@
 
 #include <kinkaku/kinkaku-config.h>
 #include <kinkaku/kinkaku-struct.h>
+#include <kinkaku/kinkaku-model-stats.h>
 #include <vector>
+#include <map>
 
 namespace kinkaku  {
 
@@ -42,6 +44,9 @@ class ProbTagEntry;
 class KinkakuModel;
 class KinkakuLM;
 class FeatureIO;
+class LocalModelTable;
+class KinkakuModelBundle;
+class KinkakuAnalysisContext;
 
 class Kinkaku {
 
@@ -54,6 +59,8 @@ private:
     StringUtil* util_;
     KinkakuConfig* config_;
     Dictionary<ModelTagEntry> * dict_;
+    Dictionary<ModelTagEntry> * userDict_;
+    std::map<std::string, Dictionary<ModelTagEntry>*> namedUserDicts_;
     Sentences sentences_;
 
     KinkakuModel* wsModel_;
@@ -63,6 +70,10 @@ private:
 
     std::vector<KinkakuModel*> globalMods_;
     std::vector< std::vector<KinkakuString> > globalTags_;
+    // the local models of dict_ that are only decoded when first used
+    LocalModelTable * localMods_;
+    // the model read from a file that the models above belong to, if any
+    KinkakuModelBundle * bundle_;
 
     std::vector<unsigned> dictFeats_;
     std::vector<KinkakuString> charPrefixes_, typePrefixes_;
@@ -73,11 +84,58 @@ public:
 
     void readModel(const char* fileName);
 
+    // Use a model that is shared with other instances, with the model's
+    // settings copied into this instance's configuration
+    void attachModel(KinkakuModelBundle * bundle);
+    KinkakuModelBundle * getModelBundle() { return bundle_; }
+
     void writeModel(const char* fileName);
 
-    void calculateWS(KinkakuSentence & sent);
+    // Remove the n-gram weights of each model whose magnitude is below
+    // threshold, or outside that model's topK largest if topK is not 0,
+    // returning the number removed. Local models that have not been read
+    // are read first. The model is changed in place, so this throws if it
+    // is attached to any other instance.
+    size_t pruneModel(double threshold, unsigned topK = 0);
+
+    // The structure and memory of each part of the model. Local models
+    // that have not been read are read one at a time to be measured, and
+    // those shared by several entries are counted once.
+    KinkakuModelStats getModelStats();
+
+    // Load (or reload) a dictionary of words to be used on top of the
+    // model's dictionary, with the features of model dictionary dictId
+    void readUserDictionary(const std::vector<std::string> & files, int dictId = 0);
+    void clearUserDictionary();
+
+    // User dictionaries registered by id (one per customer, for example),
+    // which share this model and are selected for each call to
+    // calculateWS/calculateTags instead of the default user dictionary.
+    // They must be registered and cleared while no analysis is running.
+    // Analysis copies tags out of the shared entries, which changes the
+    // strings' reference counts, so this relies on the counts being
+    // atomic rather than on the entries being left untouched.
+    void readUserDictionary(const std::string & id, const std::vector<std::string> & files, int dictId = 0);
+    void clearUserDictionary(const std::string & id);
+    const Dictionary<ModelTagEntry> * getUserDictionary(const std::string & id) const;
+
+    // Compile full-format dictionary files into a single binary dictionary,
+    // which can be given anywhere a dictionary file is accepted
+    void compileDictionary(const std::vector<std::string> & files, const std::string & outFile);
+
+    void calculateWS(KinkakuSentence & sent) { calculateWS(sent, userDict_); }
+    void calculateWS(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict);
     
-    void calculateTags(KinkakuSentence & sent, int lev);
+    void calculateTags(KinkakuSentence & sent, int lev) { calculateTags(sent, lev, userDict_); }
+    void calculateTags(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict);
+
+    // The same using the buffers of context, which should be kept for the
+    // sentences that follow (one context for each thread)
+    void calculateWS(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context);
+    void calculateTags(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context);
+
+    // Segment and tag sent as configured, as analyze does for each sentence
+    void analyzeSentence(KinkakuSentence & sent, KinkakuAnalysisContext & context);
 
     void calculateUnknownTag(KinkakuWord & str, int lev);
 
@@ -112,6 +170,13 @@ private:
     void buildVocabulary();
     void trainSanityCheck();
 
+    // calculateWS/calculateTags with context.types already holding the
+    // type ids of sent.norm, which are shared by all of the calls
+    void calculateWSWithTypes(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context);
+    void calculateTagsWithTypes(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context);
+
+    void clearModel();
+
     void trainWS();
     void preparePrefixes();
     unsigned wsDictionaryFeatures(const KinkakuString & sent, SentenceFeatures & feat);
@@ -123,7 +188,10 @@ private:
     unsigned tagSelfFeatures(const KinkakuString & self, std::vector<unsigned> & feat, const KinkakuString & pref, KinkakuModel * model);
     unsigned tagDictFeatures(const KinkakuString & surf, int lev, std::vector<unsigned> & myFeats, KinkakuModel * model);
 
-    std::vector<std::pair<int,int> > getDictionaryMatches(const KinkakuString & str, int lev);
+    std::vector<std::pair<int,int> > getDictionaryMatches(const KinkakuStringView & str, int lev, const Dictionary<ModelTagEntry> * userDict = 0);
+    void getDictionaryMatches(const KinkakuStringView & str, int lev, const Dictionary<ModelTagEntry> * userDict, std::vector<std::pair<int,int> > & ret);
+    const ModelTagEntry * findEntry(const KinkakuString & word, int lev, const Dictionary<ModelTagEntry> * userDict);
+    Dictionary<ModelTagEntry> * buildUserDictionary(const std::vector<std::string> & files, int dictId);
 
     template <class Entry>
     void addTag(typename Dictionary<Entry>::WordMap& allWords, const KinkakuString & word, int lev, const KinkakuString * tag, int dict);
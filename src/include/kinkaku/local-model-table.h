@@ -0,0 +1,109 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef LOCAL_MODEL_TABLE_H__
+#define LOCAL_MODEL_TABLE_H__
+
+#include <pthread.h>
+#include <vector>
+#include <list>
+#include <map>
+#include <cstddef>
+
+namespace kinkaku {
+
+class KinkakuModel;
+class MappedFile;
+class StringUtil;
+
+// The local tag models of a model file's dictionary entries, which are
+// only decoded from the file the first time they are used. Each entry has
+// one slot per tag level, and slots whose models are stored only once in
+// the file share one model. Models that have not been used recently are
+// evicted when the memory limit is passed. Models are pinned between
+// acquire and release, so they can be used from several threads at once.
+class LocalModelTable {
+
+public:
+
+    // format is the ModelIO format of the file the models are decoded from
+    LocalModelTable(StringUtil * util, MappedFile * file, char format);
+    ~LocalModelTable();
+
+    // Add a slot for the model at pos in the file (0 if there is none),
+    // returning its id. Models are added in the order of the file, but a
+    // slot can also use a model that was added before.
+    unsigned addSlot(size_t pos);
+    unsigned getNumSlots() const { return slots_.size(); }
+    // The distinct models, which are numbered from 1 (0 is no model)
+    unsigned getNumModels() const { return positions_.size()-1; }
+    unsigned getModelId(unsigned slot) const { return slots_[slot]; }
+
+    KinkakuModel * acquire(unsigned slot);
+    void release(unsigned slot);
+
+    // Decode a new copy of the model in a slot, owned by the caller
+    KinkakuModel * readModel(unsigned slot) const;
+
+    // The limit on the memory of decoded models in bytes, 0 for none
+    void setMemoryLimit(size_t limit);
+    size_t getMemoryLimit() const { return limit_; }
+    size_t getMemoryUsage();
+    unsigned getNumLoaded();
+
+private:
+
+    typedef std::list<unsigned> UseList;
+
+    class LoadedModel {
+    public:
+        LoadedModel() : memory(0), pins(0) { }
+        size_t memory;
+        unsigned pins;
+        UseList::iterator use;
+    };
+
+    StringUtil * util_;
+    MappedFile * file_;
+    char format_;
+    // the model of each slot, and the position and decoded copy of each model
+    std::vector<unsigned> slots_;
+    std::vector<size_t> positions_;
+    std::vector<KinkakuModel*> models_;
+    std::map<unsigned, LoadedModel> loaded_;
+    // the most recently used model is first
+    UseList uses_;
+    size_t limit_, memory_;
+    mutable pthread_mutex_t mutex_;
+
+    KinkakuModel * decode(unsigned id) const;
+    void evict();
+
+};
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef MAPPED_FILE_H__
+#define MAPPED_FILE_H__
+
+#include <iostream>
+#include <string>
+#include <cstddef>
+#include <pthread.h>
+
+namespace kinkaku {
+
+// A read-only file mapped into memory (or, for streams, read into it),
+// shared by reference count among the objects that point into it, which
+// may be on different threads while a model is read
+class MappedFile {
+
+public:
+
+	static MappedFile * open(const std::string & file);
+	static MappedFile * read(std::istream & in);
+	// An arena of size bytes that is filled once by its creator and then
+	// used like a file. Large arenas can ask for huge pages, falling back
+	// to normal pages when the system has none to give.
+	static MappedFile * allocate(size_t size, bool hugePages);
+
+	const char * getData() const { return data_; }
+	size_t getSize() const { return size_; }
+	bool isArena() const { return arena_; }
+
+	void addRef() {
+		pthread_mutex_lock(&mutex_);
+		count_++;
+		pthread_mutex_unlock(&mutex_);
+	}
+	void release() {
+		pthread_mutex_lock(&mutex_);
+		unsigned count = --count_;
+		pthread_mutex_unlock(&mutex_);
+		if(count == 0)
+			delete this;
+	}
+
+private:
+
+	MappedFile() : data_(0), size_(0), mapped_(false), arena_(false), count_(1) {
+		pthread_mutex_init(&mutex_, 0);
+	}
+	~MappedFile();
+
+	char * data_;
+	size_t size_;
+	bool mapped_, arena_;
+	unsigned count_;
+	pthread_mutex_t mutex_;
+
+};
+
+// Blocks for the arrays of the dictionaries in one model, taken in turn
+// from chunks of a huge page each, so that small dictionaries share an
+// allocation (and its huge pages) rather than each having their own.
+// Every block holds a reference to its chunk, which is freed once the
+// arena and all of the blocks in it are released. Blocks may be taken
+// by several threads reading sections of the model at once.
+class MappedArena {
+
+public:
+
+	MappedArena(bool hugePages);
+
+	// An 8-byte aligned block of size bytes, and the chunk that the
+	// caller must release when done with it. Large blocks get a chunk of
+	// their own.
+	char * take(size_t size, MappedFile * & chunk);
+
+	void addRef() {
+		pthread_mutex_lock(&mutex_);
+		count_++;
+		pthread_mutex_unlock(&mutex_);
+	}
+	void release() {
+		pthread_mutex_lock(&mutex_);
+		unsigned count = --count_;
+		pthread_mutex_unlock(&mutex_);
+		if(count == 0)
+			delete this;
+	}
+
+private:
+
+	~MappedArena();
+
+	MappedFile * chunk_;
+	size_t used_;
+	bool hugePages_;
+	unsigned count_;
+	pthread_mutex_t mutex_;
+
+};
+
+// A stream buffer that reads directly from a mapped file, and can give
+// the position of arrays in it so they can be used without copying
+class MappedFileBuf : public std::streambuf {
+
+public:
+
+	MappedFileBuf(MappedFile * file) : file_(file) {
+		file_->addRef();
+		char * data = const_cast<char*>(file_->getData());
+		setg(data, data, data+file_->getSize());
+	}
+	~MappedFileBuf() {
+		file_->release();
+	}
+
+	MappedFile * getFile() { return file_; }
+	size_t tell() const { return gptr()-eback(); }
+	void seek(size_t pos) {
+		if((size_t)(egptr()-eback()) < pos)
+			throwTruncated();
+		setg(eback(), eback()+pos, egptr());
+	}
+
+	// Return the current position and skip over size bytes
+	const char * take(size_t size) {
+		char * ret = gptr();
+		if((size_t)(egptr()-ret) < size)
+			throwTruncated();
+		setg(eback(), ret+size, egptr());
+		return ret;
+	}
+
+private:
+
+	MappedFile * file_;
+
+	void throwTruncated();
+
+};
+
+}
+
+#endif
@@ -29,6 +29,9 @@
 
 #include <kinkaku/model-io.h>
 #include <kinkaku/dictionary.h>
+#include <kinkaku/mapped-file.h>
+#include <kinkaku/local-model-table.h>
+#include <cstring>
 
 namespace kinkaku {
 
@@ -36,9 +39,12 @@ class BinaryModelIO : public ModelIO {
 
 public:
 
-    BinaryModelIO(StringUtil* util) : ModelIO(util) { }
-    BinaryModelIO(StringUtil* util, const char* file, bool out) : ModelIO(util,file,out,true) { }
-    BinaryModelIO(StringUtil* util, std::iostream & str, bool out) : ModelIO(util,str,out,true) { }
+    BinaryModelIO(StringUtil* util) : ModelIO(util), buf_(0), localMods_(0), arena_(0), tablePos_(0), numMarked_(0) { }
+    BinaryModelIO(StringUtil* util, const char* file, bool out);
+    BinaryModelIO(StringUtil* util, std::iostream & str, bool out);
+    // read from pos in a file that is already in memory
+    BinaryModelIO(StringUtil* util, MappedFile * file, size_t pos);
+    ~BinaryModelIO();
 
     void writeConfig(const KinkakuConfig & conf);
     void writeModel(const KinkakuModel * mod);
@@ -63,20 +69,22 @@ public:
         if(dict->getNumDicts() > 8)
             THROW_ERROR("Only 8 dictionaries can be stored in a binary file.");
         writeBinary(dict->getNumDicts());
-        const std::vector<DictionaryState*> & states = dict->getStates();
-        writeBinary((uint32_t)states.size());
-        for(unsigned i = 0; i < states.size(); i++) {
-            const DictionaryState * state = states[i];
-            writeBinary((uint32_t)state->failure);
-            writeBinary((uint32_t)state->gotos.size());
-            for(unsigned j = 0; j < state->gotos.size(); j++) {
-                writeBinary((KinkakuChar)state->gotos[j].first);
-                writeBinary((uint32_t)state->gotos[j].second);
+        const DictionaryState * states = dict->getStateArray();
+        const std::pair<KinkakuChar,unsigned> * gotos = dict->getGotoArray();
+        writeBinary((uint32_t)dict->getNumStates());
+        for(unsigned i = 0; i < dict->getNumStates(); i++) {
+            const DictionaryState & state = states[i];
+            writeBinary((uint32_t)state.failure);
+            writeBinary((uint32_t)state.numGotos());
+            for(unsigned j = state.gotoBegin; j < state.gotoEnd; j++) {
+                writeBinary((KinkakuChar)gotos[j].first);
+                writeBinary((uint32_t)gotos[j].second);
             }
-            writeBinary((uint32_t)state->output.size());
-            for(unsigned j = 0; j < state->output.size(); j++) 
-                writeBinary((uint32_t)state->output[j]);
-            writeBinary(state->isBranch);
+            // only the state's own output, the rest are found by links
+            writeBinary((uint32_t)(state.isBranch?1:0));
+            if(state.isBranch)
+                writeBinary((uint32_t)state.output);
+            writeBinary(state.isBranch);
         }
         const std::vector<Entry*> & entries = dict->getEntries();
         writeBinary((uint32_t)entries.size());
@@ -98,38 +106,137 @@ public:
     template <class Entry>
     Entry * readEntry();
 
+    LocalModelTable * takeLocalModels();
+
+    void markSection();
+    unsigned getNumSections() const { return sections_.size(); }
+    ModelIO * openSection(unsigned i);
+
+protected:
+
+    // files are mapped into memory when reading, and decoded from there
+    // rather than one stream read per value
+    MappedFileBuf * buf_;
+    // the positions of local tag models, which are skipped over by readEntry
+    LocalModelTable * localMods_;
+    // where the arrays of dictionaries read through this model and its
+    // sections are packed (local models read later have none, so that
+    // the memory of those evicted is freed)
+    MappedArena * arena_;
+    // the first copy of each distinct local model written: where it is, and
+    // the entry and level it came from so that its binary form can be made
+    // again. Copies are listed by a hash of that form, which is all that is
+    // kept of it, and models with the same hash are compared in full.
+    struct LocalModelCopy {
+        uint64_t pos;
+        const ModelTagEntry * entry;
+        int lev;
+    };
+    GenericMap<uint64_t, std::vector<LocalModelCopy> > localPositions_;
+    // where the table of sections is when writing, the number marked so
+    // far, and where each starts when reading
+    size_t tablePos_;
+    unsigned numMarked_;
+    std::vector<uint64_t> sections_;
+
+    void openMapped(MappedFile * file);
+    virtual LocalModelTable * createLocalModels();
+    void writeLocalModel(const ModelTagEntry * entry, int lev);
+    // The form of a local model that copies are compared by
+    std::string localModelKey(const KinkakuModel * mod);
+    size_t skipModel();
+    void skipFeatureLookup();
+    virtual void skipVectorDictionary();
+    virtual void skipFeatVec();
+    void writeConfigValues(const KinkakuConfig & conf);
+    // The table is written after the configuration, and filled in as
+    // each section is marked
+    void writeSectionTable();
+    // A reader of the same format at pos in this file
+    virtual BinaryModelIO * createReader(size_t pos);
+
+    template <class T>
+    T readBinary() {
+        if(!buf_)
+            return GeneralIO::readBinary<T>();
+        T v;
+        memcpy(&v, buf_->take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    template <class T>
+    void readBinaryArray(T * data, size_t size) {
+        if(size == 0)
+            return;
+        if(buf_)
+            memcpy(data, buf_->take(size*sizeof(T)), size*sizeof(T));
+        else
+            str_->read(reinterpret_cast<char *>(data), size*sizeof(T));
+    }
+
+    // strings of characters, which formats can write more compactly
+    virtual void writeKinkakuString(const KinkakuString & str) { writeString(str); }
+    virtual KinkakuString readKinkakuString();
+
+public:
+
     template <class Entry>
     Dictionary<Entry> * readDictionary() {
         Dictionary<Entry> * dict = new Dictionary<Entry>(util_);
         std::string line, buff;
         unsigned numDicts = readBinary<unsigned char>();
         dict->setNumDicts(numDicts);
-        std::vector<DictionaryState*> & states = dict->getStates();
+        std::vector<DictionaryState> & states = dict->getStates();
+        typename Dictionary<Entry>::Gotos & gotos = dict->getGotos();
         states.resize(readBinary<uint32_t>());
         if(states.size() == 0) {
             delete dict;
             return 0;
         }
+        // every state but the root is the target of exactly one goto
+        gotos.reserve(states.size()-1);
         for(unsigned i = 0; i < states.size(); i++) {
-            DictionaryState * state = new DictionaryState();
-            state->failure = readBinary<uint32_t>();
-            state->gotos.resize(readBinary<uint32_t>());
-            for(unsigned j = 0; j < state->gotos.size(); j++) {
-                state->gotos[j].first = readBinary<KinkakuChar>();
-                state->gotos[j].second = readBinary<uint32_t>();
+            DictionaryState & state = states[i];
+            state.failure = readBinary<uint32_t>();
+            state.gotoBegin = gotos.size();
+            gotos.resize(gotos.size()+readBinary<uint32_t>());
+            state.gotoEnd = gotos.size();
+            for(unsigned j = state.gotoBegin; j < state.gotoEnd; j++) {
+                gotos[j].first = readBinary<KinkakuChar>();
+                gotos[j].second = readBinary<uint32_t>();
             }
-            state->output.resize(readBinary<uint32_t>());
-            for(unsigned j = 0; j < state->output.size(); j++) 
-                state->output[j] = readBinary<uint32_t>();
-            state->isBranch = readBinary<bool>();
-            states[i] = state;
+            // older models list all outputs, but the state's own comes first
+            unsigned numOutputs = readBinary<uint32_t>();
+            for(unsigned j = 0; j < numOutputs; j++) {
+                unsigned out = readBinary<uint32_t>();
+                if(j == 0) state.output = out;
+            }
+            state.isBranch = readBinary<bool>();
         }
+        dict->buildOutputLinks();
+        dict->buildDenseGotos();
+        readEntries(dict);
+        return dict;
+    }
+
+protected:
+
+    // Once the entries are read, they and their tags are moved into the
+    // arena, followed by the automaton (and, for feature vectors, the
+    // weights after it)
+    template <class Entry>
+    void readEntries(Dictionary<Entry> * dict) {
         std::vector<Entry*> & entries = dict->getEntries();
         entries.resize(readBinary<uint32_t>());
         for(unsigned i = 0; i < entries.size(); i++) 
             entries[i] = readEntry<Entry>();
-        return dict;
+        dict->compactEntries(arena_, hugePages_);
+        dict->packArrays(0, arena_, hugePages_);
     }
+    void readEntries(Dictionary<FeatVec> * dict);
+    // Move weights read into one pool into the dictionary's arena, with
+    // entry i at offsets[i] to offsets[i+1]
+    void setEntryPool(Dictionary<FeatVec> * dict, const std::vector<uint32_t> & offsets, const std::vector<FeatVal> & pool);
 
 };
 
@@ -0,0 +1,187 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef MODEL_IO_COMPACT_H__
+#define MODEL_IO_COMPACT_H__
+
+#include <kinkaku/model-io-binary.h>
+
+namespace kinkaku {
+
+// The binary format, but made small for copying models to many machines.
+// Integers are written as variable-length numbers, state indices and
+// characters as the difference from the previous one, feature weights
+// with only as many bits as their range needs, and language model
+// probabilities quantized to 16 bits, which is the only loss.
+class CompactModelIO : public BinaryModelIO {
+
+public:
+
+    CompactModelIO(StringUtil* util, const char* file, bool out) : BinaryModelIO(util,file,out) { }
+    CompactModelIO(StringUtil* util, std::iostream & str, bool out) : BinaryModelIO(util,str,out) { }
+    CompactModelIO(StringUtil* util, MappedFile * file, size_t pos) : BinaryModelIO(util,file,pos) { }
+
+    void writeConfig(const KinkakuConfig & conf);
+    void writeModelDictionary(const Dictionary<ModelTagEntry> * dict) { writeCompactDictionary(dict); }
+    void writeProbDictionary(const Dictionary<ProbTagEntry> * dict) { writeCompactDictionary(dict); }
+    void writeVectorDictionary(const Dictionary<FeatVec> * dict) { writeCompactDictionary(dict); }
+    void writeLM(const KinkakuLM * mod);
+    void writeFeatVec(const FeatVec * vec);
+
+    Dictionary<ModelTagEntry> * readModelDictionary() { return readCompactDictionary<ModelTagEntry>(); }
+    Dictionary<ProbTagEntry> * readProbDictionary()  { return readCompactDictionary<ProbTagEntry>(); }
+    Dictionary<FeatVec> * readVectorDictionary()  { return readCompactDictionary<FeatVec>(); }
+    KinkakuLM * readLM();
+    FeatVec * readFeatVec();
+
+protected:
+
+    void writeVarint(uint64_t val) {
+        while(val >= 0x80) {
+            str_->put((char)(val | 0x80));
+            val >>= 7;
+        }
+        str_->put((char)val);
+    }
+    uint64_t readVarint() {
+        uint64_t val = 0;
+        for(int shift = 0; ; shift += 7) {
+            unsigned char byte = *buf_->take(1);
+            val |= (uint64_t)(byte & 0x7f) << shift;
+            if(byte < 0x80 || shift > 56)
+                return val;
+        }
+    }
+    void writeSigned(int64_t val) { writeVarint(((uint64_t)val << 1) ^ (uint64_t)(val >> 63)); }
+    int64_t readSigned() {
+        uint64_t val = readVarint();
+        return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+    }
+
+    void writeKinkakuString(const KinkakuString & str);
+    KinkakuString readKinkakuString();
+
+    LocalModelTable * createLocalModels();
+    BinaryModelIO * createReader(size_t pos) { return new CompactModelIO(util_, buf_->getFile(), pos); }
+    void skipVectorDictionary();
+    void skipFeatVec();
+    // Decode a vector written by writeFeatVec whose size is already read
+    void readFeatVals(FeatVal * data, unsigned size);
+
+    template <class Entry>
+    void writeCompactDictionary(const Dictionary<Entry> * dict) {
+        if(dict == 0 || dict->getNumStates() == 0) {
+            writeBinary((unsigned char)0);
+            writeVarint(0);
+            return;
+        }
+        if(dict->getNumDicts() > 8)
+            THROW_ERROR("Only 8 dictionaries can be stored in a binary file.");
+        writeBinary(dict->getNumDicts());
+        const DictionaryState * states = dict->getStateArray();
+        const std::pair<KinkakuChar,unsigned> * gotos = dict->getGotoArray();
+        writeVarint(dict->getNumStates());
+        int64_t lastOutput = 0;
+        for(unsigned i = 0; i < dict->getNumStates(); i++) {
+            const DictionaryState & state = states[i];
+            writeVarint(((uint64_t)state.numGotos() << 1) | (state.isBranch?1:0));
+            writeVarint(state.failure);
+            if(state.isBranch) {
+                writeSigned((int64_t)state.output - lastOutput);
+                lastOutput = state.output;
+            }
+            int64_t lastChar = 0, lastTarget = i;
+            for(unsigned j = state.gotoBegin; j < state.gotoEnd; j++) {
+                writeSigned((int64_t)gotos[j].first - lastChar);
+                writeSigned((int64_t)gotos[j].second - lastTarget);
+                lastChar = gotos[j].first;
+                lastTarget = gotos[j].second;
+            }
+        }
+        const std::vector<Entry*> & entries = dict->getEntries();
+        writeVarint(entries.size());
+        for(unsigned i = 0; i < entries.size(); i++)
+            writeEntry(entries[i]);
+    }
+
+    template <class Entry>
+    Dictionary<Entry> * readCompactDictionary() {
+        unsigned numDicts = readBinary<unsigned char>();
+        unsigned numStates = readVarint();
+        if(numStates == 0)
+            return 0;
+        Dictionary<Entry> * dict = new Dictionary<Entry>(util_);
+        dict->setNumDicts(numDicts);
+        std::vector<DictionaryState> & states = dict->getStates();
+        typename Dictionary<Entry>::Gotos & gotos = dict->getGotos();
+        try {
+            states.resize(numStates);
+            gotos.reserve(numStates-1);
+            int64_t lastOutput = 0;
+            for(unsigned i = 0; i < numStates; i++) {
+                DictionaryState & state = states[i];
+                uint64_t head = readVarint();
+                state.isBranch = (head & 1);
+                state.failure = readVarint();
+                if(state.isBranch)
+                    state.output = (lastOutput += readSigned());
+                state.gotoBegin = gotos.size();
+                gotos.resize(gotos.size() + (head >> 1));
+                state.gotoEnd = gotos.size();
+                int64_t lastChar = 0, lastTarget = i;
+                for(unsigned j = state.gotoBegin; j < state.gotoEnd; j++) {
+                    gotos[j].first = (lastChar += readSigned());
+                    gotos[j].second = (lastTarget += readSigned());
+                    if(gotos[j].second >= numStates)
+                        THROW_ERROR("Compact model has a corrupted dictionary");
+                }
+            }
+            dict->buildOutputLinks();
+            dict->buildDenseGotos();
+            readCompactEntries(dict);
+        } catch(...) {
+            delete dict;
+            throw;
+        }
+        return dict;
+    }
+
+    template <class Entry>
+    void readCompactEntries(Dictionary<Entry> * dict) {
+        std::vector<Entry*> & entries = dict->getEntries();
+        entries.resize(readVarint(), 0);
+        for(unsigned i = 0; i < entries.size(); i++)
+            entries[i] = readEntry<Entry>();
+        dict->compactEntries(arena_, hugePages_);
+        dict->packArrays(0, arena_, hugePages_);
+    }
+    void readCompactEntries(Dictionary<FeatVec> * dict);
+
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#ifndef MODEL_IO_MAPPED_H__
+#define MODEL_IO_MAPPED_H__
+
+#include <kinkaku/model-io-binary.h>
+#include <kinkaku/mapped-file.h>
+
+namespace kinkaku {
+
+// The binary format, but with the dictionary automata, the feature
+// weights and the tables that index them written as aligned arrays in
+// the byte order of this machine. When reading, the file is mapped into
+// memory and these arrays are used where they are, so they are shared by
+// every process that loads the same model.
+class MappedModelIO : public BinaryModelIO {
+
+public:
+
+    MappedModelIO(StringUtil* util, const char* file, bool out) : BinaryModelIO(util,file,out) { }
+    MappedModelIO(StringUtil* util, std::iostream & str, bool out) : BinaryModelIO(util,str,out) { }
+    MappedModelIO(StringUtil* util, MappedFile * file, size_t pos) : BinaryModelIO(util,file,pos) { }
+
+    void writeConfig(const KinkakuConfig & conf);
+    void writeModelDictionary(const Dictionary<ModelTagEntry> * dict) { writeMappedDictionary(dict); }
+    void writeProbDictionary(const Dictionary<ProbTagEntry> * dict) { writeMappedDictionary(dict); }
+    void writeVectorDictionary(const Dictionary<FeatVec> * dict) { writeMappedDictionary(dict); }
+    void writeFeatVec(const FeatVec * vec);
+
+    void readConfig(KinkakuConfig & conf);
+    Dictionary<ModelTagEntry> * readModelDictionary() { return readMappedDictionary<ModelTagEntry>(); }
+    Dictionary<ProbTagEntry> * readProbDictionary()  { return readMappedDictionary<ProbTagEntry>(); }
+    Dictionary<FeatVec> * readVectorDictionary()  { return readMappedDictionary<FeatVec>(); }
+    FeatVec * readFeatVec();
+    FeatureLookup * readFeatureLookup();
+
+protected:
+
+    // Arrays start at a multiple of 8 bytes from the start of the file
+    void writeArray(const void * data, size_t size);
+    const char * readArray(size_t size);
+
+    LocalModelTable * createLocalModels();
+    BinaryModelIO * createReader(size_t pos) { return new MappedModelIO(util_, buf_->getFile(), pos); }
+    void skipVectorDictionary();
+    void skipFeatVec();
+
+    template <class Entry>
+    void writeMappedEntries(const std::vector<Entry*> & entries) {
+        writeBinary((uint32_t)entries.size());
+        for(unsigned i = 0; i < entries.size(); i++)
+            writeEntry(entries[i]);
+    }
+    void writeMappedEntries(const std::vector<FeatVec*> & entries);
+
+    template <class Entry>
+    void readMappedEntries(Dictionary<Entry> * dict) {
+        std::vector<Entry*> & entries = dict->getEntries();
+        entries.resize(readBinary<uint32_t>(), 0);
+        for(unsigned i = 0; i < entries.size(); i++)
+            entries[i] = readEntry<Entry>();
+        dict->compactEntries(arena_, hugePages_);
+    }
+    void readMappedEntries(Dictionary<FeatVec> * dict);
+
+    template <class Entry>
+    void writeMappedDictionary(const Dictionary<Entry> * dict) {
+        if(dict == 0 || dict->getNumStates() == 0) {
+            writeBinary((unsigned char)0);
+            writeBinary((uint32_t)0);
+            return;
+        }
+        if(dict->getNumDicts() > 8)
+            THROW_ERROR("Only 8 dictionaries can be stored in a binary file.");
+        std::vector<DictionaryState> states;
+        typename Dictionary<Entry>::Gotos gotos;
+        dict->getPackedArrays(states, gotos);
+        writeBinary(dict->getNumDicts());
+        writeBinary((uint32_t)states.size());
+        writeBinary((uint32_t)gotos.size());
+        writeBinary((uint32_t)dict->getNumDense());
+        writeArray(&states[0], states.size()*sizeof(DictionaryState));
+        writeArray((gotos.size() ? &gotos[0] : 0), gotos.size()*sizeof(gotos[0]));
+        writeArray(dict->getDenseArray(), dict->getNumDense()*sizeof(unsigned));
+        writeMappedEntries(dict->getEntries());
+    }
+
+    template <class Entry>
+    Dictionary<Entry> * readMappedDictionary() {
+        unsigned numDicts = readBinary<unsigned char>();
+        unsigned numStates = readBinary<uint32_t>();
+        if(numStates == 0)
+            return 0;
+        unsigned numGotos = readBinary<uint32_t>();
+        unsigned numDense = readBinary<uint32_t>();
+        const DictionaryState * states = (const DictionaryState *)readArray(numStates*sizeof(DictionaryState));
+        const std::pair<KinkakuChar,unsigned> * gotos = (const std::pair<KinkakuChar,unsigned> *)readArray(numGotos*sizeof(gotos[0]));
+        const unsigned * dense = (const unsigned *)readArray(numDense*sizeof(unsigned));
+        Dictionary<Entry> * dict = new Dictionary<Entry>(util_);
+        dict->setNumDicts(numDicts);
+        dict->setMappedArrays(buf_->getFile(), states, numStates, gotos, numGotos, dense, numDense);
+        try {
+            readMappedEntries(dict);
+        } catch(...) {
+            delete dict;
+            throw;
+        }
+        return dict;
+    }
+
+};
+
+}
+
+#endif
@@ -62,21 +62,20 @@ public:
             return;
         }
         *str_ << (unsigned)dict->getNumDicts() << std::endl;
-        const std::vector<DictionaryState*> & states = dict->getStates();
-        *str_ << states.size() << std::endl;
-        if(states.size() == 0)
+        const DictionaryState * states = dict->getStateArray();
+        const std::pair<KinkakuChar,unsigned> * gotos = dict->getGotoArray();
+        *str_ << dict->getNumStates() << std::endl;
+        if(dict->getNumStates() == 0)
             return;
-        for(unsigned i = 0; i < states.size(); i++) {
-            *str_ << states[i]->failure;
-            for(unsigned j = 0; j < states[i]->gotos.size(); j++)
-                *str_ << " " << util_->showChar(states[i]->gotos[j].first) << " " << states[i]->gotos[j].second;
+        for(unsigned i = 0; i < dict->getNumStates(); i++) {
+            *str_ << states[i].failure;
+            for(unsigned j = states[i].gotoBegin; j < states[i].gotoEnd; j++)
+                *str_ << " " << util_->showChar(gotos[j].first) << " " << gotos[j].second;
             *str_ << std::endl;
-            for(unsigned j = 0; j < states[i]->output.size(); j++) {
-                if(j!=0) *str_ << " ";
-                *str_ << states[i]->output[j];
-            }
+            if(states[i].isBranch)
+                *str_ << states[i].output;
             *str_ << std::endl;
-            *str_ << (states[i]->isBranch?'b':'n') << std::endl;
+            *str_ << (states[i].isBranch?'b':'n') << std::endl;
         }
         const std::vector<Entry*> & entries = dict->getEntries();
         *str_ << entries.size() << std::endl;
@@ -106,7 +105,8 @@ public:
         std::string line, buff;
         std::getline(*str_, line);
         dict->setNumDicts(util_->parseInt(line.c_str()));
-        std::vector<DictionaryState*> & states = dict->getStates();
+        std::vector<DictionaryState> & states = dict->getStates();
+        typename Dictionary<Entry>::Gotos & gotos = dict->getGotos();
         getline(*str_, line);
         states.resize(util_->parseInt(line.c_str()));
         if(states.size() == 0) {
@@ -114,29 +114,31 @@ public:
             return 0;
         }
         for(unsigned i = 0; i < states.size(); i++) {
-            DictionaryState * state = new DictionaryState();
+            DictionaryState & state = states[i];
             getline(*str_, line);
             std::istringstream iss(line);
             iss >> buff;
-            state->failure = util_->parseInt(buff.c_str());
+            state.failure = util_->parseInt(buff.c_str());
+            state.gotoBegin = gotos.size();
             while(iss >> buff) {
                 std::pair<KinkakuChar,unsigned> p;
                 p.first = util_->mapChar(buff.c_str());
                 if(!(iss >> buff))
                     THROW_ERROR("Bad form model (goto character without a destination)");
                 p.second = util_->parseInt(buff.c_str());
-                state->gotos.push_back(p);
+                gotos.push_back(p);
             }
-            sort(state->gotos.begin(), state->gotos.end());
+            state.gotoEnd = gotos.size();
+            sort(gotos.begin()+state.gotoBegin, gotos.end());
             getline(*str_, line);
+            // older models list all outputs, but the state's own comes first
             std::istringstream iss2(line);
-            while(iss2 >> buff)
-                state->output.push_back(util_->parseInt(buff.c_str()));
+            if(iss2 >> buff)
+                state.output = util_->parseInt(buff.c_str());
             getline(*str_, line);
             if(line.length() != 1)
                 THROW_ERROR("Bad form model (branch indicator not found)");
-            state->isBranch = (line[0] == 'b');
-            states[i] = state;
+            state.isBranch = (line[0] == 'b');
         }
         std::vector<Entry*> & entries = dict->getEntries();
         getline(*str_, line);
@@ -144,6 +146,9 @@ public:
         for(unsigned i = 0; i < entries.size(); i++) {
             entries[i] = readEntry<Entry>();
         }
+        dict->buildOutputLinks();
+        dict->buildDenseGotos();
+        dict->compactEntries();
         return dict;
     }
 
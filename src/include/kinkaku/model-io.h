@@ -32,10 +32,28 @@
 #include <kinkaku/feature-vector.h>
 #include <vector>
 
+// models from 1.0.0 store every output of each dictionary state,
+// models from 1.1.0 store every local tag model in full rather than
+// referring to an earlier copy, and models from 1.2.0 have no table of
+// sections, and all can still be read. Mapped models have their own
+// version, where 2.0.0 stores every local model in full and 2.1.0 has no
+// table of sections.
 #if DISABLE_QUANTIZE
-#   define MODEL_IO_VERSION "1.0.0NQ"
+#   define MODEL_IO_VERSION "1.3.0NQ"
+#   define MODEL_IO_VERSION_1_2 "1.2.0NQ"
+#   define MODEL_IO_VERSION_1_1 "1.1.0NQ"
+#   define MODEL_IO_VERSION_1_0 "1.0.0NQ"
+#   define MODEL_IO_VERSION_MAPPED "2.2.0NQ"
+#   define MODEL_IO_VERSION_MAPPED_2_1 "2.1.0NQ"
+#   define MODEL_IO_VERSION_MAPPED_2_0 "2.0.0NQ"
 #else
-#   define MODEL_IO_VERSION "1.0.0"
+#   define MODEL_IO_VERSION "1.3.0"
+#   define MODEL_IO_VERSION_1_2 "1.2.0"
+#   define MODEL_IO_VERSION_1_1 "1.1.0"
+#   define MODEL_IO_VERSION_1_0 "1.0.0"
+#   define MODEL_IO_VERSION_MAPPED "2.2.0"
+#   define MODEL_IO_VERSION_MAPPED_2_1 "2.1.0"
+#   define MODEL_IO_VERSION_MAPPED_2_0 "2.0.0"
 #endif
 
 namespace kinkaku {
@@ -45,6 +63,7 @@ class KinkakuModel;
 class KinkakuLM;
 class ModelTagEntry;
 class ProbTagEntry;
+class LocalModelTable;
 
 class ModelIO : public GeneralIO {
 
@@ -53,21 +72,40 @@ public:
     typedef char Format;
     const static Format FORMAT_BINARY = 'B';
     const static Format FORMAT_TEXT = 'T';
+    const static Format FORMAT_MAPPED = 'M';
+    const static Format FORMAT_COMPACT = 'C';
     const static Format FORMAT_UNKNOWN = 'U';
 
     int numTags_;
 
+protected:
+
+    // whether large arenas built while reading should use huge pages
+    bool hugePages_;
+    // where entries whose local models were never read get them from
+    const LocalModelTable * localSource_;
+    // whether local models are kept when reading a model dictionary
+    bool readLocalModels_;
+
+    // The local model of an entry to write, which is a new copy if it had
+    // to be decoded from localSource_
+    const KinkakuModel * getEntryModel(const ModelTagEntry * entry, int lev, KinkakuModel * & decoded);
+
 public:
 
-    ModelIO(StringUtil* util) : GeneralIO(util) { }
-    ModelIO(StringUtil* util, const char* file, bool out, bool bin) : GeneralIO(util,file,out,bin) { }
-    ModelIO(StringUtil* util, std::iostream & str, bool out, bool bin) : GeneralIO(util,str,out,bin) { }
+    ModelIO(StringUtil* util) : GeneralIO(util), hugePages_(false), localSource_(0), readLocalModels_(true) { }
+    ModelIO(StringUtil* util, const char* file, bool out, bool bin) : GeneralIO(util,file,out,bin), hugePages_(false), localSource_(0), readLocalModels_(true) { }
+    ModelIO(StringUtil* util, std::iostream & str, bool out, bool bin) : GeneralIO(util,str,out,bin), hugePages_(false), localSource_(0), readLocalModels_(true) { }
 
     virtual ~ModelIO() { }
 
     static ModelIO* createIO(const char* file, Format form, bool output, KinkakuConfig & config);
     static ModelIO* createIO(std::iostream & str, Format form, bool output, KinkakuConfig & config);
 
+    void setHugePages(bool hugePages) { hugePages_ = hugePages; }
+    void setLocalModelSource(const LocalModelTable * source) { localSource_ = source; }
+    void setReadLocalModels(bool readLocalModels) { readLocalModels_ = readLocalModels; }
+
     virtual void writeConfig(const KinkakuConfig & conf) = 0;
     virtual void writeModel(const KinkakuModel * mod) = 0;
     virtual void writeWordList(const std::vector<KinkakuString> & list) = 0;
@@ -90,6 +128,22 @@ public:
     virtual void writeFeatureLookup(const FeatureLookup * featLookup) = 0;
     virtual FeatureLookup * readFeatureLookup() = 0;
 
+    // Formats that can decode local tag models when they are first used
+    // give the table of them after readModelDictionary, and the caller
+    // then owns it
+    virtual LocalModelTable * takeLocalModels() { return 0; }
+
+    // A model is written as the word segmentation model, the word list
+    // and model of each tag, the model dictionary, the subword dictionary
+    // and the language model of each tag. Formats that keep a table of
+    // where each of these sections starts are told before each is
+    // written, and give a reader for any section, with the settings of
+    // this one, that the caller then owns.
+    static unsigned getNumSections(int numTags) { return 2*numTags+3; }
+    virtual void markSection() { }
+    virtual unsigned getNumSections() const { return 0; }
+    virtual ModelIO * openSection(unsigned) { return 0; }
+
 };
 
 }
@@ -29,6 +29,7 @@
 
 #include <kinkaku/kinkaku-struct.h>
 #include <sstream>
+#include <pthread.h>
 
 namespace kinkaku {
 
@@ -51,25 +52,53 @@ public:
 
     GenericMap<KinkakuChar,KinkakuChar> * normMap_;
 
+private:
+
+    // the normalized form and type id of every possible character id,
+    // built on first use
+    KinkakuChar * normTable_;
+    KinkakuChar * typeTable_;
+    pthread_mutex_t tableMutex_;
+
+    const KinkakuChar * buildNormTable();
+    const KinkakuChar * buildTypeTable();
+
 public:
 
-    StringUtil() : normMap_(NULL) { }
+    StringUtil() : normMap_(NULL), normTable_(NULL), typeTable_(NULL) {
+        pthread_mutex_init(&tableMutex_, 0);
+    }
 
     virtual ~StringUtil() {
         if(normMap_) delete normMap_;    
+        if(normTable_) delete [] normTable_;
+        if(typeTable_) delete [] typeTable_;
+        pthread_mutex_destroy(&tableMutex_);
     }
 
     virtual KinkakuChar mapChar(const std::string & str, bool add = true) = 0;
     virtual std::string showChar(KinkakuChar c) = 0;
 
     std::string showString(const KinkakuString & c) {
-        std::ostringstream buff;
+        std::string ret;
+        ret.reserve(c.length()*3);
+        showString(c, ret);
+        return ret;
+    }
+    // append the characters of c to out
+    void showString(const KinkakuString & c, std::string & out) {
         for(unsigned i = 0; i < c.length(); i++)
-            buff << showChar(c[i]);
-        return buff.str();
+            out += showChar(c[i]);
     }
 
     virtual KinkakuString mapString(const std::string & str) = 0;
+    // map str into out, reusing out's storage where the encoding allows
+    virtual void mapString(const std::string & str, KinkakuString & out) { out = mapString(str); }
+    // map str into surface and its normalized form into norm
+    virtual void mapString(const std::string & str, KinkakuString & surface, KinkakuString & norm) {
+        mapString(str, surface);
+        normalize(surface, norm);
+    }
 
     virtual CharType findType(const std::string & str) = 0;
     virtual CharType findType(KinkakuChar c) = 0;
@@ -81,7 +110,16 @@ public:
     virtual std::string serialize() const = 0;
     
     virtual GenericMap<KinkakuChar,KinkakuChar> * getNormMap() = 0;
-    KinkakuString normalize(const KinkakuString & str);
+    const KinkakuChar * getNormTable() {
+        const KinkakuChar * table = __atomic_load_n(&normTable_, __ATOMIC_ACQUIRE);
+        return table ? table : buildNormTable();
+    }
+    KinkakuString normalize(const KinkakuString & str) {
+        KinkakuString ret;
+        normalize(str, ret);
+        return ret;
+    }
+    void normalize(const KinkakuString & str, KinkakuString & out);
 
     void checkEqual(const StringUtil & rhs) const;
 
@@ -89,11 +127,18 @@ public:
     double parseFloat(const char* str);
 
     std::string getTypeString(const KinkakuString& str) {
-        std::ostringstream buff;
+        std::string ret;
+        getTypeString(str, ret);
+        return ret;
+    }
+    void getTypeString(const KinkakuString& str, std::string & out) {
+        out.resize(str.length());
         for(unsigned i = 0; i < str.length(); i++)
-            buff << findType(str[i]);
-        return buff.str();
+            out[i] = findType(str[i]);
     }
+    // the ids of the characters of str's type string, the same as
+    // mapString(getTypeString(str)) without building the string
+    virtual void getTypeIds(const KinkakuString & str, KinkakuString & out);
 
 
 };
@@ -104,25 +149,69 @@ private:
     
     const static char maskr6 = 63, maskr5 = 31, maskr4 = 15, maskr3 = 7, maskl1 = 1 << 7, maskl2 = 3 << 6, maskl3 = 7 << 5, maskl4 = 15 << 4, maskl5 = 31 << 3;
 
+    // Characters are only added under charMutex_, while other threads
+    // sharing the util may be reading. The vectors below are reserved for
+    // every possible id so that they never move, and a character's name
+    // and types are stored before its id is published in idPages_.
+    pthread_mutex_t charMutex_;
     StringCharMap charIds_;
     std::vector<std::string> charNames_;
     std::vector<CharType> charTypes_;
+    // the ids of the type characters of each character, or 0 when the
+    // type character has not been mapped yet. They are only written by
+    // mapChar, and those already published are changed atomically.
+    std::vector<KinkakuChar> charTypeIds_;
+    // the ids of characters by code point, in pages of 256 that are only
+    // allocated once one of their characters is seen (0 is not seen)
+    std::vector<KinkakuChar*> idPages_;
+
+    KinkakuChar addChar(const std::string & str, bool add);
+    void setCodePointId(const std::string & str, KinkakuChar id);
+    void clearCodePoints();
+    static KinkakuChar loadId(const KinkakuChar * id) {
+        return __atomic_load_n(id, __ATOMIC_ACQUIRE);
+    }
+    KinkakuChar mapCodePoint(unsigned val, const char * str, unsigned len) {
+        const KinkakuChar * page = __atomic_load_n(&idPages_[val >> 8], __ATOMIC_ACQUIRE);
+        KinkakuChar id = (page ? loadId(page + (val & 0xFF)) : 0);
+        return (id ? id : mapChar(std::string(str, len)));
+    }
+    void throwBadUtf8(const std::string & str);
+    KinkakuChar findTypeId(CharType type) {
+        StringCharMap::const_iterator it = charIds_.find(std::string(1, type));
+        return (it == charIds_.end() ? 0 : it->second);
+    }
+    void decodeString(const std::string & str, KinkakuString & out, KinkakuString * norm);
 
 public:
 
     StringUtilUtf8();
 
-    ~StringUtilUtf8() { }
+    ~StringUtilUtf8() {
+        clearCodePoints();
+        pthread_mutex_destroy(&charMutex_);
+    }
     
     KinkakuChar mapChar(const std::string & str, bool add = true);
     std::string showChar(KinkakuChar c);
 
     CharType findType(KinkakuChar c);
+    void getTypeIds(const KinkakuString & str, KinkakuString & out);
 
     GenericMap<KinkakuChar,KinkakuChar> * getNormMap();
 
     bool badu(char val) { return ((val ^ maskl1) & maskl2); }
-    KinkakuString mapString(const std::string & str);
+    KinkakuString mapString(const std::string & str) {
+        KinkakuString ret;
+        mapString(str, ret);
+        return ret;
+    }
+    void mapString(const std::string & str, KinkakuString & out) {
+        decodeString(str, out, 0);
+    }
+    void mapString(const std::string & str, KinkakuString & surface, KinkakuString & norm) {
+        decodeString(str, surface, &norm);
+    }
 
     CharType findType(const std::string & str);
 
@@ -151,7 +240,13 @@ public:
     
     GenericMap<KinkakuChar,KinkakuChar> * getNormMap();
 
-    KinkakuString mapString(const std::string & str);
+    KinkakuString mapString(const std::string & str) {
+        KinkakuString ret;
+        mapString(str, ret);
+        return ret;
+    }
+    void mapString(const std::string & str, KinkakuString & out);
+    void mapString(const std::string & str, KinkakuString & surface, KinkakuString & norm);
 
     CharType findType(const std::string & str);
     CharType findType(KinkakuChar c);
@@ -179,7 +274,13 @@ public:
 
     std::string showChar(KinkakuChar c);
     
-    KinkakuString mapString(const std::string & str);
+    KinkakuString mapString(const std::string & str) {
+        KinkakuString ret;
+        mapString(str, ret);
+        return ret;
+    }
+    void mapString(const std::string & str, KinkakuString & out);
+    void mapString(const std::string & str, KinkakuString & surface, KinkakuString & norm);
 
     CharType findType(const std::string & str);
     CharType findType(KinkakuChar c);
@@ -49,7 +49,9 @@ KinkakuSentence * FullCorpusIO::readSentence() {
         return 0;
 
     KinkakuChar spaceChar = bounds_[0], slashChar = bounds_[1], ampChar = bounds_[2], bsChar = bounds_[3];
-    KinkakuString ks = util_->mapString(s), buff(ks.length());
+    KinkakuString ks, nks;
+    util_->mapString(s, ks, nks);
+    KinkakuString buff(ks.length()), nbuff(ks.length());
     int len = ks.length();
     KinkakuSentence * ret = new KinkakuSentence();
     int charLen = 0;
@@ -63,6 +65,7 @@ KinkakuSentence * FullCorpusIO::readSentence() {
             } else if(ks[j] == bsChar && ++j == len) {
                 THROW_ERROR("Illegal trailing escape character at "<<s);
             }
+            nbuff[bpos] = nks[j];
             buff[bpos++] = ks[j];
         }
         if(bpos == 0) {
@@ -72,7 +75,7 @@ KinkakuSentence * FullCorpusIO::readSentence() {
                 THROW_ERROR("Empty word at position "<<j<<" in "<<s);
         }
         KinkakuString word_str = buff.substr(0,bpos);
-        KinkakuWord word(word_str, util_->normalize(word_str));
+        KinkakuWord word(word_str, nbuff.substr(0,bpos));
         charLen += bpos;
         lev = -1;
         while(j < len && ks[j] != spaceChar) {
@@ -107,23 +110,28 @@ KinkakuSentence * FullCorpusIO::readSentence() {
 
 void FullCorpusIO::writeSentence(const KinkakuSentence * sent, double conf) {
     const string & wb = util_->showChar(bounds_[0]), tb = util_->showChar(bounds_[1]), eb = util_->showChar(bounds_[2]);
+    line_.clear();
     for(unsigned i = 0; i < sent->words.size(); i++) {
-        if(i != 0) *str_ << wb;
+        if(i != 0) line_ += wb;
         const KinkakuWord & w = sent->words[i];
-        if(printWords_) *str_ << util_->showString(w.surface);
+        if(printWords_) util_->showString(w.surface, line_);
         int printed = 0;
         for(int j = 0; j < w.getNumTags(); j++) {
             const vector< KinkakuTag > & tags = w.getTags(j);
             if(tags.size() > 0) {
-                *str_ << ((printWords_ || printed++ > 0) ? tb : "") << util_->showString(tags[0].first);
+                if(printWords_ || printed++ > 0) line_ += tb;
+                util_->showString(tags[0].first, line_);
                 if(allTags_) 
-                    for(unsigned k = 1; k < tags.size(); k++) 
-                        *str_ << eb << util_->showString(tags[k].first);
+                    for(unsigned k = 1; k < tags.size(); k++) {
+                        line_ += eb;
+                        util_->showString(tags[k].first, line_);
+                    }
             }
         }
         if(w.getUnknown())
-            *str_ << unkTag_;
+            line_ += unkTag_;
     }
+    str_->write(line_.data(), line_.size());
     *str_ << endl;
 }
 
@@ -47,7 +47,9 @@ KinkakuSentence * PartCorpusIO::readSentence() {
     getline(*str_, s);
     if(str_->eof())
         return 0;
-    KinkakuString ks = util_->mapString(s), buff(ks.length());
+    KinkakuString ks, nks;
+    util_->mapString(s, ks, nks);
+    KinkakuString buff(ks.length()), nbuff(ks.length());
     KinkakuChar ukBound = bounds_[0], skipBound = bounds_[1], noBound = bounds_[2], 
         hasBound = bounds_[3], slashChar = bounds_[4], elemChar = bounds_[5], 
         escapeChar = bounds_[6];
@@ -62,6 +64,7 @@ KinkakuSentence * PartCorpusIO::readSentence() {
                 THROW_ERROR("Misplaced character '"<<util_->showChar(ks[j])<<"' in "<<s);
             if(ks[j] == escapeChar && ++j >= len)
                 THROW_ERROR("Misplaced escape at the end of "<<s);
+            nbuff[bpos] = nks[j];
             buff[bpos++] = ks[j++];
             if(j >= len || ks[j] == slashChar || ks[j] == hasBound) 
                 break;
@@ -74,7 +77,7 @@ KinkakuSentence * PartCorpusIO::readSentence() {
                 ret->wsConfs.push_back(PROB_FALSE);
         }
         KinkakuString word_str = buff.substr(0,bpos);
-        KinkakuWord word(word_str, util_->normalize(word_str));
+        KinkakuWord word(word_str, nbuff.substr(0,bpos));
         charLen += bpos;
         word.isCertain = cert;
         bpos = 0;
@@ -47,13 +47,26 @@ KinkakuSentence * RawCorpusIO::readSentence() {
     if(str_->eof())
         return 0;
     KinkakuSentence * ret = new KinkakuSentence();
-    ret->surface = util_->mapString(s);
-    ret->norm = util_->normalize(ret->surface);
+    util_->mapString(s, ret->surface, ret->norm);
     if(ret->surface.length() != 0)
         ret->wsConfs.resize(ret->surface.length()-1,0);
     return ret;
 }
 
+bool RawCorpusIO::readSentence(KinkakuSentence & sent) {
+#ifdef KINKAKU_SAFE
+    if(out_ || !str_) 
+        THROW_ERROR("Attempted to read a sentence from an closed or output object");
+#endif
+    getline(*str_, line_);
+    if(str_->eof())
+        return false;
+    util_->mapString(line_, sent.surface, sent.norm);
+    sent.wsConfs.assign(max(sent.surface.length(),(unsigned)1)-1, 0);
+    sent.words.clear();
+    return true;
+}
+
 void RawCorpusIO::writeSentence(const KinkakuSentence * sent, double conf)  {
     *str_ << util_->showString(sent->surface) << endl;
 }
\ No newline at end of file
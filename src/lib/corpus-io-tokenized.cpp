@@ -49,7 +49,9 @@ KinkakuSentence * TokenizedCorpusIO::readSentence() {
         return 0;
 
     KinkakuChar spaceChar = bounds_[0];
-    KinkakuString ks = util_->mapString(s), buff(ks.length());
+    KinkakuString ks, nks;
+    util_->mapString(s, ks, nks);
+    KinkakuString buff(ks.length()), nbuff(ks.length());
     int len = ks.length();
     KinkakuSentence * ret = new KinkakuSentence();
     int charLen = 0;
@@ -57,8 +59,10 @@ KinkakuSentence * TokenizedCorpusIO::readSentence() {
     int j = 0, bpos;
     for(j = 0; j < len; j++) {
         bpos = 0;
-        for( ; j < len && ks[j] != spaceChar; j++)
+        for( ; j < len && ks[j] != spaceChar; j++) {
+            nbuff[bpos] = nks[j];
             buff[bpos++] = ks[j];
+        }
         if(bpos == 0) {
             if(ks[j] == spaceChar)
                 continue;
@@ -66,7 +70,7 @@ KinkakuSentence * TokenizedCorpusIO::readSentence() {
                 THROW_ERROR("Empty word at position "<<j<<" in "<<s);
         }
         KinkakuString word_str = buff.substr(0,bpos);
-        KinkakuWord word(word_str, util_->normalize(word_str));
+        KinkakuWord word(word_str, nbuff.substr(0,bpos));
         charLen += bpos;
         ret->words.push_back(word);
     }
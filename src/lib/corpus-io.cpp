@@ -33,6 +33,7 @@
 #include <kinkaku/corpus-io-part.h>
 #include <kinkaku/corpus-io-prob.h>
 #include <kinkaku/corpus-io-raw.h>
+#include <kinkaku/kinkaku-struct.h>
 #include <cmath>
 #include "config.h"
 
@@ -43,6 +44,15 @@
 using namespace kinkaku;
 using namespace std;
 
+bool CorpusIO::readSentence(KinkakuSentence & sent) {
+    KinkakuSentence * next = readSentence();
+    if(next == 0)
+        return false;
+    sent = *next;
+    delete next;
+    return true;
+}
+
 CorpusIO * CorpusIO::createIO(const char* file, Format form, const KinkakuConfig & conf, bool output, StringUtil* util) {
     if(form == CORP_FORMAT_FULL)      { return new FullCorpusIO(util,file,output,conf.getWordBound(),conf.getTagBound(),conf.getElemBound(),conf.getEscape()); }
     else if(form == CORP_FORMAT_TAGS)      { 
@@ -30,7 +30,15 @@
 #include <kinkaku/kinkaku-model.h>
 #include <kinkaku/string-util.h>
 #include <kinkaku/feature-vector.h>
+#include <kinkaku/kinkaku-thread.h>
+#include <kinkaku/kinkaku-struct.h>
+#include <kinkaku/mapped-file.h>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <cstring>
+#include <new>
 
 using namespace kinkaku;
 using namespace std;
@@ -56,8 +64,8 @@ double ProbTagEntry::incrementProb(const KinkakuString & str, int lev) {
 
 template <class Entry>
 void Dictionary<Entry>::checkEqual(const Dictionary<Entry> & rhs) const {
-    if(states_.size() != rhs.states_.size())
-        THROW_ERROR("states_.size() != rhs.states_.size() ("<<states_.size()<<" != "<<rhs.states_.size());
+    if(numStates_ != rhs.numStates_)
+        THROW_ERROR("numStates_ != rhs.numStates_ ("<<numStates_<<" != "<<rhs.numStates_);
     if(entries_.size() != rhs.entries_.size())
         THROW_ERROR("entries_.size() != rhs.entries_.size() ("<<entries_.size()<<" != "<<rhs.entries_.size());
     if(numDicts_ != rhs.numDicts_)
@@ -65,95 +73,534 @@ void Dictionary<Entry>::checkEqual(const Dictionary<Entry> & rhs) const {
 }
 
 template <class Entry>
-void Dictionary<Entry>::buildGoto(wm_const_iterator start, wm_const_iterator end, unsigned lev, unsigned nid) {
-#ifdef KINKAKU_SAFE
-    if(start == end) return;
-    if(nid >= states_.size())
-        THROW_ERROR("Out of bounds node in buildGoto ("<<nid<<" >= "<<states_.size()<<")");
-#endif
-    wm_const_iterator startCopy = start;
-    DictionaryState & node = *states_[nid];
-    if(startCopy->first.length() == lev) {
-        node.output.push_back(entries_.size());
-        node.isBranch = true;
-        entries_.push_back(startCopy->second);
-        startCopy++;
+void Dictionary<Entry>::buildGotos(const WordList & input, vector<unsigned> & levels) {
+    // states are created breadth first, so each level of the trie is a
+    // contiguous range of states starting at levels[lev]
+    vector< pair<unsigned,unsigned> > ranges(1, pair<unsigned,unsigned>(0,input.size())), next;
+    states_.resize(1);
+    levels.push_back(0);
+    for(unsigned lev = 0; ranges.size() > 0; lev++) {
+        unsigned levelStart = levels[lev], nextStart = levelStart+ranges.size();
+        next.clear();
+        for(unsigned i = 0; i < ranges.size(); i++) {
+            DictionaryState & node = states_[levelStart+i];
+            unsigned start = ranges[i].first, end = ranges[i].second;
+            if(input[start].first.length() == lev) {
+                node.isBranch = true;
+                node.output = start++;
+            }
+            node.gotoBegin = gotos_.size();
+            while(start != end) {
+                KinkakuChar c = input[start].first[lev];
+                unsigned binEnd = start+1;
+                while(binEnd != end && input[binEnd].first[lev] == c)
+                    binEnd++;
+                gotos_.push_back(pair<KinkakuChar,unsigned>(c, nextStart+next.size()));
+                next.push_back(pair<unsigned,unsigned>(start, binEnd));
+                start = binEnd;
+            }
+            node.gotoEnd = gotos_.size();
+        }
+        ranges.swap(next);
+        states_.resize(nextStart+ranges.size());
+        levels.push_back(nextStart);
     }
-    if(startCopy == end) return;
-    wm_const_iterator binEnd = startCopy, binStart;
-    unsigned numBins = 0;
-    KinkakuChar lastChar = binEnd->first[lev];
-    do {
-        binEnd++;
-        KinkakuChar nextChar = (binEnd == end?0:binEnd->first[lev]);
-        if(nextChar != lastChar) {
-            numBins++;
-            lastChar = nextChar;
+}
+
+template <class Entry>
+class DictionaryFailureTask : public ParallelTask {
+public:
+    DictionaryFailureTask(Dictionary<Entry> & dict, unsigned start) : dict_(dict), start_(start) { }
+    void run(unsigned begin, unsigned end) {
+        vector<DictionaryState> & states = dict_.getStates();
+        const typename Dictionary<Entry>::Gotos & gotos = dict_.getGotos();
+        for(unsigned r = start_+begin; r < start_+end; r++) {
+            for(unsigned i = states[r].gotoBegin; i < states[r].gotoEnd; i++) {
+                KinkakuChar a = gotos[i].first;
+                unsigned state = states[r].failure, trans = 0;
+                if(r != 0) {
+                    while((trans = dict_.step(state, a)) == 0 && (state != 0))
+                        state = states[state].failure;
+                }
+                DictionaryState & next = states[gotos[i].second];
+                next.failure = trans;
+                next.outputLink = (states[trans].isBranch ? trans : states[trans].outputLink);
+            }
         }
-    } while(binEnd != end);
-    node.gotos.reserve(numBins);
-    binStart = startCopy, binEnd = startCopy;
-    lastChar = binStart->first[lev];
-    do {
-        binEnd++;
-        KinkakuChar nextChar = (binEnd == end?0:binEnd->first[lev]);
-        if(nextChar != lastChar) {
-            unsigned nextNode = states_.size();
-            states_.push_back(new DictionaryState());
-            node.gotos.push_back(std::pair<KinkakuChar,unsigned>(lastChar,nextNode));
-            buildGoto(binStart,binEnd,lev+1,nextNode);
-            binStart = binEnd;
-            lastChar = nextChar;
+    }
+private:
+    Dictionary<Entry> & dict_;
+    unsigned start_;
+};
+
+template <class Entry>
+void Dictionary<Entry>::buildFailures(const vector<unsigned> & levels) {
+    // the failures and output links of one level depend only on those of
+    // shallower levels, so the states of each level can be processed in parallel
+    for(unsigned lev = 0; lev+1 < levels.size(); lev++) {
+        DictionaryFailureTask<Entry> task(*this, levels[lev]);
+        runParallel(task, levels[lev+1]-levels[lev], DICTIONARY_PARALLEL_MIN);
+    }
+}
+
+template <class Entry>
+void Dictionary<Entry>::buildOutputLinks() {
+    // states that were read from a file are not necessarily breadth first,
+    // so links are resolved along each failure chain
+    vector<bool> done(states_.size(), false);
+    vector<unsigned> chain;
+    if(states_.size())
+        done[0] = true;
+    for(unsigned i = 0; i < states_.size(); i++) {
+        for(unsigned s = i; !done[s]; s = states_[s].failure)
+            chain.push_back(s);
+        while(chain.size()) {
+            DictionaryState & state = states_[chain.back()];
+            const DictionaryState & fail = states_[state.failure];
+            state.outputLink = (state.failure != 0 && fail.isBranch ? state.failure : fail.outputLink);
+            done[chain.back()] = true;
+            chain.pop_back();
         }
-    } while(binEnd != end);
+    }
+    if(states_.size())
+        states_[0].outputLink = 0;
 }
 
 template <class Entry>
-void Dictionary<Entry>::buildFailures() {
-    if(states_.size() == 0)
+void Dictionary<Entry>::buildDense(unsigned state, bool force) {
+    DictionaryState & st = states_[state];
+    st.dense = 0;
+    unsigned size = st.numGotos();
+    if(size == 0 || (!force && size < DICTIONARY_DENSE_FANOUT))
+        return;
+    KinkakuChar first = gotos_[st.gotoBegin].first;
+    unsigned range = gotos_[st.gotoEnd-1].first - first + 1;
+    // the root's table is only forced past the fanout, as a sparse root
+    // would otherwise span every character id the dictionary starts with
+    if(range > size * DICTIONARY_DENSE_RATIO)
         return;
-    std::deque<unsigned> sq;
-    DictionaryState::Gotos & g0 = states_[0]->gotos;
-    for(unsigned i = 0; i < g0.size(); i++)
-        sq.push_back(g0[i].second);
-    while(sq.size() != 0) {
-        unsigned r = sq.front();
-        sq.pop_front();
-        DictionaryState::Gotos & gr = states_[r]->gotos;
-        for(unsigned i = 0; i < gr.size(); i++) {
-            KinkakuChar a = gr[i].first;
-            unsigned s = gr[i].second;
-            sq.push_back(s);
-            unsigned state = states_[r]->failure;
-            unsigned trans = 0;
-            while((trans = states_[state]->step(a)) == 0 && (state != 0))
-                state = states_[state]->failure;
-            states_[s]->failure = trans;
-            for(unsigned j = 0; j < states_[trans]->output.size(); j++)
-                states_[s]->output.push_back(states_[trans]->output[j]);
+    // each table is preceded by its size
+    dense_.push_back(range);
+    st.dense = dense_.size();
+    st.denseBase = first;
+    dense_.resize(dense_.size()+range, 0);
+    for(unsigned i = st.gotoBegin; i < st.gotoEnd; i++)
+        dense_[st.dense+gotos_[i].first-first] = gotos_[i].second;
+}
+
+template <class Entry>
+void Dictionary<Entry>::buildDenseGotos() {
+    dense_.clear();
+    for(unsigned i = 0; i < states_.size(); i++)
+        buildDense(i, i == 0);
+    updateArrays();
+}
+
+template <class Entry>
+void Dictionary<Entry>::updateArrays() {
+    stateArr_ = (states_.size() ? &states_[0] : 0);
+    gotoArr_ = (gotos_.size() ? &gotos_[0] : 0);
+    denseArr_ = (dense_.size() ? &dense_[0] : 0);
+    numStates_ = states_.size();
+    numGotos_ = gotos_.size();
+    numDense_ = dense_.size();
+}
+
+template <class Entry>
+void Dictionary<Entry>::unmap() {
+    if(mapped_)
+        mapped_->release();
+    mapped_ = 0;
+}
+
+template <class Entry>
+void Dictionary<Entry>::setMappedArrays(MappedFile * file, const DictionaryState * states, unsigned numStates, const std::pair<KinkakuChar,unsigned> * gotos, unsigned numGotos, const unsigned * dense, unsigned numDense) {
+    vector<DictionaryState>().swap(states_);
+    Gotos().swap(gotos_);
+    vector<unsigned>().swap(dense_);
+    unmap();
+    file->addRef();
+    mapped_ = file;
+    stateArr_ = states;
+    gotoArr_ = gotos;
+    denseArr_ = dense;
+    numStates_ = numStates;
+    numGotos_ = numGotos;
+    numDense_ = numDense;
+}
+
+template <class Entry>
+void Dictionary<Entry>::setEntryBlock(Entry * block, unsigned numEntries) {
+    entries_.resize(numEntries);
+    for(unsigned i = 0; i < numEntries; i++)
+        entries_[i] = block+i;
+    entryBlock_ = block;
+}
+
+inline size_t alignArena(size_t pos) {
+    return (pos + 7) & ~((size_t)7);
+}
+
+template <class Entry>
+char * Dictionary<Entry>::packArrays(size_t extra, MappedArena * arena, bool hugePages) {
+    size_t gotoPos = alignArena(numStates_*sizeof(DictionaryState));
+    size_t densePos = alignArena(gotoPos + numGotos_*sizeof(gotoArr_[0]));
+    size_t extraPos = alignArena(densePos + numDense_*sizeof(unsigned));
+    MappedFile * block;
+    char * data;
+    if(arena) {
+        data = arena->take(extraPos + extra, block);
+    } else {
+        block = MappedFile::allocate(extraPos + extra, hugePages);
+        data = const_cast<char*>(block->getData());
+    }
+    if(numStates_) memcpy(data, stateArr_, numStates_*sizeof(DictionaryState));
+    if(numGotos_) memcpy(data+gotoPos, gotoArr_, numGotos_*sizeof(gotoArr_[0]));
+    if(numDense_) memcpy(data+densePos, denseArr_, numDense_*sizeof(unsigned));
+    setMappedArrays(block, (const DictionaryState*)data, numStates_, (const pair<KinkakuChar,unsigned>*)(data+gotoPos), numGotos_, (const unsigned*)(data+densePos), numDense_);
+    block->release();
+    packedSize_ = extraPos + extra;
+    return data+extraPos;
+}
+
+template <class Entry>
+void Dictionary<Entry>::getPackedArrays(vector<DictionaryState> & states, Gotos & gotos) const {
+    // states have no padding, so they are copied as they are
+    states.assign(stateArr_, stateArr_+numStates_);
+    // the two bytes after each goto's character are padding, which is
+    // cleared as raw memory first so that files do not depend on it, and
+    // assigning the members leaves it alone
+    gotos.resize(numGotos_);
+    if(numGotos_) memset(static_cast<void*>(&gotos[0]), 0, numGotos_*sizeof(gotos[0]));
+    for(unsigned i = 0; i < numGotos_; i++) {
+        gotos[i].first = gotoArr_[i].first;
+        gotos[i].second = gotoArr_[i].second;
+    }
+}
+
+template <class Entry>
+void Dictionary<Entry>::getWordList(WordList & list) const {
+    list.clear();
+    if(numStates_ == 0) return;
+    vector<KinkakuChar> chars;
+    // the states from the root down, each with the next goto to follow
+    vector< pair<unsigned,unsigned> > path(1, pair<unsigned,unsigned>(0, stateArr_[0].gotoBegin));
+    while(path.size() > 0) {
+        pair<unsigned,unsigned> & top = path.back();
+        if(top.second == stateArr_[top.first].gotoEnd) {
+            path.pop_back();
+            if(chars.size() > 0) chars.pop_back();
+            continue;
+        }
+        const pair<KinkakuChar,unsigned> & go = gotoArr_[top.second++];
+        const DictionaryState & st = stateArr_[go.second];
+        chars.push_back(go.first);
+        if(st.isBranch) {
+            KinkakuString word(chars.size());
+            for(unsigned i = 0; i < chars.size(); i++)
+                word[i] = chars[i];
+            list.push_back(pair<KinkakuString,Entry*>(word, entries_[st.output]));
         }
+        path.push_back(pair<unsigned,unsigned>(go.second, st.gotoBegin));
+    }
+}
+
+// The number of levels and values in each field of the entries, which
+// are the sizes of the arrays that the entries are pooled in
+class PoolCounts {
+public:
+    PoolCounts() : tagLevels(0), tags(0), inDictLevels(0), inDicts(0), probLevels(0), probs(0) { }
+    size_t tagLevels, tags, inDictLevels, inDicts, probLevels, probs;
+};
+
+template <class T>
+inline void countLevels(const EntryVec< EntryVec<T> > & field, size_t & levels, size_t & values) {
+    levels += field.size();
+    for(unsigned i = 0; i < field.size(); i++)
+        values += field[i].size();
+}
+inline void countEntry(const TagEntry * ent, PoolCounts & counts) {
+    countLevels(ent->tags, counts.tagLevels, counts.tags);
+    countLevels(ent->tagInDicts, counts.inDictLevels, counts.inDicts);
+}
+inline void countEntry(const ProbTagEntry * ent, PoolCounts & counts) {
+    countEntry(static_cast<const TagEntry*>(ent), counts);
+    countLevels(ent->probs, counts.probLevels, counts.probs);
+}
+inline void countEntry(const FeatVec *, PoolCounts &) { }
+
+// Copy the values of a field into the next levels and values of a pool,
+// leaving the field a view of them
+template <class T>
+inline void poolLevels(EntryVec< EntryVec<T> > & field, EntryVec<T> * & levels, T * & values) {
+    unsigned numLevels = field.size();
+    for(unsigned i = 0; i < numLevels; i++) {
+        const EntryVec<T> & level = field[i];
+        if(level.size() == 0)
+            continue;
+        std::copy(level.begin(), level.end(), values);
+        EntryVec<T>(values, level.size()).swap(levels[i]);
+        values += level.size();
     }
+    EntryVec< EntryVec<T> >(numLevels ? levels : 0, numLevels).swap(field);
+    levels += numLevels;
+}
+
+// The next free place for each kind of value in a pool
+class PoolCursor {
+public:
+    EntryVec<KinkakuString> * tagLevels;
+    EntryVec<unsigned char> * inDictLevels;
+    EntryVec<double> * probLevels;
+    KinkakuString * tags;
+    unsigned char * inDicts;
+    double * probs;
+};
+
+inline void poolEntry(TagEntry * ent, PoolCursor & cursor) {
+    poolLevels(ent->tags, cursor.tagLevels, cursor.tags);
+    poolLevels(ent->tagInDicts, cursor.inDictLevels, cursor.inDicts);
+}
+inline void poolEntry(ModelTagEntry * ent, PoolCursor & cursor) {
+    poolEntry(static_cast<TagEntry*>(ent), cursor);
+    if(ent->tagMods.capacity() != ent->tagMods.size())
+        vector<KinkakuModel*>(ent->tagMods).swap(ent->tagMods);
+}
+inline void poolEntry(ProbTagEntry * ent, PoolCursor & cursor) {
+    poolEntry(static_cast<TagEntry*>(ent), cursor);
+    poolLevels(ent->probs, cursor.probLevels, cursor.probs);
+}
+inline void poolEntry(FeatVec * ent, PoolCursor &) {
+    ent->shrink();
+}
+
+// Make an entry at mem with the contents of ent, leaving ent empty
+inline void swapTags(TagEntry * a, TagEntry * b) {
+    a->word.swap(b->word);
+    a->tags.swap(b->tags);
+    a->tagInDicts.swap(b->tagInDicts);
+    std::swap(a->inDict, b->inDict);
+}
+inline ModelTagEntry * moveEntry(void * mem, ModelTagEntry * ent) {
+    ModelTagEntry * ret = new(mem) ModelTagEntry(KinkakuString());
+    swapTags(ret, ent);
+    ret->tagMods.swap(ent->tagMods);
+    std::swap(ret->modelSlot, ent->modelSlot);
+    return ret;
+}
+inline ProbTagEntry * moveEntry(void * mem, ProbTagEntry * ent) {
+    ProbTagEntry * ret = new(mem) ProbTagEntry(KinkakuString());
+    swapTags(ret, ent);
+    ret->probs.swap(ent->probs);
+    return ret;
+}
+inline FeatVec * moveEntry(void * mem, FeatVec * ent) {
+    FeatVec * ret = new(mem) FeatVec;
+    ret->swap(*ent);
+    return ret;
+}
 
+// Construct n objects at pos in a pool, returning the first
+template <class T>
+inline T * makePoolArray(char * data, size_t pos, size_t n) {
+    if(n == 0)
+        return 0;
+    T * ret = reinterpret_cast<T*>(data+pos);
+    for(size_t i = 0; i < n; i++)
+        new(ret+i) T();
+    return ret;
+}
+template <class T>
+inline void destroyPoolArray(T * arr, unsigned n) {
+    for(unsigned i = 0; i < n; i++)
+        arr[i].~T();
 }
 
 template <class Entry>
-void Dictionary<Entry>::clearData() {
-    for(unsigned i = 0; i < states_.size(); i++)
-        delete states_[i];
+void Dictionary<Entry>::clearPool(EntryPool & pool) {
+    destroyPoolArray(pool.entries, pool.numEntries);
+    destroyPoolArray(pool.tagLevels, pool.numTagLevels);
+    destroyPoolArray(pool.inDictLevels, pool.numInDictLevels);
+    destroyPoolArray(pool.probLevels, pool.numProbLevels);
+    destroyPoolArray(pool.tags, pool.numTags);
+    if(pool.block)
+        pool.block->release();
+    pool = EntryPool();
+}
+
+typedef KinkakuStringMap<char> StringPool;
+
+template <class Entry>
+void Dictionary<Entry>::compactEntries(MappedArena * arena, bool hugePages) {
+    PoolCounts counts;
     for(unsigned i = 0; i < entries_.size(); i++)
-        delete entries_[i];
+        countEntry(entries_[i], counts);
+    // the pool holds the entries (if they are moved), then the vectors of
+    // each level, then the values, each array starting on 8 bytes
+    size_t numEntries = (arena != 0 && entryBlock_ == 0 ? entries_.size() : 0);
+    size_t tagLevelPos = alignArena(numEntries*sizeof(Entry));
+    size_t inDictLevelPos = alignArena(tagLevelPos + counts.tagLevels*sizeof(EntryVec<KinkakuString>));
+    size_t probLevelPos = alignArena(inDictLevelPos + counts.inDictLevels*sizeof(EntryVec<unsigned char>));
+    size_t tagPos = alignArena(probLevelPos + counts.probLevels*sizeof(EntryVec<double>));
+    size_t probPos = alignArena(tagPos + counts.tags*sizeof(KinkakuString));
+    size_t inDictPos = probPos + counts.probs*sizeof(double);
+    size_t size = alignArena(inDictPos + counts.inDicts);
+    EntryPool old = pool_;
+    pool_ = EntryPool();
+    char * data = 0;
+    if(size && arena) {
+        data = arena->take(size, pool_.block);
+    } else if(size) {
+        pool_.block = MappedFile::allocate(size, hugePages);
+        data = const_cast<char*>(pool_.block->getData());
+    }
+    pool_.size = size;
+    pool_.tagLevels = makePoolArray< EntryVec<KinkakuString> >(data, tagLevelPos, counts.tagLevels);
+    pool_.numTagLevels = counts.tagLevels;
+    pool_.inDictLevels = makePoolArray< EntryVec<unsigned char> >(data, inDictLevelPos, counts.inDictLevels);
+    pool_.numInDictLevels = counts.inDictLevels;
+    pool_.probLevels = makePoolArray< EntryVec<double> >(data, probLevelPos, counts.probLevels);
+    pool_.numProbLevels = counts.probLevels;
+    pool_.tags = makePoolArray<KinkakuString>(data, tagPos, counts.tags);
+    pool_.numTags = counts.tags;
+    PoolCursor cursor;
+    cursor.tagLevels = pool_.tagLevels;
+    cursor.inDictLevels = pool_.inDictLevels;
+    cursor.probLevels = pool_.probLevels;
+    cursor.tags = pool_.tags;
+    cursor.probs = makePoolArray<double>(data, probPos, counts.probs);
+    cursor.inDicts = makePoolArray<unsigned char>(data, inDictPos, counts.inDicts);
+    if(numEntries)
+        pool_.entries = reinterpret_cast<Entry*>(data);
+    for(unsigned i = 0; i < entries_.size(); i++) {
+        poolEntry(entries_[i], cursor);
+        if(!numEntries)
+            continue;
+        Entry * moved = moveEntry(data+i*sizeof(Entry), entries_[i]);
+        // entries in the old pool are destroyed with it
+        if(!old.hasEntry(entries_[i]))
+            delete entries_[i];
+        entries_[i] = moved;
+        pool_.numEntries = i+1;
+    }
+    clearPool(old);
+    // the pool of strings only needs to live while interning, as the
+    // strings themselves are reference counted
+    StringPool strings;
+    for(unsigned i = 0; i < pool_.numTags; i++)
+        pool_.tags[i] = strings.insert(make_pair(pool_.tags[i], 0)).first->first;
+}
+
+// Heap bytes used by the entries, counting each shared string only once
+inline size_t stringMemoryUsage(const KinkakuString & str, set<const KinkakuStringImpl*> & seen) {
+    if(str.getImpl() == 0 || !seen.insert(str.getImpl()).second)
+        return 0;
+    return str.getHeapSize();
+}
+template <class T>
+inline size_t vectorMemoryUsage(const vector<T> & vec) {
+    return vec.capacity()*sizeof(T);
+}
+template <class T>
+inline size_t vectorMemoryUsage(const EntryVec<T> & vec) {
+    return vec.capacity()*sizeof(T);
+}
+inline size_t tagMemoryUsage(const TagEntry * ent, set<const KinkakuStringImpl*> & seen) {
+    size_t ret = stringMemoryUsage(ent->word, seen) + vectorMemoryUsage(ent->tags) + vectorMemoryUsage(ent->tagInDicts);
+    for(unsigned i = 0; i < ent->tags.size(); i++) {
+        ret += vectorMemoryUsage(ent->tags[i]);
+        for(unsigned j = 0; j < ent->tags[i].size(); j++)
+            ret += stringMemoryUsage(ent->tags[i][j], seen);
+    }
+    for(unsigned i = 0; i < ent->tagInDicts.size(); i++)
+        ret += vectorMemoryUsage(ent->tagInDicts[i]);
+    return ret;
+}
+inline size_t entryMemoryUsage(const ModelTagEntry * ent, set<const KinkakuStringImpl*> & seen) {
+    return sizeof(ModelTagEntry) + tagMemoryUsage(ent, seen) + vectorMemoryUsage(ent->tagMods);
+}
+inline size_t entryMemoryUsage(const ProbTagEntry * ent, set<const KinkakuStringImpl*> & seen) {
+    size_t ret = sizeof(ProbTagEntry) + tagMemoryUsage(ent, seen) + vectorMemoryUsage(ent->probs);
+    for(unsigned i = 0; i < ent->probs.size(); i++)
+        ret += vectorMemoryUsage(ent->probs[i]);
+    return ret;
+}
+inline size_t entryMemoryUsage(const FeatVec * ent, set<const KinkakuStringImpl*> &) {
+    return sizeof(FeatVec) + ent->capacity()*sizeof(FeatVal);
+}
+
+template <class Entry>
+size_t Dictionary<Entry>::getEntryMemoryUsage(const vector<Entry*> & entries) {
+    set<const KinkakuStringImpl*> seen;
+    size_t ret = vectorMemoryUsage(entries);
+    for(unsigned i = 0; i < entries.size(); i++)
+        ret += entryMemoryUsage(entries[i], seen);
+    return ret;
+}
+
+template <class Entry>
+size_t Dictionary<Entry>::getEntryMemoryUsage() const {
+    // views own nothing, and the entries in the pool are counted with it
+    return getEntryMemoryUsage(entries_) - pool_.numEntries*sizeof(Entry) + pool_.size;
+}
+
+template <class Entry>
+size_t Dictionary<Entry>::getMemoryUsage() const {
+    size_t ret = getEntryMemoryUsage();
+    if(mapped_ && mapped_->isArena())
+        return ret + packedSize_;
+    if(mapped_)
+        return ret + numStates_*sizeof(DictionaryState) + numGotos_*sizeof(gotoArr_[0]) + numDense_*sizeof(unsigned);
+    return ret + vectorMemoryUsage(states_) + vectorMemoryUsage(gotos_) + vectorMemoryUsage(dense_);
+}
+
+template <class Entry>
+void Dictionary<Entry>::clearData() {
+    if(entryBlock_)
+        delete [] entryBlock_;
+    else
+        for(unsigned i = 0; i < entries_.size(); i++)
+            if(!pool_.hasEntry(entries_[i]))
+                delete entries_[i];
+    entryBlock_ = 0;
     entries_.clear();
+    clearPool(pool_);
     states_.clear();
+    gotos_.clear();
+    dense_.clear();
+    unmap();
+    updateArrays();
 }
 
 template <class Entry>
 void Dictionary<Entry>::buildIndex(const WordMap & input) {
+    WordList list(input.begin(), input.end());
+    buildIndex(list);
+}
+
+template <class Entry>
+void Dictionary<Entry>::buildIndex(WordList & input) {
     if(input.size() == 0)
         THROW_ERROR("Cannot build dictionary for no input");
+    bool sorted = true;
+    for(unsigned i = 1; sorted && i < input.size(); i++)
+        sorted = (input[i-1].first < input[i].first);
+    if(!sorted) {
+        sort(input.begin(), input.end());
+        for(unsigned i = 1; i < input.size(); i++)
+            if(input[i-1].first == input[i].first)
+                THROW_ERROR("Duplicate word in dictionary input: "<<util_->showString(input[i].first));
+    }
     clearData();
-    states_.push_back(new DictionaryState());
-    buildGoto(input.begin(), input.end(), 0, 0);
-    buildFailures();
+    vector<unsigned> levels;
+    gotos_.reserve(input.size());
+    buildGotos(input, levels);
+    buildDenseGotos();
+    buildFailures(levels);
+    entries_.resize(input.size());
+    for(unsigned i = 0; i < input.size(); i++)
+        entries_[i] = input[i].second;
+    compactEntries();
 }
 
 inline string showWord(StringUtil * util, const ModelTagEntry * entry) {
@@ -173,49 +620,341 @@ inline string showWord(StringUtil * util, const FeatVec * entry) {
 
 template <class Entry>
 void Dictionary<Entry>::print() {
-    for(unsigned i = 0; i < states_.size(); i++) {
-        std::cout << "s="<<i<<", f="<<states_[i]->failure<<", o='";
-        for(unsigned j = 0; j < states_[i]->output.size(); j++) {
-            if(j!=0) std::cout << " ";
-            // std::cout << util_->showString(entries_[states_[i]->output[j]]->word);
-            std::cout << showWord(util_, entries_[states_[i]->output[j]]);
-        }
+    for(unsigned i = 0; i < numStates_; i++) {
+        const DictionaryState & state = stateArr_[i];
+        std::cout << "s="<<i<<", f="<<state.failure<<", o='";
+        if(state.isBranch)
+            std::cout << showWord(util_, entries_[state.output]);
+        std::cout << "' l="<<state.outputLink;
         std::cout << "' g='";
-        for(unsigned j = 0; j < states_[i]->gotos.size(); j++) {
-            if(j!=0) std::cout << " ";
-            std::cout << util_->showChar(states_[i]->gotos[j].first) << "->" << states_[i]->gotos[j].second;
+        for(unsigned j = state.gotoBegin; j < state.gotoEnd; j++) {
+            if(j!=state.gotoBegin) std::cout << " ";
+            std::cout << util_->showChar(gotoArr_[j].first) << "->" << gotoArr_[j].second;
         }
         std::cout << "'" << std::endl;
     }
 }
 
+// Compiled dictionaries start with this magic and a header of 32-bit
+// counts, followed by the state, goto and dense arrays exactly as
+// they are laid out in memory, the characters used by the dictionary (so
+// character ids can be checked against the loading StringUtil), and
+// the entries encoded as a stream of KinkakuChars. Every section starts
+// on an 8-byte boundary, so the file can be used from any address.
+#define DICTIONARY_COMPILED_MAGIC "KNKDIC2\n"
+#define DICTIONARY_COMPILED_BOM 0x01020304
+
+enum {
+    COMPILED_BOM = 0, COMPILED_STATE_SIZE, COMPILED_GOTO_SIZE, COMPILED_NUM_DICTS,
+    COMPILED_STATES, COMPILED_GOTOS, COMPILED_DENSE,
+    COMPILED_ENTRIES, COMPILED_ENTRY_DATA, COMPILED_CHARS, COMPILED_CHAR_NAMES,
+    COMPILED_HEADER_SIZE
+};
+
+inline size_t compiledAlign(size_t pos) {
+    return (pos + 7) & ~((size_t)7);
+}
+
+inline void compiledPad(ostream & out, size_t & pos) {
+    static const char zeros[8] = { 0 };
+    size_t next = compiledAlign(pos);
+    out.write(zeros, next-pos);
+    pos = next;
+}
+
+inline void compiledWrite(ostream & out, size_t & pos, const void * data, size_t size) {
+    out.write((const char*)data, size);
+    pos += size;
+    compiledPad(out, pos);
+}
+
+inline void compiledPush(vector<KinkakuChar> & data, unsigned val) {
+    if(val > 0xFFFF)
+        THROW_ERROR("Value "<<val<<" is too large for a compiled dictionary");
+    data.push_back(val);
+}
+
+inline void compiledPush(vector<KinkakuChar> & data, const KinkakuString & str) {
+    compiledPush(data, str.length());
+    for(unsigned i = 0; i < str.length(); i++)
+        data.push_back(str[i]);
+}
+
+inline void encodeEntry(const TagEntry * ent, vector<KinkakuChar> & data) {
+    compiledPush(data, ent->inDict);
+    compiledPush(data, ent->word);
+    compiledPush(data, ent->tags.size());
+    for(unsigned i = 0; i < ent->tags.size(); i++) {
+        compiledPush(data, ent->tags[i].size());
+        for(unsigned j = 0; j < ent->tags[i].size(); j++) {
+            compiledPush(data, ent->tagInDicts[i][j]);
+            compiledPush(data, ent->tags[i][j]);
+        }
+    }
+}
+inline void encodeEntry(const FeatVec *, vector<KinkakuChar> &) {
+    THROW_ERROR("Feature dictionaries cannot be compiled");
+}
+
+inline void markChars(const KinkakuString & str, vector<bool> & used) {
+    for(unsigned i = 0; i < str.length(); i++)
+        used[str[i]] = true;
+}
+inline void markChars(const TagEntry * ent, vector<bool> & used) {
+    markChars(ent->word, used);
+    for(unsigned i = 0; i < ent->tags.size(); i++)
+        for(unsigned j = 0; j < ent->tags[i].size(); j++)
+            markChars(ent->tags[i][j], used);
+}
+inline void markChars(const FeatVec *, vector<bool> &) { }
+
+class CompiledReader {
+public:
+    CompiledReader(const KinkakuChar * pos, const KinkakuChar * end, const vector<KinkakuChar> & charMap) : pos_(pos), end_(end), charMap_(charMap) { }
+    unsigned next() {
+        if(pos_ == end_)
+            THROW_ERROR("Compiled dictionary entries are truncated");
+        return *pos_++;
+    }
+    KinkakuString nextString() {
+        unsigned len = next();
+        if((unsigned)(end_-pos_) < len)
+            THROW_ERROR("Compiled dictionary entries are truncated");
+        KinkakuString ret(len);
+        for(unsigned i = 0; i < len; i++) {
+            KinkakuChar c = *pos_++;
+            if(c >= charMap_.size() || (c != 0 && charMap_[c] == 0))
+                THROW_ERROR("Compiled dictionary uses an undeclared character");
+            ret[i] = charMap_[c];
+        }
+        return ret;
+    }
+private:
+    const KinkakuChar * pos_, * end_;
+    const vector<KinkakuChar> & charMap_;
+};
+
+template <class Entry>
+Entry * decodeEntry(CompiledReader & reader, KinkakuString & word) {
+    unsigned char inDict = reader.next();
+    word = reader.nextString();
+    Entry * ent = new Entry(word);
+    ent->inDict = inDict;
+    ent->setNumTags(reader.next());
+    for(unsigned i = 0; i < ent->tags.size(); i++) {
+        unsigned numTags = reader.next();
+        for(unsigned j = 0; j < numTags; j++) {
+            ent->tagInDicts[i].push_back(reader.next());
+            ent->tags[i].push_back(reader.nextString());
+        }
+    }
+    return ent;
+}
+template <>
+FeatVec * decodeEntry<FeatVec>(CompiledReader &, KinkakuString &) {
+    THROW_ERROR("Feature dictionaries cannot be compiled");
+}
+
+template <class Entry>
+void Dictionary<Entry>::writeCompiled(const string & file) const {
+    if(mapped_)
+        THROW_ERROR("A mapped dictionary cannot be compiled again");
+    // the entries and the list of characters that they use
+    vector<KinkakuChar> data;
+    vector<bool> used(1 << (8*sizeof(KinkakuChar)), false);
+    for(unsigned i = 0; i < entries_.size(); i++) {
+        encodeEntry(entries_[i], data);
+        markChars(entries_[i], used);
+    }
+    vector<KinkakuChar> chars;
+    vector<unsigned char> nameLens;
+    string names;
+    for(unsigned i = 1; i < used.size(); i++) {
+        if(!used[i]) continue;
+        string name = util_->showChar(i);
+        if(name.length() == 0 || name.length() > 255)
+            THROW_ERROR("Character "<<i<<" cannot be written to a compiled dictionary");
+        chars.push_back(i);
+        nameLens.push_back(name.length());
+        names += name;
+    }
+    unsigned header[COMPILED_HEADER_SIZE];
+    header[COMPILED_BOM] = DICTIONARY_COMPILED_BOM;
+    header[COMPILED_STATE_SIZE] = sizeof(DictionaryState);
+    header[COMPILED_GOTO_SIZE] = sizeof(std::pair<KinkakuChar,unsigned>);
+    header[COMPILED_NUM_DICTS] = numDicts_;
+    header[COMPILED_STATES] = numStates_;
+    header[COMPILED_GOTOS] = numGotos_;
+    header[COMPILED_DENSE] = numDense_;
+    header[COMPILED_ENTRIES] = entries_.size();
+    header[COMPILED_ENTRY_DATA] = data.size();
+    header[COMPILED_CHARS] = chars.size();
+    header[COMPILED_CHAR_NAMES] = names.length();
+    ofstream out(file.c_str(), ios::out | ios::binary);
+    if(!out)
+        THROW_ERROR("Could not open compiled dictionary file for writing: "<<file);
+    size_t pos = 0;
+    compiledWrite(out, pos, DICTIONARY_COMPILED_MAGIC, 8);
+    compiledWrite(out, pos, header, sizeof(header));
+    vector<DictionaryState> states;
+    Gotos gotos;
+    getPackedArrays(states, gotos);
+    compiledWrite(out, pos, (states.size() ? &states[0] : 0), states.size()*sizeof(DictionaryState));
+    compiledWrite(out, pos, (gotos.size() ? &gotos[0] : 0), gotos.size()*sizeof(gotos[0]));
+    compiledWrite(out, pos, denseArr_, header[COMPILED_DENSE]*sizeof(unsigned));
+    compiledWrite(out, pos, (data.size() ? &data[0] : 0), data.size()*sizeof(KinkakuChar));
+    compiledWrite(out, pos, (chars.size() ? &chars[0] : 0), chars.size()*sizeof(KinkakuChar));
+    compiledWrite(out, pos, (nameLens.size() ? &nameLens[0] : 0), nameLens.size());
+    compiledWrite(out, pos, names.data(), names.length());
+    if(!out)
+        THROW_ERROR("Failed to write compiled dictionary file: "<<file);
+}
+
+template <class Entry>
+bool Dictionary<Entry>::isCompiled(const string & file) {
+    char magic[8];
+    ifstream in(file.c_str(), ios::in | ios::binary);
+    return in.read(magic, 8) && !memcmp(magic, DICTIONARY_COMPILED_MAGIC, 8);
+}
+
+// Whether every index in the arrays is inside them, so that step() and
+// match() can use arrays read from a file without checking each access
+template <class Entry>
+bool Dictionary<Entry>::checkArrays(unsigned numEntries) const {
+    for(unsigned i = 0; i < numGotos_; i++)
+        if(gotoArr_[i].second >= numStates_)
+            return false;
+    for(unsigned i = 0; i < numStates_; i++) {
+        const DictionaryState & st = stateArr_[i];
+        if(st.gotoBegin > st.gotoEnd || st.gotoEnd > numGotos_ || st.failure >= numStates_ || st.outputLink >= numStates_)
+            return false;
+        // output links are followed to the entries of their states
+        if((st.isBranch && st.output >= numEntries) || (st.outputLink != 0 && !stateArr_[st.outputLink].isBranch))
+            return false;
+        if(st.dense) {
+            // the table's size is at dense-1, and the table follows it
+            if(st.dense > numDense_ || denseArr_[st.dense-1] > numDense_-st.dense)
+                return false;
+            for(unsigned j = 0; j < denseArr_[st.dense-1]; j++)
+                if(denseArr_[st.dense+j] >= numStates_)
+                    return false;
+        }
+    }
+    return true;
+}
+
+template <class Entry>
+void Dictionary<Entry>::readCompiled(const string & file) {
+    clearData();
+    mapped_ = MappedFile::open(file);
+    size_t mappedSize = mapped_->getSize();
+    const char * base = mapped_->getData();
+    const unsigned * header = (const unsigned *)(base+8);
+    size_t pos = compiledAlign(8+COMPILED_HEADER_SIZE*sizeof(unsigned));
+    if(mappedSize < pos || memcmp(base, DICTIONARY_COMPILED_MAGIC, 8)) {
+        clearData();
+        THROW_ERROR("Not a compiled dictionary file: "<<file);
+    }
+    if(header[COMPILED_BOM] != DICTIONARY_COMPILED_BOM || header[COMPILED_STATE_SIZE] != sizeof(DictionaryState) || header[COMPILED_GOTO_SIZE] != sizeof(std::pair<KinkakuChar,unsigned>)) {
+        clearData();
+        THROW_ERROR("Compiled dictionary was made on an incompatible platform: "<<file);
+    }
+    // find the sections, checking that they are all inside the file
+    size_t sizes[7] = { header[COMPILED_STATES]*sizeof(DictionaryState), 
+                        header[COMPILED_GOTOS]*sizeof(std::pair<KinkakuChar,unsigned>), 
+                        header[COMPILED_DENSE]*sizeof(unsigned), 
+                        header[COMPILED_ENTRY_DATA]*sizeof(KinkakuChar), 
+                        header[COMPILED_CHARS]*sizeof(KinkakuChar),
+                        header[COMPILED_CHARS],
+                        header[COMPILED_CHAR_NAMES] };
+    const char * sections[7];
+    for(int i = 0; i < 7; i++) {
+        sections[i] = base+pos;
+        pos = compiledAlign(pos+sizes[i]);
+        if(pos > mappedSize) {
+            clearData();
+            THROW_ERROR("Compiled dictionary file is truncated: "<<file);
+        }
+    }
+    // map the characters of the file into those of this StringUtil
+    const KinkakuChar * chars = (const KinkakuChar *)sections[4];
+    const unsigned char * nameLens = (const unsigned char *)sections[5];
+    const char * names = sections[6];
+    vector<KinkakuChar> charMap(1, 0);
+    bool sameIds = true;
+    for(unsigned i = 0, namePos = 0; i < header[COMPILED_CHARS]; i++) {
+        if(namePos+nameLens[i] > header[COMPILED_CHAR_NAMES]) {
+            clearData();
+            THROW_ERROR("Compiled dictionary file is corrupted: "<<file);
+        }
+        if(charMap.size() <= chars[i])
+            charMap.resize(chars[i]+1, 0);
+        charMap[chars[i]] = util_->mapChar(string(names+namePos, nameLens[i]));
+        sameIds = sameIds && (charMap[chars[i]] == chars[i]);
+        namePos += nameLens[i];
+    }
+    WordList list(header[COMPILED_ENTRIES]);
+    CompiledReader reader((const KinkakuChar *)sections[3], (const KinkakuChar *)sections[3]+header[COMPILED_ENTRY_DATA], charMap);
+    try {
+        for(unsigned i = 0; i < list.size(); i++) {
+            list[i].second = decodeEntry<Entry>(reader, list[i].first);
+        }
+    } catch(...) {
+        for(unsigned i = 0; i < list.size(); i++)
+            delete list[i].second;
+        clearData();
+        throw;
+    }
+    unsigned char numDicts = header[COMPILED_NUM_DICTS];
+    if(sameIds && header[COMPILED_STATES] > 0) {
+        stateArr_ = (const DictionaryState *)sections[0];
+        gotoArr_ = (const std::pair<KinkakuChar,unsigned> *)sections[1];
+        denseArr_ = (const unsigned *)sections[2];
+        numStates_ = header[COMPILED_STATES];
+        numGotos_ = header[COMPILED_GOTOS];
+        numDense_ = header[COMPILED_DENSE];
+        if(!checkArrays(list.size())) {
+            for(unsigned i = 0; i < list.size(); i++)
+                delete list[i].second;
+            clearData();
+            THROW_ERROR("Compiled dictionary file is corrupted: "<<file);
+        }
+        entries_.resize(list.size());
+        for(unsigned i = 0; i < list.size(); i++)
+            entries_[i] = list[i].second;
+        compactEntries();
+    } else {
+        // the characters were numbered differently when compiling, so the
+        // automaton has to be rebuilt
+        unmap();
+        buildIndex(list);
+    }
+    numDicts_ = numDicts;
+}
+
 template <class Entry>
-Entry * Dictionary<Entry>::findEntry(KinkakuString str) {
+Entry * Dictionary<Entry>::findEntry(const KinkakuStringView & str) {
     if(str.length() == 0) return 0;
     unsigned state = 0, lev = 0;
     do {
 #ifdef KINKAKU_SAFE
-        if(state >= states_.size())
-            THROW_ERROR("Accessing state "<<state<<" that is larger than states_ ("<<states_.size()<<")");
-        if(states_[state] == 0)
-            THROW_ERROR("Accessing null state "<<state);
+        if(state >= numStates_)
+            THROW_ERROR("Accessing state "<<state<<" that is larger than states_ ("<<numStates_<<")");
 #endif
-        state = states_[state]->step(str[lev++]);
+        state = step(state, str[lev++]);
     } while (state != 0 && lev < str.length());
-    if(states_[state]->output.size() == 0) return 0;
-    if(!states_[state]->isBranch) return 0;
-    return entries_[states_[state]->output[0]];
+    if(!stateArr_[state].isBranch) return 0;
+    return entries_[stateArr_[state].output];
 }
 template <class Entry>
-const Entry * Dictionary<Entry>::findEntry(KinkakuString str) const {
+const Entry * Dictionary<Entry>::findEntry(const KinkakuStringView & str) const {
     if(str.length() == 0) return 0;
     unsigned state = 0, lev = 0;
     do {
-        state = states_[state]->step(str[lev++]);
+        state = step(state, str[lev++]);
     } while (state != 0 && lev < str.length());
-    if(states_[state]->output.size() == 0) return 0;
-    if(!states_[state]->isBranch) return 0;
-    return entries_[states_[state]->output[0]];
+    if(!stateArr_[state].isBranch) return 0;
+    return entries_[stateArr_[state].output];
 }
 
 template <>
@@ -233,20 +972,28 @@ unsigned Dictionary<Entry>::getTagID(KinkakuString str, KinkakuString tag, int l
 }
 
 template <class Entry>
-typename Dictionary<Entry>::MatchResult Dictionary<Entry>::match( const KinkakuString & chars ) const {
+typename Dictionary<Entry>::MatchResult Dictionary<Entry>::match( const KinkakuStringView & chars ) const {
+    MatchResult ret;
+    match(chars, ret);
+    return ret;
+}
+
+template <class Entry>
+void Dictionary<Entry>::match( const KinkakuStringView & chars, MatchResult & ret ) const {
     const unsigned len = chars.length();
     unsigned currState = 0, nextState;
-    MatchResult ret;
+    ret.clear();
     for(unsigned i = 0; i < len; i++) {
         KinkakuChar c = chars[i];
-        while((nextState = states_[currState]->step(c)) == 0 && currState != 0)
-            currState = states_[currState]->failure;
+        while((nextState = step(currState, c)) == 0 && currState != 0)
+            currState = stateArr_[currState].failure;
         currState = nextState;
-        std::vector<unsigned> & output = states_[currState]->output;
-        for(unsigned j = 0; j < output.size(); j++) 
-            ret.push_back( std::pair<unsigned, Entry*>(i, entries_[output[j]]) );
+        const DictionaryState & state = stateArr_[currState];
+        if(state.isBranch)
+            ret.push_back( std::pair<unsigned, Entry*>(i, entries_[state.output]) );
+        for(unsigned out = state.outputLink; out != 0; out = stateArr_[out].outputLink)
+            ret.push_back( std::pair<unsigned, Entry*>(i, entries_[stateArr_[out].output]) );
     }
-    return ret;
 }
 
 template class Dictionary<ModelTagEntry>;
@@ -27,7 +27,10 @@
 #include <kinkaku/feature-lookup.h>
 #include <kinkaku/kinkaku-util.h>
 #include <kinkaku/dictionary.h>
+#include <kinkaku/mapped-file.h>
 #include <algorithm>
+#include <functional>
+#include <cstring>
 
 using namespace kinkaku;
 using namespace std;
@@ -40,11 +43,103 @@ FeatureLookup::~FeatureLookup() {
     if(biases_) delete biases_;
     if(tagDictVector_) delete tagDictVector_;
     if(tagUnkVector_) delete tagUnkVector_;
+    if(mapped_) mapped_->release();
+}
+
+void FeatureLookup::setMappedFile(MappedFile * mapped) {
+    if(mapped) mapped->addRef();
+    if(mapped_) mapped_->release();
+    mapped_ = mapped;
+}
+
+static size_t vectorMemoryUsage(const FeatVec * vec) {
+    return (vec ? sizeof(FeatVec) + vec->capacity()*sizeof(FeatVal) : 0);
+}
+
+static size_t dictionaryMemoryUsage(const Dictionary<FeatVec> * dict) {
+    return (dict ? sizeof(Dictionary<FeatVec>) + dict->getMemoryUsage() : 0);
+}
+
+size_t FeatureLookup::getMemoryUsage() const {
+    return sizeof(FeatureLookup)
+        + dictionaryMemoryUsage(charDict_) + dictionaryMemoryUsage(typeDict_) + dictionaryMemoryUsage(selfDict_)
+        + vectorMemoryUsage(dictVector_) + vectorMemoryUsage(biases_)
+        + vectorMemoryUsage(tagDictVector_) + vectorMemoryUsage(tagUnkVector_);
+}
+
+static inline FeatSum magnitude(FeatVal val) {
+    return (val < 0 ? -(FeatSum)val : (FeatSum)val);
+}
+
+static void addMagnitudes(const Dictionary<FeatVec> * dict, vector<FeatSum> & mags) {
+    if(!dict) return;
+    const vector<FeatVec*> & entries = dict->getEntries();
+    for(unsigned i = 0; i < entries.size(); i++)
+        for(const FeatVal * it = entries[i]->begin(); it != entries[i]->end(); it++)
+            if(*it != 0)
+                mags.push_back(magnitude(*it));
+}
+
+static Dictionary<FeatVec> * pruneDictionary(Dictionary<FeatVec> * dict, StringUtil * util, double threshold, size_t & removed) {
+    if(!dict) return 0;
+    Dictionary<FeatVec>::WordList words, kept;
+    dict->getWordList(words);
+    for(unsigned i = 0; i < words.size(); i++) {
+        // copy the weights, as they may be a view of a mapped file
+        FeatVec * vec = new FeatVec(*words[i].second);
+        bool nonZero = false;
+        for(FeatVal * it = vec->begin(); it != vec->end(); it++) {
+            if(*it == 0)
+                continue;
+            if(magnitude(*it) < threshold) {
+                *it = 0;
+                removed++;
+            } else {
+                nonZero = true;
+            }
+        }
+        if(nonZero)
+            kept.push_back(pair<KinkakuString,FeatVec*>(words[i].first, vec));
+        else
+            delete vec;
+    }
+    Dictionary<FeatVec> * ret = 0;
+    if(kept.size() > 0) {
+        ret = new Dictionary<FeatVec>(util);
+        ret->setNumDicts(dict->getNumDicts());
+        ret->buildIndex(kept);
+    }
+    delete dict;
+    return ret;
+}
+
+size_t FeatureLookup::pruneNgrams(StringUtil * util, double threshold, unsigned topK) {
+    if(topK > 0) {
+        vector<FeatSum> mags;
+        addMagnitudes(charDict_, mags);
+        addMagnitudes(typeDict_, mags);
+        addMagnitudes(selfDict_, mags);
+        // weights tied with the last one kept are all kept
+        if(mags.size() > topK) {
+            nth_element(mags.begin(), mags.begin()+topK-1, mags.end(), greater<FeatSum>());
+            threshold = max(threshold, (double)mags[topK-1]);
+        }
+    }
+    size_t removed = 0;
+    charDict_ = pruneDictionary(charDict_, util, threshold, removed);
+    typeDict_ = pruneDictionary(typeDict_, util, threshold, removed);
+    selfDict_ = pruneDictionary(selfDict_, util, threshold, removed);
+    return removed;
 }
 
 void FeatureLookup::addNgramScores(const Dictionary<FeatVec> * dict, const KinkakuString & str, int window, vector<FeatSum> & score) {
+    Dictionary<FeatVec>::MatchResult res;
+    addNgramScores(dict, str, window, score, res);
+}
+
+void FeatureLookup::addNgramScores(const Dictionary<FeatVec> * dict, const KinkakuString & str, int window, vector<FeatSum> & score, Dictionary<FeatVec>::MatchResult & res) {
     if(!dict) return;
-    Dictionary<FeatVec>::MatchResult res = dict->match(str);
+    dict->match(str, res);
     for(int i = 0; i < (int)res.size(); i++) {
         const int base_pos = res[i].first - window;
         const int start = max(0, -base_pos);
@@ -57,16 +152,28 @@ void FeatureLookup::addNgramScores(const Dictionary<FeatVec> * dict, const Kinka
 }
 
 void FeatureLookup::addTagNgrams(const KinkakuString & chars, const Dictionary<FeatVec> * dict, vector<FeatSum> & scores, int window, int startChar, int endChar) {
+    KinkakuString str;
+    Dictionary<FeatVec>::MatchResult res;
+    addTagNgrams(chars, dict, scores, window, startChar, endChar, str, res);
+}
+
+void FeatureLookup::addTagNgrams(const KinkakuString & chars, const Dictionary<FeatVec> * dict, vector<FeatSum> & scores, int window, int startChar, int endChar, KinkakuString & str, Dictionary<FeatVec>::MatchResult & res) {
     if(!dict) return;
     int myStart = max(startChar-window,0);
     int myEnd = min(endChar+window,(int)chars.length());
-    KinkakuString str =  chars.substr(myStart, startChar-myStart) + chars.substr(endChar, myEnd-endChar);
-    Dictionary<FeatVec>::MatchResult res = dict->match(str);
+    // the context around the word, at most twice the window and so
+    // usually short enough to be stored inline
+    const int leftLen = startChar-myStart, rightLen = myEnd-endChar;
+    str.resize(leftLen+rightLen);
+    KinkakuChar * out = str.data();
+    memcpy(out, chars.data()+myStart, sizeof(KinkakuChar)*leftLen);
+    memcpy(out+leftLen, chars.data()+endChar, sizeof(KinkakuChar)*rightLen);
+    dict->match(str, res);
     int offset = window-(startChar-myStart);
     for(int i = 0; i < (int)res.size(); i++) {
         int pos = res[i].first + offset;
         pos = (window*2 - pos - 1) * scores.size();
-        FeatVal* vec = &((*res[i].second)[pos]);
+        const FeatVal* vec = &((*res[i].second)[pos]);
         for(int j = 0; j < (int)scores.size(); j++) {
 #ifdef KINKAKU_SAFE
             if(j+pos >= (int)res[i].second->size() || j+pos < 0)
@@ -77,11 +184,10 @@ void FeatureLookup::addTagNgrams(const KinkakuString & chars, const Dictionary<F
     }
 }
 
-void FeatureLookup::addSelfWeights(const KinkakuString & word, vector<FeatSum> & scores, int featIdx) {
-#ifdef KINKAKU_SAFE
-    if(selfDict_ == NULL) THROW_ERROR("Trying to add self weights when no self is present");
-#endif
-    FeatVec * entry = selfDict_->findEntry(word);
+void FeatureLookup::addSelfWeights(const KinkakuStringView & word, vector<FeatSum> & scores, int featIdx) {
+    // pruning can remove every self weight
+    if(selfDict_ == NULL) return;
+    const FeatVec * entry = selfDict_->findEntry(word);
     if(entry) {
         int base = featIdx * scores.size();
         for(int i = 0; i < (int)scores.size(); i++)
@@ -90,9 +196,14 @@ void FeatureLookup::addSelfWeights(const KinkakuString & word, vector<FeatSum> &
 }
 
 void FeatureLookup::addDictionaryScores(const Dictionary<ModelTagEntry>::MatchResult & matches, int numDicts, int max, vector<FeatSum> & score) {
+    vector<char> on;
+    addDictionaryScores(matches, numDicts, max, score, on);
+}
+
+void FeatureLookup::addDictionaryScores(const Dictionary<ModelTagEntry>::MatchResult & matches, int numDicts, int max, vector<FeatSum> & score, vector<char> & on) {
     if(dictVector_ == NULL || dictVector_->size() == 0 || matches.size() == 0) return;
     const int len = score.size(), dictLen = len*3*max;
-    vector<char> on(numDicts*dictLen, 0);
+    on.assign(numDicts*dictLen, 0);
     int end;
     ModelTagEntry* myEntry;
     for(int i = 0; i < (int)matches.size(); i++) {
@@ -118,7 +229,7 @@ void FeatureLookup::addDictionaryScores(const Dictionary<ModelTagEntry>::MatchRe
         FeatSum & val = score[i];
         for(int di = 0; di < numDicts; di++) {
             char* myOn = &on[di*dictLen + i*3*max];
-            FeatVal* myScore = &(*dictVector_)[3*max*di];
+            const FeatVal* myScore = &(*dictVector_)[3*max*di];
             for(int j = 0; j < 3*max; j++) {
                 val += myOn[j]*myScore[j];
             }
@@ -135,6 +246,7 @@ void FeatureLookup::addTagDictWeights(const std::vector<pair<int,int> > & exists
         if(tagDictVector_) {
             int tags = scores.size();
             for(int j = 0; j < (int)exists.size(); j++) {
+                if(exists[j].second >= tags) continue;
                 int base = exists[j].first*tags*tags+exists[j].second*tags;
                 for(int i = 0; i < (int)scores.size(); i++)
                     scores[i] += (*tagDictVector_)[base+i];
@@ -74,6 +74,7 @@ template double GeneralIO::readBinary<double>();
 template unsigned short GeneralIO::readBinary<unsigned short>();
 template unsigned int GeneralIO::readBinary<unsigned int>();
 template unsigned char GeneralIO::readBinary<unsigned char>();
+template uint64_t GeneralIO::readBinary<uint64_t>();
 
 std::string GeneralIO::readString() {
     std::string str;
@@ -82,7 +83,7 @@ std::string GeneralIO::readString() {
 }
 KinkakuString GeneralIO::readKinkakuString() {
     KinkakuString ret(readBinary<uint32_t>());
-    for(unsigned i = 0; i < ret.length(); i++)
-        ret[i] = readBinary<KinkakuChar>();
+    if(ret.length())
+        str_->read(reinterpret_cast<char *>(&ret[0]), ret.length()*sizeof(KinkakuChar));
     return ret;
 }
\ No newline at end of file
@@ -92,6 +92,8 @@ void KinkakuConfig::printUsage() {
 "  -subword A file of subword units. This will enable unknown word PE." << endl <<
 "  -model   The file to write the trained model to" << endl <<
 "  -modtext Print a text model (instead of the default binary)" << endl <<
+"  -modmap  Print a binary model that can be mapped into memory when loaded" << endl <<
+"  -modcompact Print a small binary model for distribution" << endl <<
 "  -featout Write the features used in training the model to this file" << endl <<
 "Model Training Options (basic)" << endl <<
 "  -nows    Don't train a word segmentation model" << endl <<
@@ -130,6 +132,15 @@ void KinkakuConfig::printUsage() {
 "  -notags  Do only word segmentation, no tagging" << endl <<
 "  -notag   Skip the tag of the nth tag (n starts at 1)" << endl <<
 "  -nounk   Don't estimate the pronunciation of unknown words" << endl <<
+"  -userdict A dictionary of words to add to the model's dictionary at" << endl <<
+"           analysis time (multiple possible, may be compiled with" << endl <<
+"           kinkaku-dict-compile)" << endl <<
+"  -userdictid The model dictionary (-dict, n starts at 1) whose features are" << endl <<
+"           used for -userdict words (default 1)" << endl <<
+"  -modelcache The megabytes of memory to keep the tag models of dictionary" << endl <<
+"           words in, which are read from the model when first used" << endl <<
+"           (default 0, no limit)" << endl <<
+"  -hugepages Load the model into huge pages when the system allows it" << endl <<
 "  -wsconst Specifies character types to not be segmented (e.g. D for digits)" << endl <<
 "  -unkbeam The width of the beam to use in beam search for unknown words " << endl <<
 "           (default 50, 0 for full search)" << endl <<
@@ -185,6 +196,8 @@ unsigned KinkakuConfig::parseTrainArg(const char * n, const char * v) {
 
     else if(!strcmp(n, "-model"))    { ch(n,v); setModelFile(v); }
     else if(!strcmp(n, "-modtext"))  { setModelFormat('T'); r=0; }
+    else if(!strcmp(n, "-modmap"))   { setModelFormat('M'); r=0; }
+    else if(!strcmp(n, "-modcompact")) { setModelFormat('C'); r=0; }
     else if(!strcmp(n, "-featout"))  { ch(n,v); setFeatureOut(v); }
     else if(!strcmp(n, "-feat"))     { ch(n,v); setFeatureIn(v); }
     else if(!strcmp(n, "-numtags"))  { ch(n,v); setNumTags(util_->parseInt(v)); }
@@ -246,6 +259,18 @@ unsigned KinkakuConfig::parseRunArg(const char * n, const char * v) {
     else if(!strcmp(n, "-nounk"))    { setDoUnk(false); r=0; }
     else if(!strcmp(n, "-numtags"))  { ch(n,v); setNumTags(util_->parseInt(v)); }
     else if(!strcmp(n, "-tagmax"))   { ch(n,v); setTagMax(util_->parseInt(v)); }
+    else if(!strcmp(n, "-userdict")) { ch(n,v); addUserDictionary(v); }
+    else if(!strcmp(n, "-userdictid")) { 
+        ch(n,v); 
+        if(util_->parseInt(v) < 1) THROW_ERROR("Illegal setting "<<v<<" for -userdictid (must be 1 or greater)");
+        setUserDictionaryId(util_->parseInt(v)-1);
+    }
+    else if(!strcmp(n, "-modelcache")) { 
+        ch(n,v); 
+        if(util_->parseInt(v) < 0) THROW_ERROR("Illegal setting "<<v<<" for -modelcache (must be 0 or greater)");
+        setModelCache((size_t)util_->parseInt(v) << 20);
+    }
+    else if(!strcmp(n, "-hugepages")) { setHugePages(true); r=0; }
 
     else if(!strcmp(n, "-unktag"))   { ch(n,v); setUnkTag(v); }
     else if(!strcmp(n, "-deftag"))   { ch(n,v); setDefaultTag(v); }
@@ -270,8 +295,9 @@ unsigned KinkakuConfig::parseRunArg(const char * n, const char * v) {
 }
 
 void KinkakuConfig::setEncoding(const char* str) {
-    if(util_)
+    if(util_ && ownsUtil_)
         delete util_;
+    ownsUtil_ = true;
     if(!strcmp(str,"utf8")) util_ = new StringUtilUtf8();
     else if(!strcmp(str,"euc")) util_ = new StringUtilEuc();
     else if(!strcmp(str,"sjis")) util_ = new StringUtilSjis();
@@ -280,7 +306,15 @@ void KinkakuConfig::setEncoding(const char* str) {
 }
 
 
-KinkakuConfig::KinkakuConfig() : onTraining_(true), debug_(0), util_(0), dicts_(), 
+void KinkakuConfig::shareStringUtil(StringUtil * util) {
+    if(util_ && ownsUtil_ && util_ != util)
+        delete util_;
+    util_ = util;
+    ownsUtil_ = false;
+}
+
+KinkakuConfig::KinkakuConfig() : onTraining_(true), debug_(0), util_(0), ownsUtil_(false), dicts_(), 
+                userDicts_(), userDictId_(0),
                 modelForm_('B'), inputForm_(CORP_FORMAT_DEFAULT),
                 outputForm_(CORP_FORMAT_FULL), featStr_(0),
                 doWS_(true), doTags_(true), doUnk_(true),
@@ -292,12 +326,13 @@ KinkakuConfig::KinkakuConfig() : onTraining_(true), debug_(0), util_(0), dicts_(
                 wordBound_(" "), tagBound_("/"), elemBound_("&"), unkBound_(" "), 
                 noBound_("-"), hasBound_("|"), skipBound_("?"), escape_("\\"), 
                 wsConstraint_(""),
-                numTags_(0), tagMax_(3) {
+                numTags_(0), tagMax_(3), modelCache_(0), hugePages_(false) {
     setEncoding("utf8");
 }
 KinkakuConfig::KinkakuConfig(const KinkakuConfig & rhs) 
               :  onTraining_(rhs.onTraining_), debug_(rhs.debug_), 
-                 util_(rhs.util_), dicts_(rhs.dicts_),
+                 util_(rhs.util_), ownsUtil_(false), dicts_(rhs.dicts_),
+                 userDicts_(rhs.userDicts_), userDictId_(rhs.userDictId_),
                  modelForm_(rhs.modelForm_), inputForm_(rhs.inputForm_), 
                  outputForm_(rhs.outputForm_), featStr_(rhs.featStr_), 
                  doWS_(rhs.doWS_), doTags_(rhs.doTags_), 
@@ -312,13 +347,14 @@ KinkakuConfig::KinkakuConfig(const KinkakuConfig & rhs)
                  tagBound_(rhs.tagBound_), elemBound_(rhs.elemBound_), 
                  unkBound_(rhs.unkBound_), noBound_(rhs.noBound_), 
                  hasBound_(rhs.hasBound_), skipBound_(rhs.skipBound_), 
-                 escape_(rhs.escape_), numTags_(rhs.numTags_), tagMax_(rhs.tagMax_)
+                 escape_(rhs.escape_), numTags_(rhs.numTags_), tagMax_(rhs.tagMax_),
+                 modelCache_(rhs.modelCache_), hugePages_(rhs.hugePages_)
 {
 
 }
 
 KinkakuConfig::~KinkakuConfig() {
-    if(util_)
+    if(util_ && ownsUtil_)
         delete util_;
 }
 
@@ -335,6 +371,10 @@ void KinkakuConfig::addSubwordDict(const std::string & corp) {
     subwordDicts_.push_back(corp);
 }
 
+void KinkakuConfig::addUserDictionary(const std::string & corp) {
+    userDicts_.push_back(corp);
+}
+
 const char KinkakuConfig::getEncoding() const { return util_->getEncoding(); }
 const char* KinkakuConfig::getEncodingString() const { return util_->getEncodingString(); }
 
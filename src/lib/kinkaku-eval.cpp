@@ -0,0 +1,112 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-eval.h>
+#include <kinkaku/kinkaku.h>
+#include <kinkaku/kinkaku-struct.h>
+#include <kinkaku/corpus-io.h>
+#include <kinkaku/string-util.h>
+#include <sys/time.h>
+#include <map>
+
+using namespace kinkaku;
+using namespace std;
+
+static double getTime() {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// The words of a sentence, indexed by their start and end characters
+typedef map< pair<unsigned,unsigned>, const KinkakuWord* > WordSpans;
+static void getWordSpans(const KinkakuSentence & sent, WordSpans & spans) {
+    unsigned start = 0;
+    for(unsigned i = 0; i < sent.words.size(); i++) {
+        unsigned end = start + sent.words[i].surface.length();
+        spans[make_pair(start, end)] = &sent.words[i];
+        start = end;
+    }
+}
+
+void kinkaku::evaluateCorpus(Kinkaku & kinkaku, const string & file, KinkakuEvalResult & res) {
+    KinkakuConfig & config = *kinkaku.getConfig();
+    StringUtil * util = kinkaku.getStringUtil();
+    CorpusIO * in = CorpusIO::createIO(file.c_str(), CORP_FORMAT_FULL, config, false, util);
+    vector<KinkakuSentence*> golds, sents;
+    KinkakuSentence* next;
+    while((next = in->readSentence()) != 0) {
+        golds.push_back(next);
+        // the gold boundaries are certain, so calculateWS would keep them
+        if(config.getDoWS()) {
+            sents.push_back(new KinkakuSentence(next->surface, util->normalize(next->surface)));
+        } else {
+            sents.push_back(new KinkakuSentence(*next));
+            for(unsigned i = 0; i < next->words.size(); i++)
+                sents.back()->words[i].tags.clear();
+        }
+    }
+    delete in;
+    double start = getTime();
+    for(unsigned i = 0; i < sents.size(); i++) {
+        if(config.getDoWS())
+            kinkaku.calculateWS(*sents[i]);
+        if(config.getDoTags())
+            for(int j = 0; j < config.getNumTags(); j++)
+                if(config.getDoTag(j))
+                    kinkaku.calculateTags(*sents[i], j);
+    }
+    res.seconds = getTime() - start;
+    res.tags.resize(config.getNumTags(), 0);
+    res.tagsCorrect.resize(config.getNumTags(), 0);
+    for(unsigned i = 0; i < golds.size(); i++) {
+        const KinkakuSentence & gold = *golds[i], & sent = *sents[i];
+        res.chars += gold.surface.length();
+        for(unsigned j = 0; j < gold.wsConfs.size(); j++) {
+            res.bounds++;
+            if((gold.wsConfs[j] > 0) == (sent.wsConfs[j] > 0))
+                res.boundsCorrect++;
+        }
+        WordSpans spans;
+        getWordSpans(sent, spans);
+        unsigned wordStart = 0;
+        for(unsigned j = 0; j < gold.words.size(); j++) {
+            const KinkakuWord & word = gold.words[j];
+            unsigned wordEnd = wordStart + word.surface.length();
+            WordSpans::const_iterator it = spans.find(make_pair(wordStart, wordEnd));
+            for(int lev = 0; lev < config.getNumTags(); lev++) {
+                if(!word.hasTag(lev))
+                    continue;
+                res.tags[lev]++;
+                if(it != spans.end() && it->second->hasTag(lev) && it->second->getTagSurf(lev) == word.getTagSurf(lev))
+                    res.tagsCorrect[lev]++;
+            }
+            wordStart = wordEnd;
+        }
+        delete golds[i];
+        delete sents[i];
+    }
+}
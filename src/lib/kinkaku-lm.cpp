@@ -28,6 +28,7 @@
 #include <kinkaku/kinkaku-util.h>
 #include <iostream>
 #include <cmath>
+#include <cstring>
 
 using namespace kinkaku;
 using namespace std;
@@ -87,7 +88,21 @@ void KinkakuLM::train(const std::vector<KinkakuString> & corpus) {
         it->second = log((it->second*discounts[it->first.length()])/denominators[it->first]);
 }
 
-double KinkakuLM::scoreSingle(const KinkakuString & val, int pos) {
+// short n-grams make keys stored inline, so the lookup does not allocate
+static const double * findWeight(const KinkakuDoubleMap & myMap, const KinkakuStringView & ngram) {
+    KinkakuDoubleMap::const_iterator it = myMap.find(KinkakuString(ngram));
+    return (it == myMap.end() ? 0 : &it->second);
+}
+
+const double * KinkakuLM::findProb(const KinkakuStringView & ngram) const {
+    return findWeight(probs_, ngram);
+}
+
+const double * KinkakuLM::findFallback(const KinkakuStringView & ngram) const {
+    return findWeight(fallbacks_, ngram);
+}
+
+double KinkakuLM::scoreSingle(const KinkakuStringView & val, int pos) {
     KinkakuString ngram(n_);
     for(unsigned i = 0; i < n_; i++) ngram[i] = 0;
     int npos = n_;
@@ -97,40 +112,36 @@ double KinkakuLM::scoreSingle(const KinkakuString & val, int pos) {
     }
     while(--npos >= 0 && pos >= 0)
         ngram[npos] = val[pos--];
+    const KinkakuStringView view(ngram);
     double prob = 0;
+    const double * weight;
     for(npos = 0; npos < (int)n_; npos++) {
-        KinkakuDoubleMap::const_iterator it = probs_.find(ngram.substr(npos));
-        if(it != probs_.end()) {
-            prob += it->second;
+        if((weight = findProb(view.substr(npos))) != 0) {
+            prob += *weight;
             return prob;
-        } else {
-            it = fallbacks_.find(ngram.substr(npos, n_-npos-1));
-            if(it != fallbacks_.end())
-                prob += it->second;
-        }
+        } else if((weight = findFallback(view.substr(npos, n_-npos-1))) != 0)
+            prob += *weight;
     }
     return prob + log(1.0/vocabSize_);
 }
 
-double KinkakuLM::score(const KinkakuString& val) const {
+double KinkakuLM::score(const KinkakuStringView & val) const {
     unsigned j, len;
     double prob = 0;
     KinkakuString testString(val.length()+n_);
     for(j = 0; j < n_-1; j++)
         testString[j] = 0;
     testString[testString.length()-1] = 0;
-    testString.splice(val,n_-1);
-    for(j = n_; j < testString.length(); j++) {
+    memcpy(testString.data()+n_-1, val.data(), sizeof(KinkakuChar)*val.length());
+    const KinkakuStringView view(testString);
+    const double * weight;
+    for(j = n_; j < view.length(); j++) {
         for(len = n_; len > 0; len--) {
-            KinkakuDoubleMap::const_iterator it = const_cast<KinkakuDoubleMap*>(&probs_)->find(testString.substr(j-len, len));
-            if(it != probs_.end()) {
-                prob += it->second;
+            if((weight = findProb(view.substr(j-len, len))) != 0) {
+                prob += *weight;
                 break;
-            } else {
-                it = const_cast<KinkakuDoubleMap*>(&fallbacks_)->find(testString.substr(j-len, len-1));
-                if(it != fallbacks_.end())
-                    prob += it->second;
-            }
+            } else if((weight = findFallback(view.substr(j-len, len-1))) != 0)
+                prob += *weight;
         }
         if(n_ == 0)
             prob += log(1.0/vocabSize_);
@@ -0,0 +1,172 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-model-bundle.h>
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku-model.h>
+#include <kinkaku/kinkaku-lm.h>
+#include <kinkaku/dictionary.h>
+#include <kinkaku/local-model-table.h>
+#include <kinkaku/model-io.h>
+#include <kinkaku/kinkaku-thread.h>
+#include <iostream>
+
+using namespace std;
+
+namespace kinkaku {
+
+// Sections are independent, so each is decoded by its own reader on any
+// thread
+class ModelSectionTask : public ParallelTask {
+public:
+    ModelSectionTask(KinkakuModelBundle * bundle, ModelIO * modin, const vector<unsigned> & sections) : 
+        bundle_(bundle), modin_(modin), sections_(sections) { }
+    void run(unsigned begin, unsigned end) {
+        for(unsigned i = begin; i < end; i++) {
+            ModelIO * section = modin_->openSection(sections_[i]);
+            try {
+                bundle_->readSection(section, sections_[i]);
+            } catch(...) {
+                delete section;
+                throw;
+            }
+            delete section;
+        }
+    }
+private:
+    KinkakuModelBundle * bundle_;
+    ModelIO * modin_;
+    const vector<unsigned> & sections_;
+};
+
+}
+
+using namespace kinkaku;
+
+KinkakuModelBundle::KinkakuModelBundle(KinkakuConfig * config) : 
+        config_(config), wsModel_(0), dict_(0), localMods_(0), subwordDict_(0), count_(1) {
+    pthread_mutex_init(&mutex_, 0);
+}
+
+KinkakuModelBundle::~KinkakuModelBundle() {
+    if(dict_) delete dict_;
+    if(localMods_) delete localMods_;
+    if(subwordDict_) delete subwordDict_;
+    if(wsModel_) delete wsModel_;
+    for(unsigned i = 0; i < subwordModels_.size(); i++)
+        if(subwordModels_[i]) delete subwordModels_[i];
+    for(unsigned i = 0; i < globalMods_.size(); i++)
+        if(globalMods_[i]) delete globalMods_[i];
+    pthread_mutex_destroy(&mutex_);
+    delete config_;
+}
+
+void KinkakuModelBundle::addRef() {
+    pthread_mutex_lock(&mutex_);
+    count_++;
+    pthread_mutex_unlock(&mutex_);
+}
+
+void KinkakuModelBundle::release() {
+    pthread_mutex_lock(&mutex_);
+    unsigned count = --count_;
+    pthread_mutex_unlock(&mutex_);
+    if(count == 0)
+        delete this;
+}
+
+bool KinkakuModelBundle::isShared() {
+    pthread_mutex_lock(&mutex_);
+    bool ret = count_ > 1;
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
+
+KinkakuModelBundle * KinkakuModelBundle::read(const char * file, KinkakuConfig * config) {
+    KinkakuModelBundle * ret = new KinkakuModelBundle(config);
+    ModelIO * modin = 0;
+    try {
+        modin = ModelIO::createIO(file, ModelIO::FORMAT_UNKNOWN, false, *config);
+        modin->readConfig(*config);
+        int numTags = config->getNumTags();
+        unsigned numSections = ModelIO::getNumSections(numTags);
+        ret->globalMods_.resize(numTags, 0);
+        ret->globalTags_.resize(numTags, vector<KinkakuString>());
+        ret->subwordModels_.resize(numTags, 0);
+        modin->setReadLocalModels(config->getDoTags());
+        if(modin->getNumSections() == numSections) {
+            vector<unsigned> sections;
+            for(unsigned i = 0; i < numSections; i++)
+                if(ret->needSection(i))
+                    sections.push_back(i);
+            ModelSectionTask task(ret, modin, sections);
+            runParallel(task, sections.size());
+        } else {
+            for(unsigned i = 0; i < numSections; i++)
+                ret->readSection(modin, i);
+        }
+        if(ret->localMods_)
+            ret->localMods_->setMemoryLimit(config->getModelCache());
+    } catch(...) {
+        if(modin) delete modin;
+        ret->release();
+        throw;
+    }
+    delete modin;
+    return ret;
+}
+
+bool KinkakuModelBundle::needSection(unsigned i) const {
+    int numTags = config_->getNumTags();
+    if(i == 0)
+        return config_->getDoWS();
+    else if(i <= (unsigned)numTags)
+        return config_->getDoTag(i-1);
+    // the dictionary gives features for word segmentation as well
+    else if(i == (unsigned)numTags+1)
+        return true;
+    else if(i == (unsigned)numTags+2)
+        return config_->getDoTags() && config_->getDoUnk();
+    else
+        return config_->getDoTag(i-numTags-3) && config_->getDoUnk();
+}
+
+void KinkakuModelBundle::readSection(ModelIO * modin, unsigned i) {
+    int numTags = config_->getNumTags();
+    if(i == 0) {
+        wsModel_ = modin->readModel();
+    } else if(i <= (unsigned)numTags) {
+        globalTags_[i-1] = modin->readWordList();
+        globalMods_[i-1] = modin->readModel();
+    } else if(i == (unsigned)numTags+1) {
+        dict_ = modin->readModelDictionary();
+        localMods_ = modin->takeLocalModels();
+    } else if(i == (unsigned)numTags+2) {
+        subwordDict_ = modin->readProbDictionary();
+    } else {
+        subwordModels_[i-numTags-3] = modin->readLM();
+    }
+}
@@ -0,0 +1,175 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-model-stats.h>
+#include <kinkaku/kinkaku-model.h>
+#include <kinkaku/kinkaku-lm.h>
+#include <kinkaku/feature-lookup.h>
+#include <kinkaku/dictionary.h>
+#include <iomanip>
+#include <sstream>
+
+using namespace kinkaku;
+using namespace std;
+
+template <class Entry>
+static void addAutomaton(ModelComponentStats & stats, const Dictionary<Entry> * dict) {
+    stats.states += dict->getNumStates();
+    stats.gotos += dict->getNumGotos();
+    stats.outputs += dict->getEntries().size();
+}
+
+static void addWeights(ModelComponentStats & stats, const FeatVec * vec) {
+    stats.featVecs++;
+    stats.elements += vec->size();
+    for(const FeatVal * it = vec->begin(); it != vec->end(); it++)
+        if(*it != 0)
+            stats.nonZero++;
+}
+
+void ModelComponentStats::addDictionary(const Dictionary<ModelTagEntry> * dict) {
+    if(!dict) return;
+    addAutomaton(*this, dict);
+    bytes += sizeof(*dict) + dict->getMemoryUsage();
+}
+
+void ModelComponentStats::addDictionary(const Dictionary<ProbTagEntry> * dict) {
+    if(!dict) return;
+    addAutomaton(*this, dict);
+    bytes += sizeof(*dict) + dict->getMemoryUsage();
+}
+
+void ModelComponentStats::addDictionary(const Dictionary<FeatVec> * dict) {
+    if(!dict) return;
+    addAutomaton(*this, dict);
+    const vector<FeatVec*> & entries = dict->getEntries();
+    for(unsigned i = 0; i < entries.size(); i++)
+        addWeights(*this, entries[i]);
+    bytes += sizeof(*dict) + dict->getMemoryUsage();
+}
+
+void ModelComponentStats::addFeatureLookup(const FeatureLookup * look) {
+    if(!look) return;
+    const Dictionary<FeatVec> * dicts[3] = { look->getCharDict(), look->getTypeDict(), look->getSelfDict() };
+    for(int i = 0; i < 3; i++) {
+        if(dicts[i]) {
+            addAutomaton(*this, dicts[i]);
+            const vector<FeatVec*> & entries = dicts[i]->getEntries();
+            for(unsigned j = 0; j < entries.size(); j++)
+                addWeights(*this, entries[j]);
+        }
+    }
+    const FeatVec * vecs[4] = { look->getDictVector(), look->getBiases(), look->getTagDictVector(), look->getTagUnkVector() };
+    for(int i = 0; i < 4; i++)
+        if(vecs[i] && !vecs[i]->empty())
+            addWeights(*this, vecs[i]);
+    bytes += look->getMemoryUsage();
+}
+
+void ModelComponentStats::addModel(const KinkakuModel * mod) {
+    if(!mod) return;
+    models++;
+    bytes += sizeof(KinkakuModel);
+    addFeatureLookup(mod->getFeatureLookup());
+}
+
+// An estimate for the maps, counting each node as its value and two
+// pointers, and each key string separately
+static size_t mapMemoryUsage(const KinkakuDoubleMap & probs) {
+    size_t ret = 0;
+    for(KinkakuDoubleMap::const_iterator it = probs.begin(); it != probs.end(); it++)
+        ret += sizeof(*it) + 2*sizeof(void*) + it->first.getHeapSize();
+    return ret;
+}
+
+static size_t countNonZero(const KinkakuDoubleMap & probs) {
+    size_t ret = 0;
+    for(KinkakuDoubleMap::const_iterator it = probs.begin(); it != probs.end(); it++)
+        if(it->second != 0)
+            ret++;
+    return ret;
+}
+
+void ModelComponentStats::addLM(const KinkakuLM * lm) {
+    if(!lm) return;
+    models++;
+    outputs += lm->getProbs().size();
+    elements += lm->getProbs().size() + lm->getFallbacks().size();
+    nonZero += countNonZero(lm->getProbs()) + countNonZero(lm->getFallbacks());
+    bytes += sizeof(KinkakuLM) + mapMemoryUsage(lm->getProbs()) + mapMemoryUsage(lm->getFallbacks());
+}
+
+void ModelComponentStats::add(const ModelComponentStats & rhs) {
+    models += rhs.models;
+    states += rhs.states;
+    gotos += rhs.gotos;
+    outputs += rhs.outputs;
+    featVecs += rhs.featVecs;
+    elements += rhs.elements;
+    nonZero += rhs.nonZero;
+    bytes += rhs.bytes;
+}
+
+void KinkakuModelStats::addLocalModelSize(size_t elements) {
+    unsigned bucket = 0;
+    for(size_t i = elements; i > 0; i >>= 1)
+        bucket++;
+    if(localModelSizes.size() <= bucket)
+        localModelSizes.resize(bucket+1, 0);
+    localModelSizes[bucket]++;
+}
+
+static void printRow(ostream & out, const ModelComponentStats & stats) {
+    out << setw(16) << left << stats.name << right
+        << setw(8) << stats.models << setw(10) << stats.states << setw(10) << stats.gotos
+        << setw(10) << stats.outputs << setw(10) << stats.featVecs << setw(12) << stats.elements
+        << setw(12) << stats.nonZero << setw(14) << stats.bytes << endl;
+}
+
+void KinkakuModelStats::print(ostream & out) const {
+    out << setw(16) << left << "component" << right
+        << setw(8) << "models" << setw(10) << "states" << setw(10) << "gotos"
+        << setw(10) << "outputs" << setw(10) << "featvecs" << setw(12) << "elements"
+        << setw(12) << "nonzero" << setw(14) << "bytes" << endl;
+    ModelComponentStats total("total");
+    for(unsigned i = 0; i < components.size(); i++) {
+        printRow(out, components[i]);
+        total.add(components[i]);
+    }
+    printRow(out, total);
+    if(localModelSizes.size() == 0)
+        return;
+    out << endl << "local models by number of weights" << endl;
+    for(unsigned i = 0; i < localModelSizes.size(); i++) {
+        if(localModelSizes[i] == 0)
+            continue;
+        ostringstream range;
+        if(i == 0) range << 0;
+        else if(i == 1) range << 1;
+        else range << (1UL << (i-1)) << "-" << (1UL << i)-1;
+        out << setw(16) << left << range.str() << right << setw(8) << localModelSizes[i] << endl;
+    }
+}
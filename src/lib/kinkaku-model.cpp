@@ -281,8 +281,8 @@ void KinkakuModel::setNumClasses(unsigned v) {
     numW_ = (v==2 && solver_ != MCSVM_CS?1:v);
 }
 
-Dictionary<vector<FeatVal> > * KinkakuModel::makeDictionaryFromPrefixes(const vector<KinkakuString> & prefs, StringUtil* util, bool adjustPos) {
-    typedef Dictionary<vector<FeatVal> >::WordMap WordMap;
+Dictionary<FeatVec> * KinkakuModel::makeDictionaryFromPrefixes(const vector<KinkakuString> & prefs, StringUtil* util, bool adjustPos) {
+    typedef Dictionary<FeatVec>::WordMap WordMap;
     WordMap wm;
     int pos;
     for(int i = 0; i < (int)names_.size(); i++) {
@@ -293,7 +293,7 @@ Dictionary<vector<FeatVal> > * KinkakuModel::makeDictionaryFromPrefixes(const ve
             KinkakuString name = str.substr(prefs[pos].length());
             WordMap::iterator it = wm.find(name);
             if(it == wm.end()) {
-                pair<WordMap::iterator, bool> p = wm.insert(WordMap::value_type(name,new vector<FeatVal>(prefs.size()*numW_)));
+                pair<WordMap::iterator, bool> p = wm.insert(WordMap::value_type(name,new FeatVec(prefs.size()*numW_)));
                 it = p.first;
             }
             int id = (adjustPos ?
@@ -306,14 +306,24 @@ Dictionary<vector<FeatVal> > * KinkakuModel::makeDictionaryFromPrefixes(const ve
         }
     }
     if(wm.size() > 0) {
-        Dictionary<vector<FeatVal> > * ret = new Dictionary<vector<FeatVal> >(util);
+        Dictionary<FeatVec> * ret = new Dictionary<FeatVec>(util);
         ret->buildIndex(wm);
         return ret;
     }
     return NULL;
 }
 
+size_t KinkakuModel::pruneFeatureLookup(StringUtil * util, double threshold, unsigned topK) {
+    if(!featLookup_)
+        return 0;
+    vector<FeatVal>().swap(weights_);
+    return featLookup_->pruneNgrams(util, threshold, topK);
+}
+
 void KinkakuModel::buildFeatureLookup(StringUtil * util, int charw, int typew, int numDicts, int maxLen) {
+    // models read from a file have no weights, only the lookup to keep
+    if(featLookup_ && weights_.size() == 0)
+        return;
     if(featLookup_) {
         delete featLookup_;
         featLookup_ = 0;
@@ -345,7 +355,7 @@ void KinkakuModel::buildFeatureLookup(StringUtil * util, int charw, int typew, i
     bool prevAddFeat = addFeat_;
     addFeat_ = false;
     if(numDicts*maxLen > 0) {
-        vector<FeatVal> * dictFeats = new vector<FeatVal>(numDicts*maxLen*3,0);
+        FeatVec * dictFeats = new FeatVec(numDicts*maxLen*3,0);
         int id = 0;
         for(int i = 0; i < numDicts; i++) {
             for(int j = 1; j <= maxLen; j++) {
@@ -375,7 +385,7 @@ void KinkakuModel::buildFeatureLookup(StringUtil * util, int charw, int typew, i
         featLookup_->setDictVector(dictFeats);
     }
     if(numDicts > 0) {
-        vector<FeatVal> * tagDictFeats = new vector<FeatVal>(numDicts*labels_.size()*labels_.size(),0);
+        FeatVec * tagDictFeats = new FeatVec(numDicts*labels_.size()*labels_.size(),0);
         int id = 0;
         for(int i = 0; i <= numDicts; i++) {
             for(int j = 0; j < (int)labels_.size(); j++) {
@@ -393,7 +403,7 @@ void KinkakuModel::buildFeatureLookup(StringUtil * util, int charw, int typew, i
     }
     unsigned id1 = mapFeat(util->mapString("UNK"));
     if(id1 != 0) {
-        vector<FeatVal> * tagUnkFeats = new vector<FeatVal>(labels_.size(),0);
+        FeatVec * tagUnkFeats = new FeatVec(labels_.size(),0);
         featuresAdded_++;
         for(int k = 0; k < (int)labels_.size(); k++)
             (*tagUnkFeats)[k] = getWeight(id1-1, k) * labels_[0];
@@ -26,24 +26,28 @@
 **/
 #include <kinkaku/kinkaku-string.h>
 #include <cstring>
+#include <algorithm>
 
 using namespace kinkaku;
 using namespace std;
 
-KinkakuStringImpl::KinkakuStringImpl(unsigned length) : length_(length), count_(1) {
-    chars_ = new KinkakuChar[length];
+KinkakuStringImpl* KinkakuStringImpl::create(unsigned length) {
+    void* block = ::operator new(sizeof(KinkakuStringImpl) + sizeof(KinkakuChar)*length);
+    return new(block) KinkakuStringImpl(length);
 }
-KinkakuStringImpl::KinkakuStringImpl(const KinkakuStringImpl & impl) : length_(impl.length_), count_(1) {
-    chars_ = new KinkakuChar[length_];
-    memcpy(chars_, impl.chars_, sizeof(KinkakuChar)*length_);
+KinkakuStringImpl* KinkakuStringImpl::create(const KinkakuChar* chars, unsigned length) {
+    KinkakuStringImpl* ret = create(length);
+    memcpy(ret->getChars(), chars, sizeof(KinkakuChar)*length);
+    return ret;
 }
 
 KinkakuString::Tokens KinkakuString::tokenize(const KinkakuString & delim, bool includeDelim) const {
     unsigned i,j,s=0;
     const unsigned l=length(),dl=delim.length();
+    const KinkakuChar* cs = data();
     vector<KinkakuString> ret;
     for(i = 0; i < l; i++) {
-        for(j = 0; j < dl && delim[j] != impl_->chars_[i]; j++);
+        for(j = 0; j < dl && delim[j] != cs[i]; j++);
         if(j != dl) {
             if(s != i)
                 ret.push_back(substr(s,i-s));
@@ -65,7 +69,7 @@ void KinkakuString::splice(const KinkakuString& str, unsigned pos) {
     if(pos+l > length())
         throw runtime_error("KinkakuString splice index out of bounds");
 #endif
-    memcpy(impl_->chars_+pos, str.getImpl()->chars_, sizeof(KinkakuChar)*l);
+    memcpy(data()+pos, str.data(), sizeof(KinkakuChar)*l);
 }
 
 KinkakuString KinkakuString::substr(unsigned s) const {
@@ -75,7 +79,7 @@ KinkakuString KinkakuString::substr(unsigned s) const {
         throw runtime_error("KinkakuString substr index out of bounds");
 #endif
     KinkakuString ret(l);
-    memcpy(ret.getImpl()->chars_, impl_->chars_+s, sizeof(KinkakuChar)*l);
+    memcpy(ret.data(), data()+s, sizeof(KinkakuChar)*l);
     return ret;
 }
 
@@ -86,27 +90,64 @@ KinkakuString KinkakuString::substr(unsigned s, unsigned l) const {
         throw runtime_error("substr out of bounds");
 #endif
     KinkakuString ret(l);
-    memcpy(ret.getImpl()->chars_, impl_->chars_+s, sizeof(KinkakuChar)*l);
+    memcpy(ret.data(), data()+s, sizeof(KinkakuChar)*l);
     return ret;
 }
 
 size_t KinkakuString::getHash() const {
-    size_t hash = 5381;
-    if(impl_==0)
-        return hash;
-    const unsigned l = impl_->length_;
-    const KinkakuChar* cs = impl_->chars_;
-    for(unsigned i = 0; i < l; i++)
-        hash = ((hash << 5) + hash) + cs[i];
-    return hash;
+    return KinkakuStringView(*this).getHash();
 }
 
-KinkakuStringImpl * KinkakuString::getImpl() {
-    if(impl_->count_ != 1) {
-        impl_->dec();
-        impl_ = new KinkakuStringImpl(*impl_);
+void KinkakuString::resize(unsigned length) {
+    const unsigned oldLength = this->length(), kept = min(oldLength, length);
+    if(isInline()) {
+        if(length <= INLINE_LENGTH) {
+            store_.small.length = length;
+            return;
+        }
+        KinkakuStringImpl* impl = KinkakuStringImpl::create(length);
+        memcpy(impl->getChars(), store_.small.chars, sizeof(KinkakuChar)*kept);
+        store_.heap.length = length | HEAP_FLAG;
+        store_.heap.impl = impl;
+        return;
+    }
+    KinkakuStringImpl* impl = store_.heap.impl;
+    if(impl->isUnique() && impl->capacity_ >= length) {
+        store_.heap.length = length | HEAP_FLAG;
+    } else if(length <= INLINE_LENGTH) {
+        KinkakuChar chars[INLINE_LENGTH];
+        memcpy(chars, impl->getChars(), sizeof(KinkakuChar)*kept);
+        release();
+        store_.small.length = length;
+        memcpy(store_.small.chars, chars, sizeof(KinkakuChar)*kept);
+    } else {
+        KinkakuStringImpl* next = KinkakuStringImpl::create(length);
+        memcpy(next->getChars(), impl->getChars(), sizeof(KinkakuChar)*kept);
+        release();
+        store_.heap.length = length | HEAP_FLAG;
+        store_.heap.impl = next;
     }
-    return impl_;
+}
+
+void KinkakuString::assign(const KinkakuStringView & view) {
+    resize(view.length());
+    memcpy(data(), view.data(), sizeof(KinkakuChar)*view.length());
+}
+
+KinkakuChar* KinkakuString::unshare() {
+    KinkakuStringImpl* impl = store_.heap.impl;
+    store_.heap.impl = KinkakuStringImpl::create(impl->getChars(), length());
+    // the other holders may have let go of the block since it was checked
+    if(!impl->dec())
+        KinkakuStringImpl::destroy(impl);
+    return store_.heap.impl->getChars();
+}
+
+KinkakuStringImpl * KinkakuString::getImpl() {
+    if(isInline())
+        return 0;
+    data();
+    return store_.heap.impl;
 }
 bool KinkakuString::beginsWith(const KinkakuString & s) const {
     if(s.length() > this->length()) return 0;
@@ -51,27 +51,56 @@ template void checkMapEqual(const KinkakuStringMap<unsigned int> & a, const Kink
 
 
 void KinkakuSentence::refreshWS(double confidence) {
-    Words newWords;
+    Words spare;
+    refreshWS(confidence, spare);
+}
+
+// the words are pushed last first, so the first word taken back out
+// is the one that held the first word
+void KinkakuSentence::clearWords(Words & spare) {
+    for(unsigned i = words.size(); i > 0; i--) {
+        spare.push_back(KinkakuWord());
+        spare.back().swap(words[i-1]);
+    }
+    words.clear();
+}
+
+void KinkakuSentence::refreshWS(double confidence, Words & spare) {
+    // the old words are put after the spare ones, and those whose
+    // boundaries are unchanged are taken back from there
+    const unsigned oldStart = spare.size(), numOld = words.size();
+    unsigned top = oldStart;
+    for(unsigned i = 0; i < numOld; i++) {
+        spare.push_back(KinkakuWord());
+        spare.back().swap(words[i]);
+    }
+    words.clear();
     int nextWord = 0, nextEnd = 0, nextStart = -1;
     if(surface.length() != 0) {
+        const KinkakuStringView surfView(surface), normView(norm);
         int last = 0, i;
         for(i = 0; i <= (int)wsConfs.size(); i++) {
             double myConf = (i == (int)wsConfs.size()) ? 100.0 : wsConfs[i];
             if(myConf > confidence) {
-                while(nextWord < (int)words.size() && nextEnd < i+1) {
+                while(nextWord < (int)numOld && nextEnd < i+1) {
                     nextStart = nextEnd;
-                    nextEnd += words[nextWord].surface.length();
+                    nextEnd += spare[oldStart+nextWord].surface.length();
                     nextWord++;
                 }
+                words.push_back(KinkakuWord());
                 if(last == nextStart && i+1 == nextEnd)
-                    newWords.push_back(words[nextWord-1]);
+                    words.back().swap(spare[oldStart+nextWord-1]);
                 else {
-                    KinkakuWord w(surface.substr(last, i-last+1), norm.substr(last, i-last+1));
-                    newWords.push_back(w);
+                    if(top > 0)
+                        words.back().swap(spare[--top]);
+                    words.back().reset(surfView.substr(last, i-last+1), normView.substr(last, i-last+1));
                 }
                 last = i+1;
             }
         }
     }
-    words = newWords;
-}
\ No newline at end of file
+    // close the gap left by the spare words that were used
+    for(unsigned j = 0; j < numOld; j++)
+        spare[top+j].swap(spare[oldStart+j]);
+    spare.resize(top+numOld);
+}
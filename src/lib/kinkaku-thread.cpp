@@ -0,0 +1,106 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-thread.h>
+#include <kinkaku/kinkaku-util.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+namespace kinkaku {
+
+// 0 until set or first asked for, and read by every thread that runs a
+// parallel task, so it is only loaded and stored atomically
+static unsigned numThreads_ = 0;
+
+unsigned getNumThreads() {
+    unsigned ret = __atomic_load_n(&numThreads_, __ATOMIC_RELAXED);
+    if(ret == 0) {
+        long procs = sysconf(_SC_NPROCESSORS_ONLN);
+        ret = (procs > 0 ? (unsigned)procs : 1);
+        unsigned unset = 0;
+        // a count set by setNumThreads in the meantime is kept
+        if(!__atomic_compare_exchange_n(&numThreads_, &unset, ret, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            ret = unset;
+    }
+    return ret;
+}
+
+void setNumThreads(unsigned numThreads) {
+    __atomic_store_n(&numThreads_, numThreads, __ATOMIC_RELAXED);
+}
+
+struct ParallelChunk {
+    ParallelTask * task;
+    unsigned begin, end;
+    string error;
+};
+
+static void * runParallelChunk(void * arg) {
+    ParallelChunk * chunk = (ParallelChunk*)arg;
+    try {
+        chunk->task->run(chunk->begin, chunk->end);
+    } catch (exception & e) {
+        chunk->error = e.what();
+    } catch (...) {
+        chunk->error = "Unknown error in worker thread";
+    }
+    return 0;
+}
+
+void runParallel(ParallelTask & task, unsigned size, unsigned minChunk) {
+    if(minChunk == 0) minChunk = 1;
+    unsigned threads = min(getNumThreads(), size/minChunk);
+    if(threads <= 1) {
+        if(size > 0) task.run(0, size);
+        return;
+    }
+    vector<ParallelChunk> chunks(threads);
+    vector<pthread_t> ids(threads);
+    vector<bool> started(threads, false);
+    for(unsigned i = 0; i < threads; i++) {
+        chunks[i].task = &task;
+        chunks[i].begin = (unsigned)((unsigned long long)size*i/threads);
+        chunks[i].end = (unsigned)((unsigned long long)size*(i+1)/threads);
+    }
+    // the first chunk is run on the calling thread, and any chunk whose
+    // thread cannot be started is run there as well
+    for(unsigned i = 1; i < threads; i++)
+        started[i] = (pthread_create(&ids[i], 0, runParallelChunk, &chunks[i]) == 0);
+    runParallelChunk(&chunks[0]);
+    for(unsigned i = 1; i < threads; i++) {
+        if(started[i]) pthread_join(ids[i], 0);
+        else runParallelChunk(&chunks[i]);
+    }
+    for(unsigned i = 0; i < threads; i++)
+        if(chunks[i].error.length())
+            THROW_ERROR(chunks[i].error);
+}
+
+}
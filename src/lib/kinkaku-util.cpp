@@ -77,6 +77,16 @@ template void checkValueVecEqual(const std::vector<vector<KinkakuString> > * a,
 template void checkValueVecEqual(const std::vector<int> * a, const std::vector<int> * b);
 template void checkValueVecEqual(const std::vector<KinkakuString> * a, const std::vector<KinkakuString> * b);
 
+void checkValueVecEqual(const FeatVec * a, const FeatVec * b) {
+    if((a == NULL || a->size() == 0) != (b == NULL || b->size() == 0)) {
+        THROW_ERROR("only one dictVector_ is NULL");
+    } else if(a != NULL) {
+        if(a->size() != b->size()) THROW_ERROR("Vector sizes don't match: "<<a->size()<<" != "<<b->size());
+        for(int i = 0; i < (int)a->size(); i++)
+            if((*a)[i] != (*b)[i]) THROW_ERROR("Vectors don't match at "<<i);
+    }
+}
+
 template <class T>
 void checkPointerVecEqual(const std::vector<T*> & a, const std::vector<T*> & b) {
     if(a.size() > b.size()) {
@@ -40,6 +40,9 @@
 #include <kinkaku/kinkaku-util.h>
 #include <kinkaku/kinkaku-lm.h>
 #include <kinkaku/feature-lookup.h>
+#include <kinkaku/local-model-table.h>
+#include <kinkaku/kinkaku-model-bundle.h>
+#include <kinkaku/kinkaku-analysis-context.h>
 
 using namespace kinkaku;
 using namespace std;
@@ -67,8 +70,8 @@ void Kinkaku::addTag(typename Dictionary<Entry>::WordMap& allWords, const Kinkak
             unsigned i;
             if((int)it->second->tags.size() <= lev)
                 it->second->setNumTags(lev+1);
-            vector<KinkakuString> & tags = it->second->tags[lev];
-            vector<unsigned char> & tagInDicts = it->second->tagInDicts[lev];
+            EntryVec<KinkakuString> & tags = it->second->tags[lev];
+            EntryVec<unsigned char> & tagInDicts = it->second->tagInDicts[lev];
             for(i = 0; i < tags.size() && tags[i] != *tag; i++);
             if(i == tags.size()) {
                 tags.push_back(*tag);
@@ -93,6 +96,26 @@ void Kinkaku::scanDictionaries(const vector<string> & dict, typename Dictionary<
     for(vector<string>::const_iterator it = dict.begin(); it != dict.end(); it++) {
         if(config_->getDebug())
             cerr << "Reading dictionary from " << *it << " ";
+        if(Dictionary<Entry>::isCompiled(*it)) {
+            // the words of a compiled dictionary are merged with the rest
+            Dictionary<ModelTagEntry> compiled(util);
+            compiled.readCompiled(*it);
+            const vector<ModelTagEntry*> & entries = compiled.getEntries();
+            for(unsigned i = 0; i < entries.size(); i++) {
+                bool hasTag = false;
+                for(unsigned j = 0; j < entries[i]->tags.size(); j++) {
+                    for(unsigned k = 0; k < entries[i]->tags[j].size(); k++)
+                        addTag<Entry>(wordMap, entries[i]->word, j, &entries[i]->tags[j][k], (saveIds?numDicts:-1));
+                    hasTag = hasTag || entries[i]->tags[j].size() > 0;
+                }
+                if(!hasTag)
+                    addTag<Entry>(wordMap, entries[i]->word, 0, 0, (saveIds?numDicts:-1));
+            }
+            numDicts++;
+            if(config_->getDebug() > 0)
+                cerr << " done (" << entries.size() << " compiled entries)" << endl;
+            continue;
+        }
         CorpusIO * io = CorpusIO::createIO(it->c_str(), CORP_FORMAT_FULL, *config, false, util);
         io->setNumTags(config_->getNumTags());
         KinkakuSentence* next;
@@ -300,11 +323,12 @@ void Kinkaku::trainWS() {
     if(config_->getDebug() > 0)
         cerr << "Creating word segmentation features ";
     vector<unsigned> dictFeats;
-    bool hasDictionary = (dict_->getNumDicts() > 0 && dict_->getStates().size() > 0);
+    bool hasDictionary = (dict_->getNumDicts() > 0 && dict_->getNumStates() > 0);
     preparePrefixes();
     unsigned scount = 0;
     vector< vector<unsigned> > & xs = trip->first;
     vector<int> & ys = trip->second;
+    KinkakuString types;
     for(Sentences::const_iterator it = sentences_.begin(); it != sentences_.end(); it++) {
         if(++scount % 1000 == 0)
             cerr << ".";
@@ -314,8 +338,8 @@ void Kinkaku::trainWS() {
         if(hasDictionary)
             fts += wsDictionaryFeatures(sent->norm, feats);
         fts += wsNgramFeatures(sent->norm, feats, charPrefixes_, config_->getCharN());
-        string str = util_->getTypeString(sent->norm);
-        fts += wsNgramFeatures(util_->mapString(str), feats, typePrefixes_, config_->getTypeN());
+        util_->getTypeIds(sent->norm, types);
+        fts += wsNgramFeatures(types, feats, typePrefixes_, config_->getTypeN());
         for(unsigned i = 0; i < feats.size(); i++) {
             if(abs(sent->wsConfs[i]) > config_->getConfidence()) {
                 xs.push_back(feats[i]);
@@ -393,7 +417,8 @@ void Kinkaku::trainGlobalTags(int lev) {
     for(Sentences::const_iterator it = sentences_.begin(); it != sentences_.end(); it++) {
         int startPos = 0, finPos=0;
         KinkakuString charStr = (*it)->norm;
-        KinkakuString typeStr = util_->mapString(util_->getTypeString(charStr));
+        KinkakuString typeStr;
+        util_->getTypeIds(charStr, typeStr);
         for(unsigned j = 0; j < (*it)->words.size(); j++) {
             startPos = finPos;
             KinkakuWord & word = (*it)->words[j];
@@ -410,7 +435,7 @@ void Kinkaku::trainGlobalTags(int lev) {
             tagNgramFeatures(charStr, feat, charPrefixes_, trip->third, config_->getCharN(), startPos-1, finPos);
             tagNgramFeatures(typeStr, feat, typePrefixes_, trip->third, config_->getTypeN(), startPos-1, finPos);
             tagSelfFeatures(word.norm, feat, kssx, trip->third);
-            tagSelfFeatures(util_->mapString(util_->getTypeString(word.norm)), feat, ksst, trip->third);
+            tagSelfFeatures(typeStr.substr(startPos, finPos-startPos), feat, ksst, trip->third);
             tagDictFeatures(word.norm, lev, feat, trip->third);
             trip->first.push_back(feat);
             trip->second.push_back(myTag);
@@ -464,13 +489,14 @@ void Kinkaku::trainLocalTags(int lev) {
                 myEntry->tagMods.resize(lev+1,0);
             myEntry->tagMods[lev] = (trip->third ? trip->third : new KinkakuModel());
             trip->third = myEntry->tagMods[lev];
-            trip->fourth = myEntry->tags[lev];
+            trip->fourth.assign(myEntry->tags[lev].begin(), myEntry->tags[lev].end());
         }
     }
     for(Sentences::const_iterator it = sentences_.begin(); it != sentences_.end(); it++) {
         int startPos = 0, finPos=0;
         KinkakuString charStr = (*it)->norm;
-        KinkakuString typeStr = util_->mapString(util_->getTypeString(charStr));
+        KinkakuString typeStr;
+        util_->getTypeIds(charStr, typeStr);
         for(unsigned j = 0; j < (*it)->words.size(); j++) {
             startPos = finPos;
             KinkakuWord & word = (*it)->words[j];
@@ -515,21 +541,132 @@ void Kinkaku::trainLocalTags(int lev) {
         cerr << "done!" << endl;
 }
 
-vector<pair<int,int> > Kinkaku::getDictionaryMatches(const KinkakuString & surf, int lev) {
-    vector<pair<int,int> > ret;
-    if(!dict_) return ret;
-    const ModelTagEntry* ent = dict_->findEntry(surf);
+inline void addDictionaryMatches(const ModelTagEntry * ent, int lev, int numDicts, vector<pair<int,int> > & ret) {
     if(ent == 0 || ent->inDict == 0 || (int)ent->tagInDicts.size() <= lev)
-        return ret;
-    const vector<unsigned char> & tid = ent->tagInDicts[lev];
+        return;
+    const EntryVec<unsigned char> & tid = ent->tagInDicts[lev];
     for(int i = 0; i < (int)tid.size(); i++) {
-        for(int j = 0; j < dict_->getNumDicts(); j++)
+        for(int j = 0; j < numDicts; j++)
             if(ModelTagEntry::isInDict(tid[i],j)) 
                 ret.push_back(pair<int,int>(j,i));
     }
+}
+
+vector<pair<int,int> > Kinkaku::getDictionaryMatches(const KinkakuStringView & surf, int lev, const Dictionary<ModelTagEntry> * userDict) {
+    vector<pair<int,int> > ret;
+    getDictionaryMatches(surf, lev, userDict, ret);
+    return ret;
+}
+
+void Kinkaku::getDictionaryMatches(const KinkakuStringView & surf, int lev, const Dictionary<ModelTagEntry> * userDict, vector<pair<int,int> > & ret) {
+    ret.clear();
+    if(!dict_) return;
+    addDictionaryMatches(dict_->findEntry(surf), lev, dict_->getNumDicts(), ret);
+    if(userDict) {
+        addDictionaryMatches(userDict->findEntry(surf), lev, dict_->getNumDicts(), ret);
+        sort(ret.begin(), ret.end());
+        ret.erase(unique(ret.begin(), ret.end()), ret.end());
+    }
+}
+
+const ModelTagEntry * Kinkaku::findEntry(const KinkakuString & word, int lev, const Dictionary<ModelTagEntry> * userDict) {
+    const ModelTagEntry * ent = (dict_ ? dict_->findEntry(word) : 0);
+    if(userDict && (ent == 0 || (lev >= 0 && ((int)ent->tags.size() <= lev || ent->tags[lev].size() == 0)))) {
+        const ModelTagEntry * userEnt = userDict->findEntry(word);
+        if(userEnt) ent = userEnt;
+    }
+    return ent;
+}
+
+Dictionary<ModelTagEntry> * Kinkaku::buildUserDictionary(const vector<string> & files, int dictId) {
+    if(dictId < 0 || dictId >= 8)
+        THROW_ERROR("Illegal dictionary id for a user dictionary ("<<dictId<<")");
+    // words are only given dictionary features the model knows about
+    int numDicts = (dict_ ? dict_->getNumDicts() : 0);
+    if(dictId >= numDicts && config_->getDebug() > 0)
+        cerr << "WARNING: the model has no dictionary "<<dictId+1<<", user dictionary features will not be used" << endl;
+    // a single compiled dictionary is used as-is from memory
+    if(files.size() == 1 && Dictionary<ModelTagEntry>::isCompiled(files[0])) {
+        Dictionary<ModelTagEntry> * ret = new Dictionary<ModelTagEntry>(util_);
+        try {
+            ret->readCompiled(files[0]);
+        } catch(...) {
+            delete ret;
+            throw;
+        }
+        vector<ModelTagEntry*> & entries = ret->getEntries();
+        for(unsigned i = 0; i < entries.size(); i++) {
+            ModelTagEntry * ent = entries[i];
+            ent->inDict = 0;
+            if(dictId < numDicts)
+                ModelTagEntry::setInDict(ent->inDict, dictId);
+            for(unsigned j = 0; j < ent->tagInDicts.size(); j++)
+                for(unsigned k = 0; k < ent->tagInDicts[j].size(); k++)
+                    ent->tagInDicts[j][k] = ent->inDict;
+        }
+        ret->setNumDicts(numDicts);
+        return ret;
+    }
+    Dictionary<ModelTagEntry>::WordMap wordMap;
+    scanDictionaries<ModelTagEntry>(files, wordMap, config_, util_, false);
+    if(wordMap.size() == 0)
+        return 0;
+    Dictionary<ModelTagEntry>::WordList wordList(wordMap.begin(), wordMap.end());
+    for(unsigned i = 0; dictId < numDicts && i < wordList.size(); i++) {
+        ModelTagEntry * ent = wordList[i].second;
+        ModelTagEntry::setInDict(ent->inDict, dictId);
+        for(unsigned j = 0; j < ent->tagInDicts.size(); j++)
+            for(unsigned k = 0; k < ent->tagInDicts[j].size(); k++)
+                ModelTagEntry::setInDict(ent->tagInDicts[j][k], dictId);
+    }
+    Dictionary<ModelTagEntry> * ret = new Dictionary<ModelTagEntry>(util_);
+    ret->buildIndex(wordList);
+    ret->setNumDicts(numDicts);
     return ret;
 }
 
+void Kinkaku::compileDictionary(const vector<string> & files, const string & outFile) {
+    Dictionary<ModelTagEntry>::WordMap wordMap;
+    scanDictionaries<ModelTagEntry>(files, wordMap, config_, util_, true);
+    if(wordMap.size() == 0)
+        THROW_ERROR("No words were found in the dictionaries to compile");
+    Dictionary<ModelTagEntry> dict(util_);
+    dict.buildIndex(wordMap);
+    dict.setNumDicts(files.size());
+    dict.writeCompiled(outFile);
+}
+
+void Kinkaku::readUserDictionary(const vector<string> & files, int dictId) {
+    Dictionary<ModelTagEntry> * userDict = buildUserDictionary(files, dictId);
+    clearUserDictionary();
+    userDict_ = userDict;
+}
+
+void Kinkaku::clearUserDictionary() {
+    if(userDict_) delete userDict_;
+    userDict_ = 0;
+}
+
+void Kinkaku::readUserDictionary(const string & id, const vector<string> & files, int dictId) {
+    Dictionary<ModelTagEntry> * userDict = buildUserDictionary(files, dictId);
+    clearUserDictionary(id);
+    if(userDict)
+        namedUserDicts_[id] = userDict;
+}
+
+void Kinkaku::clearUserDictionary(const string & id) {
+    map<string, Dictionary<ModelTagEntry>*>::iterator it = namedUserDicts_.find(id);
+    if(it == namedUserDicts_.end())
+        return;
+    delete it->second;
+    namedUserDicts_.erase(it);
+}
+
+const Dictionary<ModelTagEntry> * Kinkaku::getUserDictionary(const string & id) const {
+    map<string, Dictionary<ModelTagEntry>*>::const_iterator it = namedUserDicts_.find(id);
+    return (it == namedUserDicts_.end() ? 0 : it->second);
+}
+
 unsigned Kinkaku::tagDictFeatures(const KinkakuString & surf, int lev, vector<unsigned> & myFeats, KinkakuModel * model) {
     vector<pair<int,int> > matches = getDictionaryMatches(surf,lev);
     if(matches.size() == 0) {
@@ -617,7 +754,7 @@ void Kinkaku::trainUnk(int lev) {
                 if(myHyp[myHyp.size()-1].second == tag.length()) {
                     tagCorpus.push_back(tag);
                     for(unsigned j = 1; j < myHyp.size(); j++) {
-                        KinkakuString subChar = word.substr(myHyp[j-1].first,myHyp[j].first-myHyp[j-1].first);
+                        KinkakuStringView subChar = KinkakuStringView(word).substr(myHyp[j-1].first,myHyp[j].first-myHyp[j-1].first);
                         KinkakuString subTag = tag.substr(myHyp[j-1].second,myHyp[j].second-myHyp[j-1].second);
                         ProbTagEntry* mySubEntry = subwordDict_->findEntry(subChar);
                         mySubEntry->incrementProb(subTag,lev);
@@ -747,16 +884,23 @@ void Kinkaku::writeModel(const char* fileName) {
     buildFeatureLookups();
 
     ModelIO * modout = ModelIO::createIO(fileName,config_->getModelFormat(), true, *config_);
+    modout->setLocalModelSource(localMods_);
     modout->writeConfig(*config_);
+    modout->markSection();
     modout->writeModel(wsModel_);
     for(int i = 0; i < config_->getNumTags(); i++) {
+        modout->markSection();
         modout->writeWordList(i >= (int)globalTags_.size()?vector<KinkakuString>():globalTags_[i]);
         modout->writeModel(i >= (int)globalMods_.size()?0:globalMods_[i]);
     }
+    modout->markSection();
     modout->writeModelDictionary(dict_);
+    modout->markSection();
     modout->writeProbDictionary(subwordDict_);
-    for(int i = 0; i < config_->getNumTags(); i++)
+    for(int i = 0; i < config_->getNumTags(); i++) {
+        modout->markSection();
         modout->writeLM(i>=(int)subwordModels_.size()?0:subwordModels_[i]);
+    }
 
     delete modout;
 
@@ -765,39 +909,189 @@ void Kinkaku::writeModel(const char* fileName) {
 
 }
 
+size_t Kinkaku::pruneModel(double threshold, unsigned topK) {
+    if(bundle_ && bundle_->isShared())
+        THROW_ERROR("A model that is shared with other instances cannot be pruned");
+    buildFeatureLookups();
+    size_t ret = 0;
+    if(wsModel_)
+        ret += wsModel_->pruneFeatureLookup(util_, threshold, topK);
+    for(int i = 0; i < (int)globalMods_.size(); i++)
+        if(globalMods_[i])
+            ret += globalMods_[i]->pruneFeatureLookup(util_, threshold, topK);
+    if(dict_ == 0)
+        return ret;
+    vector<ModelTagEntry*> & localEntries = dict_->getEntries();
+    for(int i = 0; i < (int)localEntries.size(); i++) {
+        ModelTagEntry * ent = localEntries[i];
+        if(ent == 0)
+            continue;
+        if(ent->modelSlot != ModelTagEntry::NO_MODEL_SLOT && localMods_) {
+            ent->tagMods.resize(config_->getNumTags(), 0);
+            for(int j = 0; j < (int)ent->tagMods.size(); j++)
+                ent->tagMods[j] = localMods_->readModel(ent->modelSlot+j);
+            ent->modelSlot = ModelTagEntry::NO_MODEL_SLOT;
+        }
+        for(int j = 0; j < (int)ent->tagMods.size(); j++)
+            if(ent->tagMods[j])
+                ret += ent->tagMods[j]->pruneFeatureLookup(util_, threshold, topK);
+    }
+    return ret;
+}
+
+KinkakuModelStats Kinkaku::getModelStats() {
+    buildFeatureLookups();
+    KinkakuModelStats stats;
+    ModelComponentStats ws("ws");
+    ws.addModel(wsModel_);
+    stats.components.push_back(ws);
+    for(int i = 0; i < config_->getNumTags(); i++) {
+        ostringstream name; name << "global-tag" << i+1;
+        ModelComponentStats global(name.str());
+        global.addModel(i < (int)globalMods_.size() ? globalMods_[i] : 0);
+        stats.components.push_back(global);
+    }
+    ModelComponentStats local("local-tags");
+    if(dict_) {
+        // models that are shared by several entries are counted once
+        vector<char> seen(localMods_ ? localMods_->getNumModels()+1 : 0, 0);
+        const vector<ModelTagEntry*> & localEntries = dict_->getEntries();
+        for(int i = 0; i < (int)localEntries.size(); i++) {
+            const ModelTagEntry * ent = localEntries[i];
+            if(ent == 0)
+                continue;
+            for(int j = 0; j < config_->getNumTags(); j++) {
+                KinkakuModel * decoded = 0;
+                const KinkakuModel * mod = 0;
+                if(ent->modelSlot != ModelTagEntry::NO_MODEL_SLOT && localMods_) {
+                    unsigned id = localMods_->getModelId(ent->modelSlot+j);
+                    if(!seen[id]) {
+                        seen[id] = 1;
+                        mod = decoded = localMods_->readModel(ent->modelSlot+j);
+                    }
+                } else {
+                    mod = (j < (int)ent->tagMods.size() ? ent->tagMods[j] : 0);
+                }
+                if(mod) {
+                    ModelComponentStats one;
+                    one.addModel(mod);
+                    local.add(one);
+                    stats.addLocalModelSize(one.elements);
+                }
+                if(decoded) delete decoded;
+            }
+        }
+    }
+    stats.components.push_back(local);
+    ModelComponentStats dict("dict");
+    dict.addDictionary(dict_);
+    stats.components.push_back(dict);
+    ModelComponentStats subwordDict("subword-dict");
+    subwordDict.addDictionary(subwordDict_);
+    stats.components.push_back(subwordDict);
+    for(int i = 0; i < config_->getNumTags(); i++) {
+        ostringstream name; name << "subword-lm" << i+1;
+        ModelComponentStats lm(name.str());
+        lm.addLM(i < (int)subwordModels_.size() ? subwordModels_[i] : 0);
+        stats.components.push_back(lm);
+    }
+    return stats;
+}
+
 void Kinkaku::readModel(const char* fileName) {
     
     if(config_->getDebug() > 0)
         cerr << "Reading model from " << fileName;
 
-    
-    ModelIO * modin = ModelIO::createIO(fileName,ModelIO::FORMAT_UNKNOWN, false, *config_);
+    // the model gets its own configuration, with only the options that
+    // affect reading it
+    KinkakuConfig * modelConfig = new KinkakuConfig;
+    modelConfig->setDebug(config_->getDebug());
+    modelConfig->setModelCache(config_->getModelCache());
+    modelConfig->setHugePages(config_->getHugePages());
+    modelConfig->setDoWS(config_->getDoWS());
+    modelConfig->setDoTags(config_->getDoTags());
+    modelConfig->setDoUnk(config_->getDoUnk());
+    for(int i = 0; i < (int)config_->getDoTagList().size(); i++)
+        modelConfig->setDoTag(i, config_->getDoTag(i));
+    KinkakuModelBundle * bundle = KinkakuModelBundle::read(fileName, modelConfig);
+    attachModel(bundle);
+    bundle->release();
+
+    if(config_->getDebug() > 0)    
+        cerr << " done!" << endl;
+}
+
+void Kinkaku::attachModel(KinkakuModelBundle * bundle) {
+    bundle->addRef();
+    clearModel();
+    bundle_ = bundle;
+
+    const KinkakuConfig & model = *bundle->getConfig();
+    config_->shareStringUtil(bundle->config_->getStringUtil());
     util_ = config_->getStringUtil();
+    config_->setDoWS(model.getDoWS() && config_->getDoWS());
+    config_->setDoTags(model.getDoTags() && config_->getDoTags());
+    config_->setDoUnk(model.getDoUnk() && config_->getDoUnk());
+    config_->setNumTags(model.getNumTags());
+    for(int i = 0; i < model.getNumTags(); i++)
+        if(!model.getDoTag(i))
+            config_->setDoTag(i, false);
+    config_->setCharWindow(model.getCharWindow());
+    config_->setCharN(model.getCharN());
+    config_->setTypeWindow(model.getTypeWindow());
+    config_->setTypeN(model.getTypeN());
+    config_->setDictionaryN(model.getDictionaryN());
+    config_->setBias(model.getBias() > 0);
+    config_->setEpsilon(model.getEpsilon());
+    config_->setSolverType(model.getSolverType());
+
+    wsModel_ = bundle->wsModel_;
+    dict_ = bundle->dict_;
+    localMods_ = bundle->localMods_;
+    subwordDict_ = bundle->subwordDict_;
+    subwordModels_ = bundle->subwordModels_;
+    globalMods_ = bundle->globalMods_;
+    globalTags_ = bundle->globalTags_;
 
-    modin->readConfig(*config_);
-    wsModel_ = modin->readModel();
+    preparePrefixes();
+}
 
-    globalMods_.resize(config_->getNumTags(),0);
-    globalTags_.resize(config_->getNumTags(), vector<KinkakuString>());
-    for(int i = 0; i < config_->getNumTags(); i++) {
-        globalTags_[i] = modin->readWordList();
-        globalMods_[i] = modin->readModel();
+// Delete the models that this instance owns, or let go of a shared one
+void Kinkaku::clearModel() {
+    if(bundle_) {
+        bundle_->release();
+        bundle_ = 0;
+    } else {
+        if(dict_) delete dict_;
+        if(localMods_) delete localMods_;
+        if(subwordDict_) delete subwordDict_;
+        if(wsModel_) delete wsModel_;
+        for(int i = 0; i < (int)subwordModels_.size(); i++)
+            if(subwordModels_[i] != 0) delete subwordModels_[i];
+        for(int i = 0; i < (int)globalMods_.size(); i++)
+            if(globalMods_[i] != 0) delete globalMods_[i];
     }
-    dict_ = modin->readModelDictionary();
-    subwordDict_ = modin->readProbDictionary();
-    subwordModels_.resize(config_->getNumTags(),0);
-    for(int i = 0; i < config_->getNumTags(); i++)
-        subwordModels_[i] = modin->readLM();
+    dict_ = 0;
+    localMods_ = 0;
+    subwordDict_ = 0;
+    wsModel_ = 0;
+    subwordModels_.clear();
+    globalMods_.clear();
+    globalTags_.clear();
+}
 
-    delete modin;
-    
-    preparePrefixes();
+void Kinkaku::calculateWS(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict) {
+    KinkakuAnalysisContext context;
+    calculateWS(sent, userDict, context);
+}
 
-    if(config_->getDebug() > 0)    
-        cerr << " done!" << endl;
+void Kinkaku::calculateWS(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context) {
+    util_->getTypeIds(sent.norm, context.types);
+    calculateWSWithTypes(sent, userDict, context);
 }
 
-void Kinkaku::calculateWS(KinkakuSentence & sent) {
+void Kinkaku::calculateWSWithTypes(KinkakuSentence & sent, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context) {
     if(!wsModel_)
         THROW_ERROR("This model cannot be used for word segmentation.");
     
@@ -805,29 +1099,38 @@ void Kinkaku::calculateWS(KinkakuSentence & sent) {
         return;
 
     FeatureLookup * featLookup = wsModel_->getFeatureLookup();
-    vector<FeatSum> scores(sent.norm.length()-1, featLookup->getBias(0));
-    featLookup->addNgramScores(featLookup->getCharDict(), sent.norm, config_->getCharWindow(), scores);
-    const string & type_str = util_->getTypeString(sent.norm);
-    featLookup->addNgramScores(featLookup->getTypeDict(), util_->mapString(type_str), config_->getTypeWindow(), scores);
-    if(featLookup->getDictVector())
+    vector<FeatSum> & scores = context.scores;
+    scores.assign(sent.norm.length()-1, featLookup->getBias(0));
+    featLookup->addNgramScores(featLookup->getCharDict(), sent.norm, config_->getCharWindow(), scores, context.ngramMatches);
+    const KinkakuString & types = context.types;
+    featLookup->addNgramScores(featLookup->getTypeDict(), types, config_->getTypeWindow(), scores, context.ngramMatches);
+    if(featLookup->getDictVector()) {
+        Dictionary<ModelTagEntry>::MatchResult & matches = context.dictMatches;
+        dict_->match(sent.norm, matches);
+        if(userDict) {
+            Dictionary<ModelTagEntry>::MatchResult & userMatches = context.userMatches;
+            userDict->match(sent.norm, userMatches);
+            matches.insert(matches.end(), userMatches.begin(), userMatches.end());
+        }
         featLookup->addDictionaryScores(
-            dict_->match(sent.norm),
+            matches,
             dict_->getNumDicts(), config_->getDictionaryN(),
-            scores);
+            scores, context.dictOn);
+    }
     
     const string & wsc = config_->getWsConstraint();
     if(wsc.size())
         for(unsigned i = 0; i < scores.size(); i++)
-            if(type_str[i]==type_str[i+1] && wsc.find(type_str[i]) != std::string::npos)
+            if(types[i]==types[i+1] && wsc.find(util_->findType(sent.norm[i])) != std::string::npos)
                 scores[i] = KinkakuModel::isProbabilistic(config_->getSolverType())?0:-100;
 
     for(unsigned i = 0; i < sent.wsConfs.size(); i++)
         if(abs(sent.wsConfs[i]) <= config_->getConfidence())
             sent.wsConfs[i] = scores[i]*wsModel_->getMultiplier();
-    sent.refreshWS(config_->getConfidence());
+    sent.refreshWS(config_->getConfidence(), context.spareWords);
     for(int i = 0; i < (int)sent.words.size(); i++) {
         KinkakuWord & word = sent.words[i];
-        word.setUnknown(dict_->findEntry(word.norm) == 0);
+        word.setUnknown(findEntry(word.norm, -1, userDict) == 0);
     }
     if(KinkakuModel::isProbabilistic(config_->getSolverType())) {
         for(unsigned i = 0; i < sent.wsConfs.size(); i++)
@@ -898,11 +1201,20 @@ void Kinkaku::calculateUnknownTag(KinkakuWord & word, int lev) {
         tags.resize(config_->getTagMax());
 
 }
-void Kinkaku::calculateTags(KinkakuSentence & sent, int lev) {
+void Kinkaku::calculateTags(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict) {
+    KinkakuAnalysisContext context;
+    calculateTags(sent, lev, userDict, context);
+}
+
+void Kinkaku::calculateTags(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context) {
+    util_->getTypeIds(sent.norm, context.types);
+    calculateTagsWithTypes(sent, lev, userDict, context);
+}
+
+void Kinkaku::calculateTagsWithTypes(KinkakuSentence & sent, int lev, const Dictionary<ModelTagEntry> * userDict, KinkakuAnalysisContext & context) {
     int startPos = 0, finPos=0;
-    KinkakuString charStr = sent.norm;
-    KinkakuString typeStr = util_->mapString(util_->getTypeString(charStr));
-    KinkakuString kssx = util_->mapString("SX"), ksst = util_->mapString("ST");
+    const KinkakuString & charStr = sent.norm;
+    const KinkakuString & typeStr = context.types;
     const string & defTag = config_->getDefaultTag();
     for(unsigned i = 0; i < sent.words.size(); i++) {
         KinkakuWord & word = sent.words[i];
@@ -912,21 +1224,31 @@ void Kinkaku::calculateTags(KinkakuSentence & sent, int lev) {
                 continue;
         startPos = finPos;
         finPos = startPos+word.norm.length();
-        ModelTagEntry* ent = dict_->findEntry(word.norm);
+        const ModelTagEntry* ent = findEntry(word.norm, lev, userDict);
         word.setUnknown(ent == 0);
-        vector<KinkakuString> * tags = 0;
+        // the candidate tags, from the global model or the word's entry
+        const KinkakuString * tags = 0;
+        unsigned numTags = 0;
         KinkakuModel * tagMod = 0;
+        unsigned modelSlot = ModelTagEntry::NO_MODEL_SLOT;
         bool useSelf = false;
         if(lev < (int)globalMods_.size() && globalMods_[lev] != 0) {
             tagMod = globalMods_[lev];
-            tags = &globalTags_[lev];
+            tags = (globalTags_[lev].size() ? &globalTags_[lev][0] : 0);
+            numTags = globalTags_[lev].size();
             useSelf = true;
         }
         else if(ent != 0 && (int)ent->tags.size() > lev) {
-            tagMod = ent->tagMods[lev];
-            tags = &(ent->tags[lev]);
+            if(ent->modelSlot != ModelTagEntry::NO_MODEL_SLOT && localMods_) {
+                modelSlot = ent->modelSlot+lev;
+                tagMod = localMods_->acquire(modelSlot);
+            } else if((int)ent->tagMods.size() > lev) {
+                tagMod = ent->tagMods[lev];
+            }
+            tags = ent->tags[lev].data();
+            numTags = ent->tags[lev].size();
         }
-        if(tags == 0 || tags->size() == 0) {
+        if(numTags == 0) {
             if(config_->getDoUnk()) {
                 calculateUnknownTag(word,lev);
                 if(config_->getDebug() >= 2)
@@ -937,18 +1259,21 @@ void Kinkaku::calculateTags(KinkakuSentence & sent, int lev) {
             vector<unsigned> feat;
             FeatureLookup * look;
             if(tagMod == 0 || (look = tagMod->getFeatureLookup()) == NULL)
-                word.setTag(lev, KinkakuTag((*tags)[0],(KinkakuModel::isProbabilistic(config_->getSolverType())?1:100)));
+                word.setTag(lev, KinkakuTag(tags[0],(KinkakuModel::isProbabilistic(config_->getSolverType())?1:100)));
             else {        
 #ifdef KINKAKU_SAFE
                 if(look == NULL) THROW_ERROR("null lookure lookup during analysis");
 #endif
-                vector<FeatSum> scores(tagMod->getNumWeights(), 0);
-                look->addTagNgrams(charStr, look->getCharDict(), scores, config_->getCharN(), startPos, finPos);
-                look->addTagNgrams(typeStr, look->getTypeDict(), scores, config_->getTypeN(), startPos, finPos);
+                vector<FeatSum> & scores = context.scores;
+                scores.assign(tagMod->getNumWeights(), 0);
+                look->addTagNgrams(charStr, look->getCharDict(), scores, config_->getCharN(), startPos, finPos, context.tagContext, context.ngramMatches);
+                look->addTagNgrams(typeStr, look->getTypeDict(), scores, config_->getTypeN(), startPos, finPos, context.tagContext, context.ngramMatches);
                 if(useSelf) {
-                    look->addSelfWeights(charStr.substr(startPos,finPos-startPos), scores, 0);
-                    look->addSelfWeights(typeStr.substr(startPos,finPos-startPos), scores, 1);
-                    look->addTagDictWeights(getDictionaryMatches(charStr.substr(startPos,finPos-startPos), 0), scores);
+                    KinkakuStringView charWord = KinkakuStringView(charStr).substr(startPos,finPos-startPos);
+                    look->addSelfWeights(charWord, scores, 0);
+                    look->addSelfWeights(KinkakuStringView(typeStr).substr(startPos,finPos-startPos), scores, 1);
+                    getDictionaryMatches(charWord, 0, userDict, context.tagDictMatches);
+                    look->addTagDictWeights(context.tagDictMatches, scores);
                 }
                 for(int j = 0; j < (int)scores.size(); j++) 
                     scores[j] += look->getBias(j);
@@ -956,7 +1281,7 @@ void Kinkaku::calculateTags(KinkakuSentence & sent, int lev) {
                     scores.push_back(KinkakuModel::isProbabilistic(config_->getSolverType())?-1*scores[0]:0);
                 word.clearTags(lev);
                 for(int i = 0; i < (int)scores.size(); i++)
-                    word.addTag(lev, KinkakuTag((*tags)[i],scores[i]*tagMod->getMultiplier()));
+                    word.addTag(lev, KinkakuTag(tags[i],scores[i]*tagMod->getMultiplier()));
                 sort(word.tags[lev].begin(), word.tags[lev].end(), kinkakuTagMore);
                 if(KinkakuModel::isProbabilistic(config_->getSolverType())) {
                     double sum = 0;
@@ -974,6 +1299,8 @@ void Kinkaku::calculateTags(KinkakuSentence & sent, int lev) {
                 }
             }
         }
+        if(modelSlot != ModelTagEntry::NO_MODEL_SLOT)
+            localMods_->release(modelSlot);
         if(!word.hasTag(lev) && defTag.length())
             word.addTag(lev,KinkakuTag(util_->mapString(defTag),0));
         if(config_->getTagMax() > 0)
@@ -1035,6 +1362,8 @@ void Kinkaku::analyze() {
         throw std::runtime_error("A model file must be specified to run Kinkaku (-model)");
     
     readModel(config_->getModelFile().c_str());
+    if(config_->getUserDictionaryFiles().size() > 0)
+        readUserDictionary(config_->getUserDictionaryFiles(), config_->getUserDictionaryId());
     if(!config_->getDoWS() && !config_->getDoTags()) {
         buff << "Both word segmentation and tagging are disabled." << std::endl
              << "At least one must be selected to perform processing." << std::endl;
@@ -1079,16 +1408,11 @@ void Kinkaku::analyze() {
     for(int i = 0; i < config_->getNumTags(); i++)
         out->setDoTag(i,config_->getDoTag(i));
 
+    KinkakuAnalysisContext context;
     KinkakuSentence* next;
-    while((next = in->readSentence()) != 0) {
-        if(config_->getDoWS())
-            calculateWS(*next);
-        if(config_->getDoTags())
-            for(int i = 0; i < config_->getNumTags(); i++)
-                if(config_->getDoTag(i))
-                    calculateTags(*next, i);
+    while((next = context.readSentence(*in)) != 0) {
+        analyzeSentence(*next, context);
         out->writeSentence(next);
-        delete next;
     }
 
     delete in;
@@ -1101,6 +1425,16 @@ void Kinkaku::analyze() {
 
 }
 
+void Kinkaku::analyzeSentence(KinkakuSentence & sent, KinkakuAnalysisContext & context) {
+    util_->getTypeIds(sent.norm, context.types);
+    if(config_->getDoWS())
+        calculateWSWithTypes(sent, userDict_, context);
+    if(config_->getDoTags())
+        for(int i = 0; i < config_->getNumTags(); i++)
+            if(config_->getDoTag(i))
+                calculateTagsWithTypes(sent, i, userDict_, context);
+}
+
 void Kinkaku::checkEqual(const Kinkaku & rhs) {
     checkPointerEqual(util_, rhs.util_);
     checkPointerEqual(dict_, rhs.dict_);
@@ -1113,16 +1447,12 @@ void Kinkaku::checkEqual(const Kinkaku & rhs) {
 }
 
 Kinkaku::~Kinkaku() {
-    if(dict_) delete dict_;
-    if(subwordDict_) delete subwordDict_;
-    if(wsModel_) delete wsModel_;
+    clearModel();
+    if(userDict_) delete userDict_;
+    for(map<string, Dictionary<ModelTagEntry>*>::iterator it = namedUserDicts_.begin(); it != namedUserDicts_.end(); it++)
+        delete it->second;
     if(config_) delete config_;
     if(fio_) delete fio_;
-    for(int i = 0; i < (int)subwordModels_.size(); i++) {
-        if(subwordModels_[i] != 0) delete subwordModels_[i];
-    }
-    for(int i = 0; i < (int)globalMods_.size(); i++)
-        if(globalMods_[i] != 0) delete globalMods_[i];
     for(Sentences::iterator it = sentences_.begin(); it != sentences_.end(); it++)
         delete *it;
     
@@ -1130,8 +1460,11 @@ Kinkaku::~Kinkaku() {
 void Kinkaku::init() { 
     util_ = config_->getStringUtil();
     dict_ = NULL;
+    userDict_ = NULL;
     wsModel_ = NULL;
     subwordDict_ = NULL;
+    localMods_ = NULL;
+    bundle_ = NULL;
     fio_ = new FeatureIO;
 }
 
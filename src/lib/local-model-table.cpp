@@ -0,0 +1,175 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku-util.h>
+#include <kinkaku/kinkaku-model.h>
+#include <kinkaku/feature-lookup.h>
+#include <kinkaku/local-model-table.h>
+#include <kinkaku/model-io-binary.h>
+#include <kinkaku/model-io-mapped.h>
+#include <kinkaku/model-io-compact.h>
+#include <kinkaku/mapped-file.h>
+#include <algorithm>
+
+using namespace std;
+using namespace kinkaku;
+
+LocalModelTable::LocalModelTable(StringUtil * util, MappedFile * file, char format) : 
+        util_(util), file_(file), format_(format), positions_(1, 0), models_(1, (KinkakuModel*)0), limit_(0), memory_(0) {
+    file_->addRef();
+    pthread_mutex_init(&mutex_, 0);
+}
+
+LocalModelTable::~LocalModelTable() {
+    for(unsigned i = 0; i < models_.size(); i++)
+        if(models_[i])
+            delete models_[i];
+    pthread_mutex_destroy(&mutex_);
+    file_->release();
+}
+
+unsigned LocalModelTable::addSlot(size_t pos) {
+    unsigned id = 0;
+    if(pos > positions_.back()) {
+        id = positions_.size();
+        positions_.push_back(pos);
+        models_.push_back(0);
+    } else if(pos != 0) {
+        vector<size_t>::const_iterator it = lower_bound(positions_.begin(), positions_.end(), pos);
+        if(it == positions_.end() || *it != pos)
+            THROW_ERROR("Local model at "<<pos<<" refers to a model that was not read");
+        id = it - positions_.begin();
+    }
+    slots_.push_back(id);
+    return slots_.size()-1;
+}
+
+KinkakuModel * LocalModelTable::readModel(unsigned slot) const {
+    pthread_mutex_lock(&mutex_);
+    KinkakuModel * ret;
+    try {
+        ret = decode(slots_[slot]);
+    } catch(...) {
+        pthread_mutex_unlock(&mutex_);
+        throw;
+    }
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
+
+// the file's reference count is shared, so this is only called under the lock
+KinkakuModel * LocalModelTable::decode(unsigned id) const {
+    if(id == 0)
+        return 0;
+    if(format_ == ModelIO::FORMAT_MAPPED) {
+        MappedModelIO io(util_, file_, positions_[id]);
+        return io.readModel();
+    } else if(format_ == ModelIO::FORMAT_COMPACT) {
+        CompactModelIO io(util_, file_, positions_[id]);
+        return io.readModel();
+    } else {
+        BinaryModelIO io(util_, file_, positions_[id]);
+        return io.readModel();
+    }
+}
+
+KinkakuModel * LocalModelTable::acquire(unsigned slot) {
+    unsigned id = slots_[slot];
+    if(id == 0)
+        return 0;
+    pthread_mutex_lock(&mutex_);
+    KinkakuModel * ret = models_[id];
+    try {
+        if(ret == 0) {
+            ret = models_[id] = decode(id);
+            LoadedModel & loaded = loaded_[id];
+            loaded.memory = sizeof(KinkakuModel) + (ret->getFeatureLookup() ? ret->getFeatureLookup()->getMemoryUsage() : 0);
+            loaded.use = uses_.insert(uses_.begin(), id);
+            memory_ += loaded.memory;
+        } else {
+            LoadedModel & loaded = loaded_[id];
+            uses_.splice(uses_.begin(), uses_, loaded.use);
+        }
+        loaded_[id].pins++;
+        evict();
+    } catch(...) {
+        pthread_mutex_unlock(&mutex_);
+        throw;
+    }
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
+
+void LocalModelTable::release(unsigned slot) {
+    unsigned id = slots_[slot];
+    if(id == 0)
+        return;
+    pthread_mutex_lock(&mutex_);
+    loaded_[id].pins--;
+    evict();
+    pthread_mutex_unlock(&mutex_);
+}
+
+// Remove the least recently used models that are not in use until the
+// limit is met
+void LocalModelTable::evict() {
+    if(limit_ == 0)
+        return;
+    UseList::iterator it = uses_.end();
+    while(memory_ > limit_ && it != uses_.begin()) {
+        unsigned id = *--it;
+        map<unsigned, LoadedModel>::iterator lit = loaded_.find(id);
+        if(lit->second.pins)
+            continue;
+        memory_ -= lit->second.memory;
+        delete models_[id];
+        models_[id] = 0;
+        it = uses_.erase(it);
+        loaded_.erase(lit);
+    }
+}
+
+void LocalModelTable::setMemoryLimit(size_t limit) {
+    pthread_mutex_lock(&mutex_);
+    limit_ = limit;
+    evict();
+    pthread_mutex_unlock(&mutex_);
+}
+
+size_t LocalModelTable::getMemoryUsage() {
+    pthread_mutex_lock(&mutex_);
+    size_t ret = memory_ + slots_.capacity()*sizeof(unsigned) + positions_.capacity()*sizeof(size_t) + models_.capacity()*sizeof(KinkakuModel*);
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
+
+unsigned LocalModelTable::getNumLoaded() {
+    pthread_mutex_lock(&mutex_);
+    unsigned ret = loaded_.size();
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
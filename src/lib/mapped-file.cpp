@@ -0,0 +1,150 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/mapped-file.h>
+#include <kinkaku/kinkaku-util.h>
+#include <cstring>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace kinkaku;
+
+MappedFile * MappedFile::open(const string & file) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if(fd < 0)
+        THROW_ERROR("Could not open file for mapping: "<<file);
+    struct stat st;
+    void * mapped = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+        mapped = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        THROW_ERROR("Could not map file: "<<file);
+    MappedFile * ret = new MappedFile;
+    ret->data_ = (char*)mapped;
+    ret->size_ = st.st_size;
+    ret->mapped_ = true;
+    return ret;
+}
+
+MappedFile * MappedFile::read(istream & in) {
+    ostringstream oss;
+    oss << in.rdbuf();
+    string str = oss.str();
+    MappedFile * ret = new MappedFile;
+    // new[] memory is aligned well enough for any array in the file
+    ret->data_ = new char[str.length()+1];
+    memcpy(ret->data_, str.data(), str.length());
+    ret->size_ = str.length();
+    return ret;
+}
+
+// arenas smaller than a huge page just use the heap
+#define MAPPED_HUGE_PAGE_SIZE (2 << 20)
+
+MappedFile * MappedFile::allocate(size_t size, bool hugePages) {
+    MappedFile * ret = new MappedFile;
+    ret->arena_ = true;
+    if(hugePages && size >= MAPPED_HUGE_PAGE_SIZE) {
+        size_t len = (size + MAPPED_HUGE_PAGE_SIZE - 1) & ~((size_t)MAPPED_HUGE_PAGE_SIZE - 1);
+        void * mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        mem = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if(mem == MAP_FAILED) {
+            mem = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if(mem != MAP_FAILED)
+                madvise(mem, len, MADV_HUGEPAGE);
+#endif
+        }
+        if(mem != MAP_FAILED) {
+            ret->data_ = (char*)mem;
+            ret->size_ = len;
+            ret->mapped_ = true;
+            return ret;
+        }
+    }
+    ret->data_ = new char[size ? size : 1];
+    ret->size_ = size;
+    return ret;
+}
+
+// blocks larger than this are allocated alone rather than leaving much
+// of a chunk unused
+#define MAPPED_ARENA_MAX_BLOCK (MAPPED_HUGE_PAGE_SIZE/4)
+
+MappedArena::MappedArena(bool hugePages) : chunk_(0), used_(0), hugePages_(hugePages), count_(1) {
+    pthread_mutex_init(&mutex_, 0);
+}
+
+MappedArena::~MappedArena() {
+    if(chunk_)
+        chunk_->release();
+    pthread_mutex_destroy(&mutex_);
+}
+
+char * MappedArena::take(size_t size, MappedFile * & chunk) {
+    if(size > MAPPED_ARENA_MAX_BLOCK) {
+        chunk = MappedFile::allocate(size, hugePages_);
+        return const_cast<char*>(chunk->getData());
+    }
+    pthread_mutex_lock(&mutex_);
+    try {
+        if(chunk_ == 0 || used_ + size > chunk_->getSize()) {
+            if(chunk_)
+                chunk_->release();
+            chunk_ = 0;
+            chunk_ = MappedFile::allocate(MAPPED_HUGE_PAGE_SIZE, hugePages_);
+            used_ = 0;
+        }
+    } catch(...) {
+        pthread_mutex_unlock(&mutex_);
+        throw;
+    }
+    char * ret = const_cast<char*>(chunk_->getData()) + used_;
+    used_ = (used_ + size + 7) & ~((size_t)7);
+    chunk = chunk_;
+    chunk->addRef();
+    pthread_mutex_unlock(&mutex_);
+    return ret;
+}
+
+MappedFile::~MappedFile() {
+    if(mapped_)
+        munmap(data_, size_);
+    else
+        delete [] data_;
+    pthread_mutex_destroy(&mutex_);
+}
+
+void MappedFileBuf::throwTruncated() {
+    THROW_ERROR("Mapped file is truncated");
+}
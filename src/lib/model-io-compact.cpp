@@ -0,0 +1,277 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/kinkaku-util.h>
+#include <kinkaku/kinkaku-lm.h>
+#include <kinkaku/kinkaku-string.h>
+#include <kinkaku/model-io-compact.h>
+#include <kinkaku/local-model-table.h>
+#include <algorithm>
+#include <set>
+#include <cmath>
+
+// a language model value that is not in the model
+#define LM_MISSING 0xffff
+
+using namespace std;
+
+namespace kinkaku {
+
+void CompactModelIO::writeConfig(const KinkakuConfig & config) {
+    *str_ << "Kinkaku " << MODEL_IO_VERSION << " C " << config.getEncodingString() << endl;
+    writeConfigValues(config);
+    writeSectionTable();
+}
+
+void CompactModelIO::writeKinkakuString(const KinkakuString & str) {
+    writeVarint(str.length());
+    for(unsigned i = 0; i < str.length(); i++)
+        writeVarint(str[i]);
+}
+
+KinkakuString CompactModelIO::readKinkakuString() {
+    KinkakuString ret(readVarint());
+    for(unsigned i = 0; i < ret.length(); i++)
+        ret[i] = readVarint();
+    return ret;
+}
+
+// Weights are written as their difference from the smallest, packed
+// into as few bits as the largest difference needs
+void CompactModelIO::writeFeatVec(const FeatVec * vec) {
+    unsigned size = (vec ? vec->size() : 0);
+    writeVarint(size);
+    if(!size)
+        return;
+#if DISABLE_QUANTIZE
+    str_->write(reinterpret_cast<const char *>(vec->data()), size*sizeof(FeatVal));
+#else
+    const FeatVal * data = vec->data();
+    int min = *min_element(data, data+size), max = *max_element(data, data+size);
+    unsigned bits = 0;
+    while(bits < 32 && ((unsigned)(max-min) >> bits) != 0)
+        bits++;
+    writeSigned(min);
+    writeBinary((unsigned char)bits);
+    uint64_t acc = 0;
+    unsigned accBits = 0;
+    for(unsigned i = 0; i < size; i++) {
+        acc |= (uint64_t)(unsigned)(data[i]-min) << accBits;
+        accBits += bits;
+        while(accBits >= 8) {
+            str_->put((char)acc);
+            acc >>= 8;
+            accBits -= 8;
+        }
+    }
+    if(accBits)
+        str_->put((char)acc);
+#endif
+}
+
+void CompactModelIO::readFeatVals(FeatVal * data, unsigned size) {
+    if(!size)
+        return;
+#if DISABLE_QUANTIZE
+    memcpy(data, buf_->take(size*sizeof(FeatVal)), size*sizeof(FeatVal));
+#else
+    int min = readSigned();
+    unsigned bits = readBinary<unsigned char>();
+    if(bits > 16)
+        THROW_ERROR("Compact model has a corrupted feature vector");
+    const unsigned char * packed = (const unsigned char *)buf_->take(((uint64_t)size*bits+7)/8);
+    if(bits == 0) {
+        fill(data, data+size, (FeatVal)min);
+        return;
+    }
+    uint32_t mask = (1u << bits) - 1, acc = 0;
+    unsigned accBits = 0;
+    for(unsigned i = 0; i < size; i++) {
+        while(accBits < bits) {
+            acc |= (uint32_t)*packed++ << accBits;
+            accBits += 8;
+        }
+        data[i] = (FeatVal)(min + (int)(acc & mask));
+        acc >>= bits;
+        accBits -= bits;
+    }
+#endif
+}
+
+FeatVec * CompactModelIO::readFeatVec() {
+    unsigned size = readVarint();
+    FeatVec * vec = new FeatVec(size);
+    try {
+        readFeatVals(vec->data(), size);
+    } catch(...) {
+        delete vec;
+        throw;
+    }
+    return vec;
+}
+
+void CompactModelIO::skipFeatVec() {
+    unsigned size = readVarint();
+    if(!size)
+        return;
+#if DISABLE_QUANTIZE
+    buf_->take(size*sizeof(FeatVal));
+#else
+    readSigned();
+    unsigned bits = readBinary<unsigned char>();
+    buf_->take(((uint64_t)size*bits+7)/8);
+#endif
+}
+
+void CompactModelIO::readCompactEntries(Dictionary<FeatVec> * dict) {
+    unsigned size = readVarint();
+    vector<uint32_t> offsets(size+1, 0);
+    vector<FeatVal> pool;
+    for(unsigned i = 0; i < size; i++) {
+        unsigned mySize = readVarint();
+        offsets[i+1] = offsets[i] + mySize;
+        pool.resize(offsets[i+1]);
+        readFeatVals((mySize ? &pool[offsets[i]] : 0), mySize);
+    }
+    setEntryPool(dict, offsets, pool);
+}
+
+void CompactModelIO::skipVectorDictionary() {
+    readBinary<unsigned char>();
+    unsigned numStates = readVarint();
+    for(unsigned i = 0; i < numStates; i++) {
+        uint64_t head = readVarint();
+        readVarint();
+        if(head & 1)
+            readVarint();
+        for(uint64_t j = 0; j < (head >> 1)*2; j++)
+            readVarint();
+    }
+    if(numStates == 0)
+        return;
+    unsigned numEntries = readVarint();
+    for(unsigned i = 0; i < numEntries; i++)
+        skipFeatVec();
+}
+
+LocalModelTable * CompactModelIO::createLocalModels() {
+    return new LocalModelTable(util_, buf_->getFile(), FORMAT_COMPACT);
+}
+
+// Keys are written in order, each sharing a prefix with the one before,
+// and probabilities as 16 bit steps between the smallest and largest
+void CompactModelIO::writeLM(const KinkakuLM * lm) {
+
+    if(lm == 0) {
+        writeVarint(0);
+        return;
+    }
+
+    writeVarint(lm->n_);
+    writeVarint(lm->vocabSize_);
+
+    set<KinkakuString> keys;
+    double min = 0, max = 0;
+    bool first = true;
+    for(KinkakuDoubleMap::const_iterator it = lm->probs_.begin(); it != lm->probs_.end(); it++) {
+        keys.insert(it->first);
+        if(first || it->second < min) min = it->second;
+        if(first || it->second > max) max = it->second;
+        first = false;
+    }
+    for(KinkakuDoubleMap::const_iterator it = lm->fallbacks_.begin(); it != lm->fallbacks_.end(); it++) {
+        keys.insert(it->first);
+        if(first || it->second < min) min = it->second;
+        if(first || it->second > max) max = it->second;
+        first = false;
+    }
+    double step = (max-min)/(LM_MISSING-1);
+    writeBinary(min);
+    writeBinary(step);
+
+    writeVarint(keys.size());
+    const KinkakuString * last = 0;
+    for(set<KinkakuString>::const_iterator it = keys.begin(); it != keys.end(); it++) {
+        unsigned shared = 0;
+        if(last)
+            while(shared < last->length() && shared < it->length() && (*last)[shared] == (*it)[shared])
+                shared++;
+        writeVarint(shared);
+        writeVarint(it->length()-shared);
+        for(unsigned i = shared; i < it->length(); i++)
+            writeVarint((*it)[i]);
+        last = &*it;
+        KinkakuDoubleMap::const_iterator fit = lm->probs_.find(*it);
+        writeBinary((uint16_t)(fit == lm->probs_.end() ? LM_MISSING : (step ? floor((fit->second-min)/step+0.5) : 0)));
+        if(it->length() != lm->n_) {
+            fit = lm->fallbacks_.find(*it);
+            writeBinary((uint16_t)(fit == lm->fallbacks_.end() ? LM_MISSING : (step ? floor((fit->second-min)/step+0.5) : 0)));
+        }
+    }
+
+}
+
+KinkakuLM * CompactModelIO::readLM() {
+
+    unsigned n = readVarint();
+    if(!n)
+        return 0;
+
+    KinkakuLM * lm = new KinkakuLM(n);
+    lm->vocabSize_ = readVarint();
+    double min = readBinary<double>(), step = readBinary<double>();
+
+    unsigned entrysize = readVarint();
+    KinkakuString last;
+    const KinkakuString & prev = last;
+    while(entrysize-- != 0) {
+        unsigned shared = readVarint();
+        if(shared > prev.length()) {
+            delete lm;
+            THROW_ERROR("Compact model has a corrupted language model");
+        }
+        KinkakuString str(shared + readVarint());
+        for(unsigned i = 0; i < shared; i++)
+            str[i] = prev[i];
+        for(unsigned i = shared; i < str.length(); i++)
+            str[i] = readVarint();
+        unsigned code = readBinary<uint16_t>();
+        if(code != LM_MISSING)
+            lm->probs_.insert(pair<KinkakuString,double>(str, min+code*step));
+        if(str.length() != lm->n_) {
+            code = readBinary<uint16_t>();
+            if(code != LM_MISSING)
+                lm->fallbacks_.insert(pair<KinkakuString,double>(str, min+code*step));
+        }
+        last = str;
+    }
+
+    return lm;
+
+}
+
+}
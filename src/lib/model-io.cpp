@@ -35,6 +35,9 @@
 #include <kinkaku/model-io.h>
 #include <kinkaku/model-io-text.h>
 #include <kinkaku/model-io-binary.h>
+#include <kinkaku/model-io-mapped.h>
+#include <kinkaku/model-io-compact.h>
+#include <kinkaku/local-model-table.h>
 #include <algorithm>
 #include <cstring>
 #include <set>
@@ -43,6 +46,9 @@
 #define BUFFER_SIZE 4096
 #define NEG_INFINITY -999.0
 #define NULL_STRING "<NULL>"
+// written in place of the number of classes of a local model that is a
+// copy of one earlier in the file, followed by that model's position
+#define MODEL_REFERENCE -1
 
 using namespace std;
 
@@ -65,27 +71,46 @@ ModelIO * ModelIO::createIO(const char* file, Format form, bool output, KinkakuC
         istringstream iss(line);
         if(!(iss >> buff1) || !(iss >> buff2) || !(iss >> buff3) || !(iss >> buff4) || buff1 != "Kinkaku" || buff3.length() != 1)
             THROW_ERROR("Badly formed model (header incorrect)");
-        if(buff2 != MODEL_IO_VERSION)
-            THROW_ERROR("Incompatible model version. Expected " << MODEL_IO_VERSION << ", but found " << buff2 << ".");
         form = buff3[0];
+        if(form == ModelIO::FORMAT_MAPPED) {
+            if(buff2 != MODEL_IO_VERSION_MAPPED && buff2 != MODEL_IO_VERSION_MAPPED_2_1 && buff2 != MODEL_IO_VERSION_MAPPED_2_0)
+                THROW_ERROR("Incompatible model version. Expected " << MODEL_IO_VERSION_MAPPED << ", but found " << buff2 << ".");
+        } else if(buff2 != MODEL_IO_VERSION && buff2 != MODEL_IO_VERSION_1_2 && buff2 != MODEL_IO_VERSION_1_1 && buff2 != MODEL_IO_VERSION_1_0)
+            THROW_ERROR("Incompatible model version. Expected " << MODEL_IO_VERSION << ", but found " << buff2 << ".");
         config.setEncoding(buff4.c_str());
         ifs.close();
     }
     StringUtil * util = config.getStringUtil();
-    if(form == ModelIO::FORMAT_TEXT)      { return new TextModelIO(util,file,output); }
-    else if(form == ModelIO::FORMAT_BINARY) { return new BinaryModelIO(util,file,output); }
+    ModelIO * ret;
+    if(form == ModelIO::FORMAT_TEXT)      { ret = new TextModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_BINARY) { ret = new BinaryModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_MAPPED) { ret = new MappedModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_COMPACT) { ret = new CompactModelIO(util,file,output); }
     else {
         THROW_ERROR("Illegal model format");
     }
+    ret->setHugePages(config.getHugePages());
+    return ret;
 }
 
 ModelIO * ModelIO::createIO(iostream & file, Format form, bool output, KinkakuConfig & config) {
     StringUtil * util = config.getStringUtil();
-    if(form == ModelIO::FORMAT_TEXT)      { return new TextModelIO(util,file,output); }
-    else if(form == ModelIO::FORMAT_BINARY) { return new BinaryModelIO(util,file,output); }
+    ModelIO * ret;
+    if(form == ModelIO::FORMAT_TEXT)      { ret = new TextModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_BINARY) { ret = new BinaryModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_MAPPED) { ret = new MappedModelIO(util,file,output); }
+    else if(form == ModelIO::FORMAT_COMPACT) { ret = new CompactModelIO(util,file,output); }
     else {
         THROW_ERROR("Illegal model format");
     }
+    ret->setHugePages(config.getHugePages());
+    return ret;
+}
+
+const KinkakuModel * ModelIO::getEntryModel(const ModelTagEntry * entry, int lev, KinkakuModel * & decoded) {
+    if(entry->modelSlot != ModelTagEntry::NO_MODEL_SLOT && localSource_)
+        return (decoded = localSource_->readModel(entry->modelSlot+lev));
+    return ((int)entry->tagMods.size() > lev ? entry->tagMods[lev] : 0);
 }
 
 void TextModelIO::writeConfig(const KinkakuConfig & config) {
@@ -372,7 +397,7 @@ KinkakuLM * TextModelIO::readLM() {
 }
 
 
-void TextModelIO::writeFeatVec(const vector<FeatVal> * entry) {
+void TextModelIO::writeFeatVec(const FeatVec * entry) {
     int mySize = (int)(entry ? entry->size() : 0);
     for(int j = 0; j < mySize; j++) {
         if(j!=0) *str_ << " ";
@@ -382,7 +407,7 @@ void TextModelIO::writeFeatVec(const vector<FeatVal> * entry) {
 }
 
 template <>
-void TextModelIO::writeEntry(const vector<FeatVal> * entry) {
+void TextModelIO::writeEntry(const FeatVec * entry) {
     writeFeatVec(entry);
 }
 
@@ -412,7 +437,9 @@ void TextModelIO::writeEntry(const ModelTagEntry * entry) {
     }
     *str_ << endl;
     for(int i = 0; i < numTags_; i++) {
-        writeModel((int)entry->tagMods.size() > i?entry->tagMods[i]:0);
+        KinkakuModel * decoded = 0;
+        writeModel(getEntryModel(entry, i, decoded));
+        if(decoded) delete decoded;
     }
 }
 
@@ -437,34 +464,34 @@ void TextModelIO::writeEntry(const ProbTagEntry * entry) {
     }
 }
 
-void BinaryModelIO::writeFeatVec(const vector<FeatVal> * entry) {
+void BinaryModelIO::writeFeatVec(const FeatVec * entry) {
     int mySize = (int)(entry ? entry->size() : 0);
     writeBinary((uint32_t)mySize);
-    for(int j = 0; j < mySize; j++)
-        writeBinary((FeatVal)(*entry)[j]);
+    if(mySize)
+        str_->write(reinterpret_cast<const char *>(entry->data()), mySize*sizeof(FeatVal));
 }
 
 template <>
-void BinaryModelIO::writeEntry(const vector<FeatVal> * entry) {
+void BinaryModelIO::writeEntry(const FeatVec * entry) {
     writeFeatVec(entry);
 }
 
 template <>
 void BinaryModelIO::writeEntry(const ProbTagEntry * entry) {
-    writeString(entry->word);
+    writeKinkakuString(entry->word);
     for(int i = 0; i < numTags_; i++) {
         int mySize = (int)entry->tags.size() > i ? entry->tags[i].size() : 0;
         writeBinary((uint32_t)mySize);
         for(int j = 0; j < mySize; j++) {
-            writeString(entry->tags[i][j]);
+            writeKinkakuString(entry->tags[i][j]);
             writeBinary((double)entry->probs[i][j]);
         }
     }
 }
 
-vector<FeatVal>* TextModelIO::readFeatVec() {
+FeatVec* TextModelIO::readFeatVec() {
     string line, buff;
-    vector<FeatVal> * entry = new vector<FeatVal>;
+    FeatVec * entry = new FeatVec;
     getline(*str_, line);
     istringstream iss(line);
     while(iss >> buff)
@@ -473,7 +500,7 @@ vector<FeatVal>* TextModelIO::readFeatVec() {
 }
 
 template <>
-vector<FeatVal>* TextModelIO::readEntry<vector<FeatVal> >() {
+FeatVec* TextModelIO::readEntry<FeatVec>() {
     return readFeatVec();
 }
 
@@ -501,6 +528,10 @@ ModelTagEntry* TextModelIO::readEntry<ModelTagEntry>() {
         entry->tagMods[i] = readModel();
         if(entry->tagMods[i] && entry->tagMods[i]->getNumClasses() > entry->tags[i].size())
             THROW_ERROR("Model classes > tag classes ("<<entry->tagMods[i]->getNumClasses()<<", "<<entry->tags[i].size()<<") @ "<<util_->showString(entry->word));
+        if(!readLocalModels_ && entry->tagMods[i]) {
+            delete entry->tagMods[i];
+            entry->tagMods[i] = 0;
+        }
     }
     return entry;
 }
@@ -529,9 +560,101 @@ ProbTagEntry* TextModelIO::readEntry<ProbTagEntry>() {
 }
 
 
+BinaryModelIO::BinaryModelIO(StringUtil* util, const char* file, bool out) : ModelIO(util), buf_(0), localMods_(0), arena_(0), tablePos_(0), numMarked_(0) {
+    if(out)
+        openFile(file, out, true);
+    else
+        openMapped(MappedFile::open(file));
+}
+
+// streams are read into memory, so that arrays and local models can be
+// used from there
+BinaryModelIO::BinaryModelIO(StringUtil* util, iostream & str, bool out) : ModelIO(util), buf_(0), localMods_(0), arena_(0), tablePos_(0), numMarked_(0) {
+    if(out)
+        setStream(str, out, true);
+    else
+        openMapped(MappedFile::read(str));
+}
+
+BinaryModelIO::BinaryModelIO(StringUtil* util, MappedFile * file, size_t pos) : ModelIO(util), buf_(0), localMods_(0), arena_(0), tablePos_(0), numMarked_(0) {
+    file->addRef();
+    openMapped(file);
+    buf_->take(pos);
+}
+
+BinaryModelIO::~BinaryModelIO() {
+    if(localMods_)
+        delete localMods_;
+    if(arena_)
+        arena_->release();
+    // the stream reads from the buffer, so goes first
+    if(str_ && owns_)
+        delete str_;
+    str_ = 0;
+    if(buf_)
+        delete buf_;
+}
+
+void BinaryModelIO::openMapped(MappedFile * file) {
+    buf_ = new MappedFileBuf(file);
+    file->release();
+    setStream(*new iostream(buf_), false, true);
+    owns_ = true;
+}
+
+KinkakuString BinaryModelIO::readKinkakuString() {
+    if(!buf_)
+        return GeneralIO::readKinkakuString();
+    unsigned len = readBinary<uint32_t>();
+    KinkakuString ret(len);
+    if(len)
+        memcpy(&ret[0], buf_->take(len*sizeof(KinkakuChar)), len*sizeof(KinkakuChar));
+    return ret;
+}
+
 void BinaryModelIO::writeConfig(const KinkakuConfig & config) {
     *str_ << "Kinkaku " << MODEL_IO_VERSION << " B " << config.getEncodingString() << endl;
+    writeConfigValues(config);
+    writeSectionTable();
+}
+
+void BinaryModelIO::writeSectionTable() {
+    unsigned num = ModelIO::getNumSections(numTags_);
+    tablePos_ = str_->tellp();
+    numMarked_ = 0;
+    writeBinary((uint32_t)num);
+    for(unsigned i = 0; i < num; i++)
+        writeBinary((uint64_t)0);
+}
+
+void BinaryModelIO::markSection() {
+    if(numMarked_ >= ModelIO::getNumSections(numTags_))
+        THROW_ERROR("More sections written than are in the table");
+    uint64_t pos = str_->tellp();
+    str_->seekp(tablePos_ + sizeof(uint32_t) + numMarked_++*sizeof(uint64_t));
+    writeBinary(pos);
+    str_->seekp(pos);
+}
+
+ModelIO * BinaryModelIO::openSection(unsigned i) {
+    if(i >= sections_.size() || sections_[i] == 0)
+        THROW_ERROR("Model has no section " << i);
+    BinaryModelIO * ret = createReader(sections_[i]);
+    ret->numTags_ = numTags_;
+    ret->setHugePages(hugePages_);
+    ret->setReadLocalModels(readLocalModels_);
+    if(arena_) {
+        arena_->addRef();
+        ret->arena_ = arena_;
+    }
+    return ret;
+}
 
+BinaryModelIO * BinaryModelIO::createReader(size_t pos) {
+    return new BinaryModelIO(util_, buf_->getFile(), pos);
+}
+
+void BinaryModelIO::writeConfigValues(const KinkakuConfig & config) {
     writeBinary(config.getDoWS());
     writeBinary(config.getDoTags());
     numTags_ = config.getNumTags();
@@ -551,8 +674,10 @@ void BinaryModelIO::writeConfig(const KinkakuConfig & config) {
 
 void BinaryModelIO::readConfig(KinkakuConfig & config) {
     
-    string line;
+    string line, buff, version;
     getline(*str_,line); 
+    istringstream iss(line);
+    iss >> buff >> version;
 
     config.setDoWS(readBinary<bool>() && config.getDoWS());
     config.setDoTags(readBinary<bool>() && config.getDoTags());
@@ -568,6 +693,18 @@ void BinaryModelIO::readConfig(KinkakuConfig & config) {
     config.setSolverType(readBinary<char>());
      
     config.getStringUtil()->unserialize(readString());
+
+    // the dictionaries of the whole model share one arena, which the
+    // sections are given when opened
+    if(arena_ == 0)
+        arena_ = new MappedArena(hugePages_);
+
+    sections_.clear();
+    if(version == MODEL_IO_VERSION || version == MODEL_IO_VERSION_MAPPED) {
+        sections_.resize(readBinary<uint32_t>());
+        for(unsigned i = 0; i < sections_.size(); i++)
+            sections_[i] = readBinary<uint64_t>();
+    }
     
 }
 
@@ -588,6 +725,54 @@ void BinaryModelIO::writeModel(const KinkakuModel * mod) {
 
 }
 
+string BinaryModelIO::localModelKey(const KinkakuModel * mod) {
+    stringstream key;
+    BinaryModelIO keyIO(util_, key, true);
+    keyIO.writeModel(mod);
+    return key.str();
+}
+
+// 64-bit FNV-1a, which leaves few enough collisions that comparing the
+// models that share a hash costs little
+inline uint64_t hashLocalModelKey(const std::string & key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned i = 0; i < key.length(); i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Local models that are the same as one written earlier refer to it
+void BinaryModelIO::writeLocalModel(const ModelTagEntry * entry, int lev) {
+    KinkakuModel * decoded = 0;
+    const KinkakuModel * mod = getEntryModel(entry, lev, decoded);
+    if(mod == 0 || mod->getNumClasses() < 2) {
+        writeModel(mod);
+    } else {
+        string key = localModelKey(mod);
+        vector<LocalModelCopy> & copies = localPositions_[hashLocalModelKey(key)];
+        // copies are compared by their binary form, as the bytes written
+        // for them depend on the format and on where they are
+        unsigned i;
+        for(i = 0; i < copies.size(); i++) {
+            KinkakuModel * copyDecoded = 0;
+            bool same = (localModelKey(getEntryModel(copies[i].entry, copies[i].lev, copyDecoded)) == key);
+            if(copyDecoded) delete copyDecoded;
+            if(same) break;
+        }
+        if(i < copies.size()) {
+            writeBinary((int32_t)MODEL_REFERENCE);
+            writeBinary(copies[i].pos);
+        } else {
+            LocalModelCopy copy = { (uint64_t)str_->tellp(), entry, lev };
+            copies.push_back(copy);
+            writeModel(mod);
+        }
+    }
+    if(decoded) delete decoded;
+}
+
 void BinaryModelIO::writeLM(const KinkakuLM * lm) {
     
     if(lm == 0) { 
@@ -606,7 +791,7 @@ void BinaryModelIO::writeLM(const KinkakuLM * lm) {
 
     writeBinary((uint32_t)keys.size());
     for(set<KinkakuString>::const_iterator it = keys.begin(); it != keys.end(); it++) {
-        writeString(*it);
+        writeKinkakuString(*it);
         KinkakuDoubleMap::const_iterator fit = const_cast<KinkakuLM*>(lm)->probs_.find(*it);
         writeBinary(fit == lm->probs_.end() ? NEG_INFINITY : fit->second); 
         fit = const_cast<KinkakuLM*>(lm)->fallbacks_.find(*it);
@@ -620,6 +805,15 @@ KinkakuModel * BinaryModelIO::readModel() {
 
     int numC = readBinary<int32_t>();
     if(numC == 0) return NULL;
+    if(numC == MODEL_REFERENCE) {
+        if(!buf_)
+            THROW_ERROR("Local models that refer to others can only be read from files");
+        size_t pos = readBinary<uint64_t>(), next = buf_->tell();
+        buf_->seek(pos);
+        KinkakuModel * mod = readModel();
+        buf_->seek(next);
+        return mod;
+    }
     KinkakuModel * mod = new KinkakuModel();
     mod->setAddFeatures(false);
     mod->setNumClasses(numC);
@@ -662,33 +856,57 @@ KinkakuLM* BinaryModelIO::readLM() {
 
 template <>
 void BinaryModelIO::writeEntry(const ModelTagEntry * entry) {
-    writeString(entry->word);
+    writeKinkakuString(entry->word);
     for(int i = 0; i < numTags_; i++) {
         int mySize = (int)entry->tags.size() > i ? entry->tags[i].size() : 0;
         writeBinary((uint32_t)mySize);
         for(int j = 0; j < mySize; j++) {
-            writeString(entry->tags[i][j]);
+            writeKinkakuString(entry->tags[i][j]);
             writeBinary((unsigned char)entry->tagInDicts[i][j]);
         }
     }
     writeBinary((unsigned char)entry->inDict);
     for(int i = 0; i < numTags_; i++)
-        writeModel((int)entry->tagMods.size() > i ? entry->tagMods[i] : 0);
+        writeLocalModel(entry, i);
 }
 
-vector<FeatVal>* BinaryModelIO::readFeatVec() {
-    int mySize = readBinary<uint32_t>();
-    vector<FeatVal> * entry = new vector<FeatVal>;
-    for(int i = 0; i < mySize; i++)
-        entry->push_back(readBinary<FeatVal>());
+FeatVec* BinaryModelIO::readFeatVec() {
+    unsigned mySize = readBinary<uint32_t>();
+    FeatVec * entry = new FeatVec(mySize);
+    readBinaryArray(entry->data(), mySize);
     return entry;
 }
 
 template <>
-vector<FeatVal>* BinaryModelIO::readEntry<vector<FeatVal> >() {
+FeatVec* BinaryModelIO::readEntry<FeatVec>() {
     return readFeatVec();
 }
 
+void BinaryModelIO::readEntries(Dictionary<FeatVec> * dict) {
+    unsigned size = readBinary<uint32_t>();
+    vector<uint32_t> offsets(size+1, 0);
+    vector<FeatVal> pool;
+    for(unsigned i = 0; i < size; i++) {
+        unsigned mySize = readBinary<uint32_t>();
+        offsets[i+1] = offsets[i] + mySize;
+        pool.resize(offsets[i+1]);
+        readBinaryArray((mySize ? &pool[offsets[i]] : 0), mySize);
+    }
+    setEntryPool(dict, offsets, pool);
+}
+
+void BinaryModelIO::setEntryPool(Dictionary<FeatVec> * dict, const vector<uint32_t> & offsets, const vector<FeatVal> & pool) {
+    unsigned size = offsets.size()-1;
+    FeatVal * data = (FeatVal *)dict->packArrays(pool.size()*sizeof(FeatVal), arena_, hugePages_);
+    if(pool.size())
+        memcpy(data, &pool[0], pool.size()*sizeof(FeatVal));
+    FeatVec * block = new FeatVec[size];
+    for(unsigned i = 0; i < size; i++)
+        if(offsets[i+1] != offsets[i])
+            FeatVec(data+offsets[i], offsets[i+1]-offsets[i]).swap(block[i]);
+    dict->setEntryBlock(block, size);
+}
+
 template <>
 ModelTagEntry* BinaryModelIO::readEntry<ModelTagEntry>() {
     ModelTagEntry* entry = new ModelTagEntry(readKinkakuString());
@@ -703,11 +921,83 @@ ModelTagEntry* BinaryModelIO::readEntry<ModelTagEntry>() {
         }
     }
     entry->inDict = readBinary<unsigned char>();
-    for(int i = 0; i < numTags_; i++)
-        entry->tagMods[i] = readModel();
+    if(!buf_) {
+        for(int i = 0; i < numTags_; i++)
+            entry->tagMods[i] = readModel();
+        return entry;
+    }
+    // only the position of each model is kept until it is first used
+    vector<size_t> positions(numTags_, 0);
+    bool hasModel = false;
+    for(int i = 0; i < numTags_; i++) {
+        positions[i] = skipModel();
+        if(positions[i])
+            hasModel = true;
+    }
+    entry->tagMods.clear();
+    if(hasModel && readLocalModels_) {
+        if(!localMods_)
+            localMods_ = createLocalModels();
+        entry->modelSlot = localMods_->getNumSlots();
+        for(int i = 0; i < numTags_; i++)
+            localMods_->addSlot(positions[i]);
+    }
     return entry;
 }
 
+LocalModelTable * BinaryModelIO::createLocalModels() {
+    return new LocalModelTable(util_, buf_->getFile(), FORMAT_BINARY);
+}
+
+LocalModelTable * BinaryModelIO::takeLocalModels() {
+    LocalModelTable * ret = localMods_;
+    localMods_ = 0;
+    return ret;
+}
+
+// Skip a model written by writeLocalModel, returning its position (or
+// that of the model it refers to), or 0 if it is empty
+size_t BinaryModelIO::skipModel() {
+    size_t pos = buf_->tell();
+    int numC = readBinary<int32_t>();
+    if(numC == 0)
+        return 0;
+    if(numC == MODEL_REFERENCE)
+        return readBinary<uint64_t>();
+    buf_->take(sizeof(char) + numC*sizeof(int32_t) + sizeof(bool) + sizeof(double));
+    skipFeatureLookup();
+    return pos;
+}
+
+void BinaryModelIO::skipFeatureLookup() {
+    if(!readBinary<char>())
+        return;
+    for(int i = 0; i < 3; i++)
+        skipVectorDictionary();
+    for(int i = 0; i < 4; i++)
+        skipFeatVec();
+}
+
+void BinaryModelIO::skipVectorDictionary() {
+    readBinary<unsigned char>();
+    unsigned numStates = readBinary<uint32_t>();
+    if(numStates == 0)
+        return;
+    for(unsigned i = 0; i < numStates; i++) {
+        readBinary<uint32_t>();
+        buf_->take(readBinary<uint32_t>()*(sizeof(KinkakuChar)+sizeof(uint32_t)));
+        buf_->take(readBinary<uint32_t>()*sizeof(uint32_t));
+        buf_->take(sizeof(bool));
+    }
+    unsigned numEntries = readBinary<uint32_t>();
+    for(unsigned i = 0; i < numEntries; i++)
+        skipFeatVec();
+}
+
+void BinaryModelIO::skipFeatVec() {
+    buf_->take(readBinary<uint32_t>()*sizeof(FeatVal));
+}
+
 template <>
 ProbTagEntry* BinaryModelIO::readEntry<ProbTagEntry>() {
     ProbTagEntry* entry = new ProbTagEntry(readKinkakuString());
@@ -735,7 +1025,7 @@ void TextModelIO::writeWordList(const std::vector<KinkakuString> & list) {
 void BinaryModelIO::writeWordList(const std::vector<KinkakuString> & list) {
     writeBinary((uint32_t)list.size());
     for(unsigned i = 0; i < list.size(); i++)
-        writeString(list[i]);
+        writeKinkakuString(list[i]);
 }
 
 vector<KinkakuString> TextModelIO::readWordList() {
@@ -819,4 +1109,111 @@ FeatureLookup * BinaryModelIO::readFeatureLookup() {
     return look;
 }
 
-}
\ No newline at end of file
+// Check that mapped models are only used on machines that lay out the
+// arrays in the same way
+#define MAPPED_MODEL_BOM 0x01020304
+
+void MappedModelIO::writeArray(const void * data, size_t size) {
+    static const char zeros[8] = { 0 };
+    size_t pos = str_->tellp();
+    str_->write(zeros, ((pos + 7) & ~((size_t)7)) - pos);
+    if(size)
+        str_->write((const char *)data, size);
+}
+
+const char * MappedModelIO::readArray(size_t size) {
+    size_t pos = buf_->tell();
+    buf_->take(((pos + 7) & ~((size_t)7)) - pos);
+    return buf_->take(size);
+}
+
+void MappedModelIO::writeConfig(const KinkakuConfig & config) {
+    *str_ << "Kinkaku " << MODEL_IO_VERSION_MAPPED << " M " << config.getEncodingString() << endl;
+    writeConfigValues(config);
+    writeSectionTable();
+    writeBinary((uint32_t)MAPPED_MODEL_BOM);
+    writeBinary((uint32_t)sizeof(DictionaryState));
+    writeBinary((uint32_t)sizeof(pair<KinkakuChar,unsigned>));
+    writeBinary((uint32_t)sizeof(FeatVal));
+}
+
+void MappedModelIO::readConfig(KinkakuConfig & config) {
+    BinaryModelIO::readConfig(config);
+    if(readBinary<uint32_t>() != MAPPED_MODEL_BOM
+        || readBinary<uint32_t>() != sizeof(DictionaryState)
+        || readBinary<uint32_t>() != sizeof(pair<KinkakuChar,unsigned>)
+        || readBinary<uint32_t>() != sizeof(FeatVal))
+        THROW_ERROR("Mapped model was made on an incompatible platform");
+}
+
+void MappedModelIO::writeFeatVec(const FeatVec * vec) {
+    unsigned size = (vec ? vec->size() : 0);
+    writeBinary((uint32_t)size);
+    writeArray((size ? vec->data() : 0), size*sizeof(FeatVal));
+}
+
+FeatVec * MappedModelIO::readFeatVec() {
+    unsigned size = readBinary<uint32_t>();
+    const FeatVal * data = (const FeatVal *)readArray(size*sizeof(FeatVal));
+    return (size ? new FeatVec(data, size) : new FeatVec);
+}
+
+LocalModelTable * MappedModelIO::createLocalModels() {
+    return new LocalModelTable(util_, buf_->getFile(), FORMAT_MAPPED);
+}
+
+void MappedModelIO::skipVectorDictionary() {
+    readBinary<unsigned char>();
+    unsigned numStates = readBinary<uint32_t>();
+    if(numStates == 0)
+        return;
+    unsigned numGotos = readBinary<uint32_t>();
+    unsigned numDense = readBinary<uint32_t>();
+    readArray(numStates*sizeof(DictionaryState));
+    readArray(numGotos*sizeof(pair<KinkakuChar,unsigned>));
+    readArray(numDense*sizeof(unsigned));
+    unsigned size = readBinary<uint32_t>();
+    const uint32_t * offsets = (const uint32_t *)readArray((size+1)*sizeof(uint32_t));
+    readArray(offsets[size]*sizeof(FeatVal));
+}
+
+void MappedModelIO::skipFeatVec() {
+    readArray(readBinary<uint32_t>()*sizeof(FeatVal));
+}
+
+FeatureLookup * MappedModelIO::readFeatureLookup() {
+    FeatureLookup * look = BinaryModelIO::readFeatureLookup();
+    if(look)
+        look->setMappedFile(buf_->getFile());
+    return look;
+}
+
+// The weights of all entries are kept in one pool, with an offset table
+void MappedModelIO::writeMappedEntries(const vector<FeatVec*> & entries) {
+    vector<uint32_t> offsets(entries.size()+1, 0);
+    for(unsigned i = 0; i < entries.size(); i++)
+        offsets[i+1] = offsets[i] + entries[i]->size();
+    writeBinary((uint32_t)entries.size());
+    writeArray(&offsets[0], offsets.size()*sizeof(uint32_t));
+    vector<FeatVal> pool(offsets.back());
+    for(unsigned i = 0; i < entries.size(); i++)
+        copy(entries[i]->begin(), entries[i]->end(), pool.begin()+offsets[i]);
+    writeArray((pool.size() ? &pool[0] : 0), pool.size()*sizeof(FeatVal));
+}
+
+void MappedModelIO::readMappedEntries(Dictionary<FeatVec> * dict) {
+    unsigned size = readBinary<uint32_t>();
+    const uint32_t * offsets = (const uint32_t *)readArray((size+1)*sizeof(uint32_t));
+    const FeatVal * pool = (const FeatVal *)readArray(offsets[size]*sizeof(FeatVal));
+    FeatVec * block = new FeatVec[size];
+    for(unsigned i = 0; i < size; i++) {
+        if(offsets[i] > offsets[i+1]) {
+            delete [] block;
+            THROW_ERROR("Mapped model has a corrupted weight pool");
+        }
+        FeatVec(pool+offsets[i], offsets[i+1]-offsets[i]).swap(block[i]);
+    }
+    dict->setEntryBlock(block, size);
+}
+
+}
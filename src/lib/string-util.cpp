@@ -30,6 +30,7 @@
 #include <kinkaku/string-util-map-euc.h>
 #include <kinkaku/string-util-map-sjis.h>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 
@@ -62,12 +63,22 @@ double StringUtil::parseFloat(const char* str) {
     return ret;
 }
 
-StringUtilUtf8::StringUtilUtf8() {
+// the highest code point is 0x10FFFF
+#define UTF8_NUM_PAGES 0x1100
+#define CHAR_TABLE_SIZE ((size_t)std::numeric_limits<KinkakuChar>::max()+1)
+
+StringUtilUtf8::StringUtilUtf8() : idPages_(UTF8_NUM_PAGES, (KinkakuChar*)0) {
+    pthread_mutex_init(&charMutex_, 0);
+    charNames_.reserve(CHAR_TABLE_SIZE);
+    charTypes_.reserve(CHAR_TABLE_SIZE);
+    charTypeIds_.reserve(CHAR_TABLE_SIZE);
     const char * initial[7] = { "", "K", "T", "H", "R", "D", "O" };
     for(unsigned i = 0; i < 7; i++) {
         charIds_.insert(std::pair<std::string,KinkakuChar>(initial[i], i));
         charTypes_.push_back(i==0?6:4);
+        charTypeIds_.push_back(0);
         charNames_.push_back(initial[i]);
+        setCodePointId(initial[i], i);
     }
 }
 
@@ -117,6 +128,20 @@ GenericMap<KinkakuChar,KinkakuChar> * StringUtilEuc::getNormMap() {
 }
 
 KinkakuChar StringUtilUtf8::mapChar(const string & str, bool add) {
+    pthread_mutex_lock(&charMutex_);
+    KinkakuChar ret;
+    try {
+        ret = addChar(str, add);
+    } catch(...) {
+        pthread_mutex_unlock(&charMutex_);
+        throw;
+    }
+    pthread_mutex_unlock(&charMutex_);
+    return ret;
+}
+
+// Find or add str, which is only called under charMutex_
+KinkakuChar StringUtilUtf8::addChar(const string & str, bool add) {
     StringCharMap::iterator it = charIds_.find(str);
     KinkakuChar ret = 0;
     if(it != charIds_.end())
@@ -127,11 +152,55 @@ KinkakuChar StringUtilUtf8::mapChar(const string & str, bool add) {
         ret = charTypes_.size();
         charIds_.insert(pair<string, KinkakuChar>(str,ret));
         charTypes_.push_back(findType(str));
+        charTypeIds_.push_back(findTypeId(charTypes_.back()));
         charNames_.push_back(str);
+        // characters whose type is str could not be given a type id when
+        // they were added, so they are given it now
+        if(str.length() == 1)
+            for(unsigned i = 0; i < ret; i++)
+                if(charTypes_[i] == str[0] && charTypeIds_[i] == 0)
+                    __atomic_store_n(&charTypeIds_[i], ret, __ATOMIC_RELAXED);
+        setCodePointId(str, ret);
     }
     return ret;
 }
 
+// Publish the id of a single well-formed character by its code point,
+// once everything else about the character has been stored
+void StringUtilUtf8::setCodePointId(const string & str, KinkakuChar id) {
+    const unsigned char * s = (const unsigned char *)str.data();
+    unsigned val;
+    if(str.length() == 1 && s[0] < 0x80)
+        val = s[0];
+    else if(str.length() == 2 && (s[0] & 0xE0) == 0xC0)
+        val = ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    else if(str.length() == 3 && (s[0] & 0xF0) == 0xE0)
+        val = ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+    else if(str.length() == 4 && (s[0] & 0xF8) == 0xF0)
+        val = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+    else
+        return;
+    if(val >= UTF8_NUM_PAGES << 8)
+        return;
+    KinkakuChar * page = idPages_[val >> 8];
+    if(page == 0) {
+        page = new KinkakuChar[256]();
+        __atomic_store_n(&idPages_[val >> 8], page, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(page + (val & 0xFF), id, __ATOMIC_RELEASE);
+}
+
+void StringUtilUtf8::clearCodePoints() {
+    for(unsigned i = 0; i < idPages_.size(); i++)
+        if(idPages_[i])
+            delete [] idPages_[i];
+    idPages_.clear();
+}
+
+void StringUtilUtf8::throwBadUtf8(const string & str) {
+    THROW_ERROR("Expected UTF8 file but found non-UTF8 string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
+}
+
 string StringUtilUtf8::showChar(KinkakuChar c) {
 #ifdef KINKAKU_SAFE
     if(c >= charNames_.size())
@@ -144,38 +213,99 @@ StringUtil::CharType StringUtilUtf8::findType(KinkakuChar c) {
     return charTypes_[c];
 }
 
-KinkakuString StringUtilUtf8::mapString(const string & str) {
-    unsigned pos = 0, len = str.length();
-    vector<KinkakuChar> ret;
+void StringUtilUtf8::getTypeIds(const KinkakuString & str, KinkakuString & out) {
+    const unsigned len = str.length();
+    out.resize(len);
+    const KinkakuChar * in = str.data();
+    KinkakuChar * ids = out.data();
+    for(unsigned i = 0; i < len; i++) {
+        KinkakuChar id = __atomic_load_n(&charTypeIds_[in[i]], __ATOMIC_RELAXED);
+        // the type character has not been seen, and adding it fills in
+        // the type id of every character of that type
+        if(id == 0)
+            id = mapChar(string(1, charTypes_[in[i]]));
+        ids[i] = id;
+    }
+}
+
+#define UTF8_HIGH_BITS 0x8080808080808080ULL
+#define UTF8_LOW_BITS 0x0101010101010101ULL
+
+// Characters are counted first so the string is allocated once, then
+// decoded to code points and looked up in the page table, with only
+// characters that have not been seen yet going through mapChar. Both
+// passes take runs of ASCII eight bytes at a time. If norm is given, the
+// normalized ids are written in the same pass.
+void StringUtilUtf8::decodeString(const string & str, KinkakuString & ret, KinkakuString * norm) {
+    const KinkakuChar * table = (norm ? getNormTable() : 0);
+    const unsigned char * s = (const unsigned char *)str.data();
+    size_t len = str.length(), pos = 0, num = 0;
+    // every byte but those that continue a character (10xxxxxx) starts one
+    for(; pos + 8 <= len; pos += 8) {
+        uint64_t w;
+        memcpy(&w, s+pos, 8);
+        uint64_t cont = w & ~(w << 1) & UTF8_HIGH_BITS;
+        num += 8 - (size_t)(((cont >> 7) * UTF8_LOW_BITS) >> 56);
+    }
+    for(; pos < len; pos++)
+        num += ((s[pos] & 0xC0) != 0x80);
+    ret.resize(num);
+    if(norm) norm->resize(num);
+    if(num == 0)
+        return;
+    KinkakuChar * out = ret.data();
+    KinkakuChar * nout = (norm ? norm->data() : 0);
+    // the first page is always allocated
+    const KinkakuChar * ascii = __atomic_load_n(&idPages_[0], __ATOMIC_ACQUIRE);
+    pos = 0;
     while(pos < len) {
-        if(!(maskl1 & str[pos]))
-            ret.push_back(mapChar(str.substr(pos++, 1)));
-        else if((maskl5 & str[pos]) == maskl5) {
-            THROW_ERROR("Expected UTF8 file but found non-UTF8 string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
-        }
-        else if((maskl4 & str[pos]) == maskl4) {
-            if(pos + 3 >= len || badu(str[pos+1]) || badu(str[pos+2]) || badu(str[pos+3]))
-                THROW_ERROR("Expected UTF8 file but found non-UTF8 string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
-            ret.push_back(mapChar(str.substr(pos, 4)));
-            pos += 4;
-        }
-        else if((maskl3 & str[pos]) == maskl3) {
-            if(pos + 2 >= len || badu(str[pos+1]) || badu(str[pos+2]))
-                THROW_ERROR("Expected UTF8 file but found non-UTF8 string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
-            ret.push_back(mapChar(str.substr(pos, 3)));
-            pos += 3;
-        }
-        else {
-            if(pos + 1 >= len || badu(str[pos+1]))
-                THROW_ERROR("Expected UTF8 file but found non-UTF8 string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
-            ret.push_back(mapChar(str.substr(pos, 2)));
+        if(s[pos] < 0x80) {
+            if(pos + 8 <= len) {
+                uint64_t w;
+                memcpy(&w, s+pos, 8);
+                if(!(w & UTF8_HIGH_BITS)) {
+                    for(size_t end = pos + 8; pos < end; pos++) {
+                        *out = loadId(ascii + s[pos]);
+                        if(!*out) *out = mapChar(string(1, (char)s[pos]));
+                        if(nout) *nout++ = table[*out];
+                        out++;
+                    }
+                    continue;
+                }
+            }
+            *out = loadId(ascii + s[pos]);
+            if(!*out) *out = mapChar(string(1, (char)s[pos]));
+            pos++;
+        } else if(s[pos] < 0xC2) {
+            // a continuing byte, or the start of an overlong 2 byte form
+            throwBadUtf8(str);
+        } else if(s[pos] < 0xE0) {
+            if(pos + 1 >= len || badu(s[pos+1]))
+                throwBadUtf8(str);
+            *out = mapCodePoint(((s[pos] & 0x1F) << 6) | (s[pos+1] & 0x3F), str.data()+pos, 2);
             pos += 2;
+        } else if(s[pos] < 0xF0) {
+            if(pos + 2 >= len || badu(s[pos+1]) || badu(s[pos+2]))
+                throwBadUtf8(str);
+            unsigned val = ((s[pos] & 0x0F) << 12) | ((s[pos+1] & 0x3F) << 6) | (s[pos+2] & 0x3F);
+            if(val < 0x800)
+                throwBadUtf8(str);
+            *out = mapCodePoint(val, str.data()+pos, 3);
+            pos += 3;
+        } else if(s[pos] < 0xF5) {
+            if(pos + 3 >= len || badu(s[pos+1]) || badu(s[pos+2]) || badu(s[pos+3]))
+                throwBadUtf8(str);
+            unsigned val = ((s[pos] & 0x07) << 18) | ((s[pos+1] & 0x3F) << 12) | ((s[pos+2] & 0x3F) << 6) | (s[pos+3] & 0x3F);
+            if(val < 0x10000 || val >= UTF8_NUM_PAGES << 8)
+                throwBadUtf8(str);
+            *out = mapCodePoint(val, str.data()+pos, 4);
+            pos += 4;
+        } else {
+            throwBadUtf8(str);
         }
+        if(nout) *nout++ = table[*out];
+        out++;
     }
-    KinkakuString retstr(ret.size());
-    for(unsigned i = 0; i < ret.size(); i++)
-        retstr[i] = ret[i];
-    return retstr;
 }
 
 StringUtil::CharType StringUtilUtf8::findType(const string & str) {
@@ -216,7 +346,12 @@ StringUtil::CharType StringUtilUtf8::findType(const string & str) {
 
 
 void StringUtilUtf8::unserialize(const string & str) {
-    charIds_.clear(); charNames_.clear(); charTypes_.clear();
+    // this replaces every character, so it must not be used while other
+    // threads are using the util
+    charIds_.clear(); charNames_.clear(); charTypes_.clear(); charTypeIds_.clear();
+    clearCodePoints();
+    idPages_.resize(UTF8_NUM_PAGES, 0);
+    idPages_[0] = new KinkakuChar[256]();
     mapChar("");
     KinkakuString ret = mapString(str);
 }
@@ -276,21 +411,74 @@ string StringUtilEuc::showChar(KinkakuChar c) {
     }
 }
 
-KinkakuString StringUtilEuc::mapString(const string & str) {
-    unsigned pos = 0, len = str.length();
-    vector<KinkakuChar> ret;
+// The length of the characters starting with each byte in EUC and SJIS,
+// where the id of a character is its bytes read as a big-endian number
+struct DoubleByteTable {
+    unsigned char length[256];
+    // the bits that must be set in the second byte
+    unsigned char trailMask;
+    const char * name;
+    DoubleByteTable(bool sjis) : trailMask(sjis ? 0 : 0x80), name(sjis ? "SJIS" : "EUC") {
+        for(unsigned i = 0; i < 256; i++)
+            length[i] = ((i & 0x80) && !(sjis && i >= 0xA0 && i <= 0xDF)) ? 2 : 1;
+    }
+};
+
+static const DoubleByteTable EUC_TABLE(false), SJIS_TABLE(true);
+
+// Decode one pass over the bytes of str, with runs of ASCII taken eight
+// bytes at a time, writing normalized ids to norm if it is given
+static void decodeDoubleByte(const DoubleByteTable & bytes, const string & str, KinkakuString & ret, KinkakuString * norm, const KinkakuChar * table) {
+    const unsigned char * s = (const unsigned char *)str.data();
+    const size_t len = str.length();
+    // there are at most as many characters as bytes
+    ret.resize(len);
+    if(norm) norm->resize(len);
+    KinkakuChar * out = ret.data(), * start = out;
+    KinkakuChar * nout = (norm ? norm->data() : 0);
+    size_t pos = 0;
     while(pos < len) {
-        if(!(maskl1 & str[pos]))
-            ret.push_back(mapChar(str.substr(pos++, 1)));
-        else {
-            ret.push_back(mapChar(str.substr(pos,2)));
+        if(pos + 8 <= len) {
+            uint64_t w;
+            memcpy(&w, s+pos, 8);
+            if(!(w & UTF8_HIGH_BITS)) {
+                for(size_t end = pos + 8; pos < end; pos++) {
+                    *out = s[pos];
+                    if(nout) *nout++ = table[*out];
+                    out++;
+                }
+                continue;
+            }
+        }
+        if(bytes.length[s[pos]] == 1) {
+            *out = s[pos++];
+        } else if(pos + 1 < len) {
+#ifdef KINKAKU_SAFE
+            if((s[pos+1] & bytes.trailMask) != bytes.trailMask)
+                THROW_ERROR("Expected "<<bytes.name<<" file but found non-"<<bytes.name<<" string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
+#endif
+            *out = (s[pos] << 8) | s[pos+1];
             pos += 2;
+        } else {
+            // a truncated character at the end
+#ifdef KINKAKU_SAFE
+            THROW_ERROR("Expected "<<bytes.name<<" file but found non-"<<bytes.name<<" string (specify the proper encoding with -encode utf8/euc/sjis): "<<str);
+#endif
+            *out = s[pos++];
         }
+        if(nout) *nout++ = table[*out];
+        out++;
     }
-    KinkakuString retstr(ret.size());
-    for(unsigned i = 0; i < ret.size(); i++)
-        retstr[i] = ret[i];
-    return retstr;
+    ret.resize(out - start);
+    if(norm) norm->resize(out - start);
+}
+
+void StringUtilEuc::mapString(const string & str, KinkakuString & out) {
+    decodeDoubleByte(EUC_TABLE, str, out, 0, 0);
+}
+
+void StringUtilEuc::mapString(const string & str, KinkakuString & surface, KinkakuString & norm) {
+    decodeDoubleByte(EUC_TABLE, str, surface, &norm, getNormTable());
 }
 
 StringUtil::CharType StringUtilEuc::findType(const string & str) {
@@ -376,22 +564,12 @@ string StringUtilSjis::showChar(KinkakuChar c) {
     }
 }
 
-KinkakuString StringUtilSjis::mapString(const string & str) {
-    unsigned pos = 0, len = str.length();
-    vector<KinkakuChar> ret;
-    while(pos < len) {
-        const unsigned char first = (unsigned char)str[pos];
-        if(!(first & maskl1) || (first >= 0xA0 && first <= 0xDF))
-            ret.push_back(mapChar(str.substr(pos++, 1)));
-        else {
-            ret.push_back(mapChar(str.substr(pos,2)));
-            pos += 2;
-        }
-    }
-    KinkakuString retstr(ret.size());
-    for(unsigned i = 0; i < ret.size(); i++)
-        retstr[i] = ret[i];
-    return retstr;
+void StringUtilSjis::mapString(const string & str, KinkakuString & out) {
+    decodeDoubleByte(SJIS_TABLE, str, out, 0, 0);
+}
+
+void StringUtilSjis::mapString(const string & str, KinkakuString & surface, KinkakuString & norm) {
+    decodeDoubleByte(SJIS_TABLE, str, surface, &norm, getNormTable());
 }
 
 StringUtil::CharType StringUtilSjis::findType(const string & str) {
@@ -423,14 +601,53 @@ StringUtil::CharType StringUtilSjis::findType(KinkakuChar c) {
     return OTHER;
 }
 
-KinkakuString StringUtil::normalize(const KinkakuString & str) {
-    KinkakuString ret(str.length());
-    GenericMap<KinkakuChar,KinkakuChar> * normMap = getNormMap();
-    for(int i = 0; i < (int)str.length(); i++) {
-        GenericMap<KinkakuChar,KinkakuChar>::const_iterator it = normMap->find(str[i]);
-        ret[i] = (it == normMap->end()) ? str[i] : it->second;
+const KinkakuChar * StringUtil::buildNormTable() {
+    pthread_mutex_lock(&tableMutex_);
+    if(normTable_ == NULL) {
+        KinkakuChar * table = new KinkakuChar[CHAR_TABLE_SIZE];
+        for(size_t i = 0; i < CHAR_TABLE_SIZE; i++)
+            table[i] = i;
+        GenericMap<KinkakuChar,KinkakuChar> * normMap = getNormMap();
+        for(GenericMap<KinkakuChar,KinkakuChar>::const_iterator it = normMap->begin(); it != normMap->end(); it++)
+            table[it->first] = it->second;
+        __atomic_store_n(&normTable_, table, __ATOMIC_RELEASE);
     }
-    return ret;
+    pthread_mutex_unlock(&tableMutex_);
+    return normTable_;
+}
+
+const KinkakuChar * StringUtil::buildTypeTable() {
+    pthread_mutex_lock(&tableMutex_);
+    if(typeTable_ == NULL) {
+        KinkakuChar * table = new KinkakuChar[CHAR_TABLE_SIZE];
+        for(size_t i = 0; i < CHAR_TABLE_SIZE; i++)
+            table[i] = mapChar(string(1, findType((KinkakuChar)i)));
+        __atomic_store_n(&typeTable_, table, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&tableMutex_);
+    return typeTable_;
+}
+
+void StringUtil::getTypeIds(const KinkakuString & str, KinkakuString & ret) {
+    const unsigned len = str.length();
+    ret.resize(len);
+    const KinkakuChar * table = __atomic_load_n(&typeTable_, __ATOMIC_ACQUIRE);
+    if(table == NULL)
+        table = buildTypeTable();
+    const KinkakuChar * in = str.data();
+    KinkakuChar * out = ret.data();
+    for(unsigned i = 0; i < len; i++)
+        out[i] = table[in[i]];
+}
+
+void StringUtil::normalize(const KinkakuString & str, KinkakuString & ret) {
+    const unsigned len = str.length();
+    ret.resize(len);
+    const KinkakuChar * table = getNormTable();
+    const KinkakuChar * in = str.data();
+    KinkakuChar * out = ret.data();
+    for(unsigned i = 0; i < len; i++)
+        out[i] = table[in[i]];
 }
 
 StringUtil::Encoding StringUtilSjis::getEncoding() { return StringUtil::ENCODING_SJIS; } 
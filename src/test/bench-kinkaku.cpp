@@ -0,0 +1,347 @@
+/*
+** Kinkaku - Text Mining Analysis Tools
+**
+** Copyright (c) 2013, stnmrshx (stnmrshx@gmail.com)
+** All rights reserved.
+** Redistribution and use in source and binary forms, with or without modification, 
+** are permitted provided that the following conditions are met: 
+** 
+** 1. Redistributions of source code must retain the above copyright notice, this
+**    list of conditions and the following disclaimer. 
+** 2. Redistributions in binary form must reproduce the above copyright notice,
+**    this list of conditions and the following disclaimer in the documentation
+**    and/or other materials provided with the distribution. 
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+** ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+** WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+** DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+** ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+** (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+** LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+** ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**
+**/
+#include <kinkaku/dictionary.h>
+#include <kinkaku/feature-vector.h>
+#include <kinkaku/kinkaku-thread.h>
+#include <kinkaku/kinkaku-util.h>
+#include <kinkaku/kinkaku-config.h>
+#include <kinkaku/model-io-mapped.h>
+#include <kinkaku/local-model-table.h>
+#include <kinkaku/kinkaku-model.h>
+#include <kinkaku/kinkaku-lm.h>
+#include <kinkaku/feature-lookup.h>
+#include <kinkaku/string-util.h>
+#include <kinkaku/string-util-map-utf8.h>
+#include <kinkaku/string-util-map-euc.h>
+#include <kinkaku/string-util-map-sjis.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+
+using namespace std;
+using namespace kinkaku;
+
+// Micro-benchmarks for the analysis building blocks
+//  usage: bench-kinkaku [BENCHMARK [SIZE]]
+
+double getTime() {
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void report(const char * name, unsigned size, double secs) {
+    cout << name << "\t" << size << "\t" << secs << " s" << endl;
+}
+
+// Random words over a 3000 character alphabet, skewed towards the first
+// characters like real text
+vector<KinkakuString> makeWords(unsigned num, unsigned seed) {
+    srand(seed);
+    vector<KinkakuString> ret(num);
+    for(unsigned i = 0; i < num; i++) {
+        unsigned len = 1 + rand() % 8;
+        KinkakuString str(len);
+        for(unsigned j = 0; j < len; j++) {
+            unsigned r = rand() % 3000;
+            str[j] = 1 + (r * r) / 3000;
+        }
+        ret[i] = str;
+    }
+    return ret;
+}
+
+void fillEntries(Dictionary<FeatVec>::WordList & list) {
+    for(unsigned i = 0; i < list.size(); i++)
+        list[i].second = new FeatVec(1, 1);
+}
+
+void benchDictionary(unsigned size) {
+    vector<KinkakuString> words = makeWords(size, 1);
+    Dictionary<FeatVec>::WordMap wordMap;
+    Dictionary<FeatVec>::WordList wordList;
+    for(unsigned i = 0; i < words.size(); i++)
+        if(wordMap.insert(make_pair(words[i], (FeatVec*)0)).second)
+            wordList.push_back(make_pair(words[i], (FeatVec*)0));
+    for(Dictionary<FeatVec>::WordMap::iterator it = wordMap.begin(); it != wordMap.end(); it++)
+        it->second = new FeatVec(1, 1);
+    StringUtilUtf8 util;
+    double start;
+    {
+        Dictionary<FeatVec> dict(&util);
+        start = getTime();
+        dict.buildIndex(wordMap);
+        report("dict-build-map", wordMap.size(), getTime()-start);
+    }
+    unsigned threads = getNumThreads();
+    {
+        setNumThreads(1);
+        Dictionary<FeatVec>::WordList list = wordList;
+        fillEntries(list);
+        Dictionary<FeatVec> dict(&util);
+        start = getTime();
+        dict.buildIndex(list);
+        report("dict-build-list-1thread", list.size(), getTime()-start);
+        setNumThreads(threads);
+    }
+    {
+        Dictionary<FeatVec>::WordList list = wordList;
+        fillEntries(list);
+        Dictionary<FeatVec> dict(&util);
+        start = getTime();
+        dict.buildIndex(list);
+        report("dict-build-list", list.size(), getTime()-start);
+        vector<KinkakuString> text = makeWords(size/10, 2);
+        unsigned matched = 0;
+        start = getTime();
+        for(unsigned i = 0; i < text.size(); i++)
+            matched += dict.match(text[i]).size();
+        report("dict-match", text.size(), getTime()-start);
+    }
+}
+
+// Entries with a part of speech from a small set and a random reading,
+// each tag a separate string as when read from a corpus
+void benchEntries(unsigned size) {
+    vector<KinkakuString> words = makeWords(size, 3);
+    Dictionary<ModelTagEntry>::WordMap wordMap;
+    for(unsigned i = 0; i < words.size(); i++) {
+        if(wordMap.find(words[i]) != wordMap.end()) continue;
+        ModelTagEntry * ent = new ModelTagEntry(words[i]);
+        ent->setNumTags(2);
+        KinkakuString pos(2), pron(2 + rand() % 4);
+        pos[0] = 1; pos[1] = 1 + rand() % 30;
+        for(unsigned j = 0; j < pron.length(); j++)
+            pron[j] = 1 + rand() % 80;
+        ent->tags[0].push_back(pos);
+        ent->tagInDicts[0].push_back(1);
+        ent->tags[1].push_back(pron);
+        ent->tagInDicts[1].push_back(1);
+        ent->inDict = 1;
+        wordMap[words[i]] = ent;
+    }
+    Dictionary<ModelTagEntry>::WordList list(wordMap.begin(), wordMap.end());
+    vector<ModelTagEntry*> entries(list.size());
+    for(unsigned i = 0; i < list.size(); i++)
+        entries[i] = list[i].second;
+    cout << "entries-memory-before\t" << list.size() << "\t" << Dictionary<ModelTagEntry>::getEntryMemoryUsage(entries) << " bytes" << endl;
+    StringUtilUtf8 util;
+    Dictionary<ModelTagEntry> dict(&util);
+    double start = getTime();
+    dict.buildIndex(list);
+    report("entries-build", list.size(), getTime()-start);
+    cout << "entries-memory-after\t" << list.size() << "\t" << dict.getEntryMemoryUsage() << " bytes" << endl;
+    cout << "dict-memory\t" << list.size() << "\t" << dict.getMemoryUsage() << " bytes" << endl;
+}
+
+// A feature dictionary like the character n-gram lookup of a model,
+// written and read back in the binary and mapped formats
+void benchModelIO(unsigned size) {
+    vector<KinkakuString> words = makeWords(size, 4);
+    Dictionary<FeatVec>::WordMap wordMap;
+    for(unsigned i = 0; i < words.size(); i++) {
+        if(wordMap.find(words[i]) != wordMap.end()) continue;
+        FeatVec * vec = new FeatVec(6);
+        for(unsigned j = 0; j < vec->size(); j++)
+            (*vec)[j] = rand() % 200 - 100;
+        wordMap[words[i]] = vec;
+    }
+    StringUtilUtf8 util;
+    Dictionary<FeatVec> dict(&util);
+    dict.buildIndex(wordMap);
+    const char * binFile = "/tmp/bench-kinkaku-model.bin", * mapFile = "/tmp/bench-kinkaku-model.map";
+    {
+        BinaryModelIO binOut(&util, binFile, true);
+        binOut.writeVectorDictionary(&dict);
+        MappedModelIO mapOut(&util, mapFile, true);
+        mapOut.writeVectorDictionary(&dict);
+    }
+    double start = getTime();
+    {
+        BinaryModelIO binIn(&util, binFile, false);
+        delete binIn.readVectorDictionary();
+    }
+    report("model-read-binary", wordMap.size(), getTime()-start);
+    start = getTime();
+    {
+        MappedModelIO mapIn(&util, mapFile, false);
+        delete mapIn.readVectorDictionary();
+    }
+    report("model-read-mapped", wordMap.size(), getTime()-start);
+}
+
+// A local tag model with a small n-gram dictionary, like those of words
+// with a few readings
+KinkakuModel * makeLocalModel(StringUtil * util, const vector<KinkakuString> & ngrams) {
+    Dictionary<FeatVec>::WordMap wordMap;
+    for(unsigned i = 0; i < ngrams.size(); i++)
+        if(wordMap.find(ngrams[i]) == wordMap.end())
+            wordMap[ngrams[i]] = new FeatVec(6, (FeatVal)(rand() % 200 - 100));
+    Dictionary<FeatVec> * charDict = new Dictionary<FeatVec>(util);
+    charDict->buildIndex(wordMap);
+    FeatureLookup * look = new FeatureLookup;
+    look->setCharDict(charDict);
+    look->setBiases(new FeatVec(1, 10));
+    KinkakuModel * mod = new KinkakuModel();
+    mod->setNumClasses(2);
+    mod->setLabel(0, 1);
+    mod->setLabel(1, 2);
+    mod->setFeatureLookup(look);
+    return mod;
+}
+
+void benchLocalModels(unsigned size) {
+    vector<KinkakuString> words = makeWords(size, 5), ngrams = makeWords(size*20, 6);
+    StringUtilUtf8 util;
+    Dictionary<ModelTagEntry>::WordMap wordMap;
+    for(unsigned i = 0; i < words.size(); i++) {
+        if(wordMap.find(words[i]) != wordMap.end()) continue;
+        ModelTagEntry * ent = new ModelTagEntry(words[i]);
+        ent->setNumTags(1);
+        ent->tags[0].push_back(words[i]);
+        ent->tags[0].push_back(words[i]);
+        ent->tagInDicts[0].resize(2, 0);
+        ent->tagMods[0] = makeLocalModel(&util, vector<KinkakuString>(ngrams.begin()+i*20, ngrams.begin()+i*20+20));
+        wordMap[words[i]] = ent;
+    }
+    Dictionary<ModelTagEntry> dict(&util);
+    dict.buildIndex(wordMap);
+    const char * binFile = "/tmp/bench-kinkaku-local.bin";
+    {
+        BinaryModelIO binOut(&util, binFile, true);
+        binOut.numTags_ = 1;
+        binOut.writeModelDictionary(&dict);
+    }
+    double start = getTime();
+    BinaryModelIO * binIn = new BinaryModelIO(&util, binFile, false);
+    binIn->numTags_ = 1;
+    Dictionary<ModelTagEntry> * read = binIn->readModelDictionary();
+    LocalModelTable * table = binIn->takeLocalModels();
+    delete binIn;
+    report("local-models-read", wordMap.size(), getTime()-start);
+    // what reading every model up front used to cost
+    start = getTime();
+    for(unsigned i = 0; i < table->getNumSlots(); i++) {
+        table->acquire(i);
+        table->release(i);
+    }
+    report("local-models-decode-all", table->getNumSlots(), getTime()-start);
+    delete table;
+    delete read;
+}
+
+// Feature extraction as in training, building prefixed character n-grams
+// with operator+ and adding them to a model, and scoring words with a
+// character language model, both dominated by short string handling
+void benchStrings(unsigned size) {
+    vector<KinkakuString> words = makeWords(size, 7), prefixes(6);
+    for(unsigned i = 0; i < prefixes.size(); i++) {
+        prefixes[i] = KinkakuString(2);
+        prefixes[i][0] = 'X';
+        prefixes[i][1] = '1'+i;
+    }
+    KinkakuModel model;
+    unsigned feats = 0;
+    double start = getTime();
+    for(unsigned i = 0; i < words.size(); i++) {
+        const KinkakuString & word = words[i];
+        for(unsigned j = 0; j < word.length(); j++) {
+            KinkakuString str = prefixes[j % prefixes.size()];
+            for(unsigned k = j; k < word.length() && k < j+3; k++) {
+                str = str+word[k];
+                feats += (model.mapFeat(str) != 0);
+            }
+        }
+    }
+    report("strings-features", feats, getTime()-start);
+    KinkakuLM lm(3);
+    start = getTime();
+    lm.train(vector<KinkakuString>(words.begin(), words.begin()+words.size()/2));
+    report("strings-lm-train", words.size()/2, getTime()-start);
+    double total = 0;
+    start = getTime();
+    for(unsigned i = words.size()/2; i < words.size(); i++)
+        total += lm.score(words[i]);
+    report("strings-lm-score", words.size()-words.size()/2, getTime()-start);
+    start = getTime();
+    for(unsigned i = words.size()/2; i < words.size(); i++)
+        for(unsigned j = 0; j <= words[i].length(); j++)
+            total += lm.scoreSingle(words[i], j);
+    report("strings-lm-score-single", words.size()-words.size()/2, getTime()-start);
+    if(total > 0)
+        cerr << "unexpected positive log probability" << endl;
+}
+
+// Reading the same text in each encoding as the raw corpus reader and
+// analysis do, decoding each line to surface and normalized ids and
+// finding the types of the normalized characters
+void benchEncoding(const char * name, StringUtil & util, const string & orig, const string & norm, unsigned size) {
+    string line = norm + orig + norm;
+    KinkakuString surface, normStr, types;
+    unsigned chars = 0;
+    double start = getTime();
+    for(unsigned i = 0; i < size; i++) {
+        util.mapString(line, surface, normStr);
+        util.getTypeIds(normStr, types);
+        chars += types.length();
+    }
+    report(name, chars, getTime()-start);
+}
+
+void benchEncodings(unsigned size) {
+    StringUtilUtf8 utf8;
+    StringUtilEuc euc;
+    StringUtilSjis sjis;
+    size /= 10;
+    benchEncoding("encoding-utf8", utf8, STRING_UTIL_ORIG_UTF8, STRING_UTIL_NORM_UTF8, size);
+    benchEncoding("encoding-euc", euc, STRING_UTIL_ORIG_EUC, STRING_UTIL_NORM_EUC, size);
+    benchEncoding("encoding-sjis", sjis, STRING_UTIL_ORIG_SJIS, STRING_UTIL_NORM_SJIS, size);
+}
+
+int main(int argc, char **argv) {
+    string name = (argc > 1 ? argv[1] : "all");
+    unsigned size = (argc > 2 ? atoi(argv[2]) : 1000000);
+    try {
+        if(name == "all" || name == "dict")
+            benchDictionary(size);
+        if(name == "all" || name == "entries")
+            benchEntries(size);
+        if(name == "all" || name == "model-io")
+            benchModelIO(size);
+        if(name == "all" || name == "local-models")
+            benchLocalModels(size);
+        if(name == "all" || name == "strings")
+            benchStrings(size);
+        if(name == "all" || name == "encodings")
+            benchEncodings(size);
+    } catch (exception & e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -288,6 +288,55 @@ public:
         return checkTags(sentence,toks,1,util);
     }
 
+    int testUserDictionary() {
+        ofstream ofs("/tmp/kinkaku-user-dict.txt");
+        ofs << "東京/名詞/とうきょう" << endl;
+        ofs.close();
+        vector<string> files(1, "/tmp/kinkaku-user-dict.txt");
+        kinkaku->readUserDictionary(files);
+        KinkakuString str = util->mapString("東京に行った。");
+        KinkakuSentence sentence(str, util->normalize(str));
+        kinkaku->calculateWS(sentence);
+        kinkaku->calculateTags(sentence,1);
+        kinkaku->clearUserDictionary();
+        KinkakuString::Tokens toks = util->mapString("とうきょう に い っ た 。").tokenize(util->mapString(" "));
+        if(!checkTags(sentence,toks,1,util)) return 0;
+        vector<bool> unk_exp(6, false), unk_act(6);
+        for(int i = 0; i < 6; i++)
+            unk_act[i] = sentence.words[i].getUnknown();
+        return checkVector(unk_exp, unk_act);
+    }
+
+    int testNamedUserDictionaries() {
+        ofstream ofs1("/tmp/kinkaku-user-dict-a.txt");
+        ofs1 << "東京/名詞/とうきょう" << endl;
+        ofs1.close();
+        ofstream ofs2("/tmp/kinkaku-user-dict-b.txt");
+        ofs2 << "東京/名詞/とーきょー" << endl;
+        ofs2.close();
+        kinkaku->readUserDictionary("a", vector<string>(1, "/tmp/kinkaku-user-dict-a.txt"));
+        kinkaku->readUserDictionary("b", vector<string>(1, "/tmp/kinkaku-user-dict-b.txt"));
+        KinkakuString str = util->mapString("東京に行った。");
+        const char* exp[2] = {"とうきょう に い っ た 。", "とーきょー に い っ た 。"};
+        const char* ids[2] = {"a", "b"};
+        int ok = 1;
+        for(int i = 0; ok && i < 2; i++) {
+            const Dictionary<ModelTagEntry> * userDict = kinkaku->getUserDictionary(ids[i]);
+            KinkakuSentence sentence(str, util->normalize(str));
+            kinkaku->calculateWS(sentence, userDict);
+            kinkaku->calculateTags(sentence, 1, userDict);
+            KinkakuString::Tokens toks = util->mapString(exp[i]).tokenize(util->mapString(" "));
+            ok = checkTags(sentence,toks,1,util);
+        }
+        kinkaku->clearUserDictionary("a");
+        kinkaku->clearUserDictionary("b");
+        if(kinkaku->getUserDictionary("a") != 0) {
+            cerr << "user dictionary a was not cleared" << endl;
+            ok = 0;
+        }
+        return ok;
+    }
+
     int testPartialSegmentation() {
         stringstream instr;
         instr << "こ|れ-は デ ー タ で-す 。" << endl;
@@ -300,6 +349,47 @@ public:
         return ok;
     }
 
+    int testSteadyStateAllocations() {
+        const char * lines[3] = { "これは学習データです。", "京都に行った。", "どうぞモデルを学習してください！" };
+        stringstream instr, expstr, actstr;
+        FullCorpusIO expio(util, expstr, true);
+        for(int i = 0; i < 3; i++) {
+            KinkakuString str = util->mapString(lines[i]);
+            KinkakuSentence sentence(str, util->normalize(str));
+            kinkaku->calculateWS(sentence);
+            kinkaku->calculateTags(sentence, 0);
+            kinkaku->calculateTags(sentence, 1);
+            expio.writeSentence(&sentence);
+        }
+        for(int i = 0; i < 12; i++)
+            instr << lines[i%3] << endl;
+        RawCorpusIO rawio(util, instr, false);
+        FullCorpusIO actio(util, actstr, true);
+        fstream nullstr("/dev/null", ios::out);
+        FullCorpusIO nullio(util, nullstr, true);
+        KinkakuAnalysisContext context;
+        // the first sentences grow the buffers, and those after should
+        // not need to allocate at all
+        size_t warm = 0;
+        for(int i = 0; i < 12; i++) {
+            if(i == 6) warm = testAllocCount;
+            KinkakuSentence * sent = context.readSentence(rawio);
+            kinkaku->analyzeSentence(*sent, context);
+            (i < 3 ? actio : nullio).writeSentence(sent);
+        }
+        size_t allocs = testAllocCount - warm;
+        int ok = 1;
+        if(allocs != 0) {
+            cout << allocs << " allocations after the first sentences" << endl;
+            ok = 0;
+        }
+        if(actstr.str() != expstr.str()) {
+            cout << actstr.str() << " != " << expstr.str() << endl;
+            ok = 0;
+        }
+        return ok;
+    }
+
     int testConfidentInput() {
         string confident_text = "これ/代名詞/これ は/助詞/は 信頼/名詞/しんらい 度/接尾辞/ど の/助詞/の 高/形容詞/たか い/語尾/い 入力/名詞/にゅうりょく で/助動詞/で す/語尾/す 。/補助記号/。\n";
         stringstream instr;
@@ -348,6 +438,373 @@ public:
         return 1;
     }
 
+    string analyzeFull(Kinkaku * kin, const string & text) {
+        StringUtil * myUtil = kin->getStringUtil();
+        KinkakuString str = myUtil->mapString(text);
+        KinkakuSentence sentence(str, myUtil->normalize(str));
+        kin->calculateWS(sentence);
+        kin->calculateTags(sentence,0);
+        kin->calculateTags(sentence,1);
+        stringstream outstr;
+        FullCorpusIO outfcio(myUtil, outstr, true);
+        outfcio.writeSentence(&sentence);
+        return outstr.str();
+    }
+
+    int testMappedIO() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_MAPPED);
+        kinkaku->writeModel("/tmp/kinkaku-model.map");
+        Kinkaku actKinkaku;
+        actKinkaku.readModel("/tmp/kinkaku-model.map");
+        kinkaku->checkEqual(actKinkaku);
+        // the weights used in place must give the same analysis
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeFull(kinkaku, text), act = analyzeFull(&actKinkaku, text);
+        if(exp != act) {
+            cout << "mapped analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testCompactIO() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_COMPACT);
+        kinkaku->writeModel("/tmp/kinkaku-model.cmp");
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        ifstream cmp("/tmp/kinkaku-model.cmp", ios::binary | ios::ate), bin("/tmp/kinkaku-model.bin", ios::binary | ios::ate);
+        if(cmp.tellg() >= bin.tellg()) {
+            cout << "compact model is not smaller: " << cmp.tellg() << " >= " << bin.tellg() << endl;
+            return 0;
+        }
+        Kinkaku actKinkaku;
+        actKinkaku.readModel("/tmp/kinkaku-model.cmp");
+        // only the language model values are changed, so the analysis is not
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeFull(kinkaku, text), act = analyzeFull(&actKinkaku, text);
+        if(exp != act) {
+            cout << "compact analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        // writing it again gives the same file
+        actKinkaku.getConfig()->setModelFormat(ModelIO::FORMAT_COMPACT);
+        actKinkaku.writeModel("/tmp/kinkaku-model-2.cmp");
+        ifstream cmp1("/tmp/kinkaku-model.cmp"), cmp2("/tmp/kinkaku-model-2.cmp");
+        string str1((istreambuf_iterator<char>(cmp1)), istreambuf_iterator<char>());
+        string str2((istreambuf_iterator<char>(cmp2)), istreambuf_iterator<char>());
+        if(str1 != str2) {
+            cout << "rewritten compact model differs" << endl;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testParallelRead() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        unsigned threads = getNumThreads();
+        // every section on its own thread, or all on this one
+        setNumThreads(8);
+        Kinkaku parKinkaku;
+        parKinkaku.readModel("/tmp/kinkaku-model.bin");
+        setNumThreads(1);
+        Kinkaku seqKinkaku;
+        seqKinkaku.readModel("/tmp/kinkaku-model.bin");
+        setNumThreads(threads);
+        kinkaku->checkEqual(parKinkaku);
+        kinkaku->checkEqual(seqKinkaku);
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeFull(kinkaku, text), act = analyzeFull(&parKinkaku, text);
+        if(exp != act) {
+            cout << "parallel analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        return 1;
+    }
+
+    string analyzeWS(Kinkaku * kin, const string & text) {
+        StringUtil * myUtil = kin->getStringUtil();
+        KinkakuString str = myUtil->mapString(text);
+        KinkakuSentence sentence(str, myUtil->normalize(str));
+        kin->calculateWS(sentence);
+        stringstream outstr;
+        for(unsigned i = 0; i < sentence.words.size(); i++)
+            outstr << myUtil->showString(sentence.words[i].surface) << " ";
+        return outstr.str();
+    }
+
+    int testSelectiveLoading() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        KinkakuConfig * wsConfig = new KinkakuConfig;
+        wsConfig->setDoTags(false);
+        Kinkaku wsKinkaku(wsConfig);
+        wsKinkaku.readModel("/tmp/kinkaku-model.bin");
+        const KinkakuModelBundle * bundle = wsKinkaku.getModelBundle();
+        int ok = 1;
+        if(!bundle->getWSModel()) {
+            cout << "-notags did not load the word segmentation model" << endl;
+            ok = 0;
+        }
+        for(unsigned i = 0; i < bundle->getSubwordModels().size(); i++)
+            if(bundle->getSubwordModels()[i] || bundle->getGlobalModels()[i]) {
+                cout << "-notags loaded the models of tag " << i << endl;
+                ok = 0;
+            }
+        const vector<ModelTagEntry*> & entries = bundle->getDictionary()->getEntries();
+        for(unsigned i = 0; i < entries.size(); i++)
+            if(entries[i] && entries[i]->modelSlot != ModelTagEntry::NO_MODEL_SLOT) {
+                cout << "-notags kept a local model" << endl;
+                ok = 0;
+                break;
+            }
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeWS(kinkaku, text), act = analyzeWS(&wsKinkaku, text);
+        if(exp != act) {
+            cout << "-notags segmentation differs:" << endl << " " << exp << endl << " " << act << endl;
+            ok = 0;
+        }
+        // without unknown words the tags of known words are the same
+        KinkakuConfig * unkConfig = new KinkakuConfig;
+        unkConfig->setDoUnk(false);
+        Kinkaku unkKinkaku(unkConfig);
+        unkKinkaku.readModel("/tmp/kinkaku-model.bin");
+        if(unkKinkaku.getModelBundle()->getSubwordDictionary() || unkKinkaku.getConfig()->getDoUnk()) {
+            cout << "-nounk loaded the subword dictionary" << endl;
+            ok = 0;
+        }
+        text = "東京に行った。";
+        exp = analyzeFull(kinkaku, text); act = analyzeFull(&unkKinkaku, text);
+        if(exp != act) {
+            cout << "-nounk analysis differs:" << endl << " " << exp << " " << act;
+            ok = 0;
+        }
+        return ok;
+    }
+
+    int testLazyLocalModels() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        // with a tiny cache every local model is evicted after it is used
+        KinkakuConfig * lazyConfig = new KinkakuConfig;
+        lazyConfig->setModelCache(1);
+        Kinkaku lazyKinkaku(lazyConfig);
+        lazyKinkaku.readModel("/tmp/kinkaku-model.bin");
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeFull(kinkaku, text);
+        string act = analyzeFull(&lazyKinkaku, text) + analyzeFull(&lazyKinkaku, text);
+        if(exp+exp != act) {
+            cout << "lazy analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        // models that were never used must still be written out
+        lazyKinkaku.writeModel("/tmp/kinkaku-model-lazy.bin");
+        Kinkaku actKinkaku;
+        actKinkaku.readModel("/tmp/kinkaku-model-lazy.bin");
+        kinkaku->checkEqual(actKinkaku);
+        act = analyzeFull(&actKinkaku, text);
+        if(exp != act) {
+            cout << "rewritten analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testPruneModel() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        string exp = analyzeFull(kinkaku, text);
+        // no weights are below zero, so the model is unchanged
+        Kinkaku sameKinkaku;
+        sameKinkaku.readModel("/tmp/kinkaku-model.bin");
+        size_t removed = sameKinkaku.pruneModel(0);
+        string act = analyzeFull(&sameKinkaku, text);
+        if(removed != 0 || exp != act) {
+            cout << "pruning at zero removed " << removed << " weights:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        Kinkaku prunedKinkaku;
+        prunedKinkaku.readModel("/tmp/kinkaku-model.bin");
+        // the other users of a shared model would see it change
+        Kinkaku * sharingKinkaku = new Kinkaku;
+        sharingKinkaku->attachModel(prunedKinkaku.getModelBundle());
+        try {
+            prunedKinkaku.pruneModel(0, 1);
+            cout << "a shared model was pruned" << endl;
+            delete sharingKinkaku;
+            return 0;
+        } catch(std::exception & e) { }
+        delete sharingKinkaku;
+        removed = prunedKinkaku.pruneModel(0, 1);
+        if(removed == 0 || prunedKinkaku.pruneModel(0, 1) != 0) {
+            cout << "keeping one weight per model removed " << removed << " weights" << endl;
+            return 0;
+        }
+        exp = analyzeFull(&prunedKinkaku, text);
+        prunedKinkaku.writeModel("/tmp/kinkaku-model-pruned.bin");
+        Kinkaku actKinkaku;
+        actKinkaku.readModel("/tmp/kinkaku-model-pruned.bin");
+        act = analyzeFull(&actKinkaku, text);
+        if(exp != act) {
+            cout << "pruned analysis differs:" << endl << " " << exp << " " << act;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testEvaluatePrunedModel() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        KinkakuEvalResult full;
+        evaluateCorpus(*kinkaku, "/tmp/kinkaku-toy-corpus.txt", full);
+        // with no weights left, boundaries must be guessed from the raw text
+        Kinkaku prunedKinkaku;
+        prunedKinkaku.readModel("/tmp/kinkaku-model.bin");
+        prunedKinkaku.pruneModel(1e9);
+        KinkakuEvalResult pruned;
+        evaluateCorpus(prunedKinkaku, "/tmp/kinkaku-toy-corpus.txt", pruned);
+        if(full.bounds == 0 || pruned.bounds != full.bounds || pruned.getBoundaryAccuracy() >= 1 || pruned.getBoundaryAccuracy() >= full.getBoundaryAccuracy()) {
+            cout << "boundary accuracy " << full.getBoundaryAccuracy() << " before pruning and " << pruned.getBoundaryAccuracy() << " after" << endl;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testModelStats() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        Kinkaku actKinkaku;
+        actKinkaku.readModel("/tmp/kinkaku-model.bin");
+        KinkakuModelStats exp = kinkaku->getModelStats(), act = actKinkaku.getModelStats();
+        if(exp.components.size() != act.components.size() || exp.localModelSizes != act.localModelSizes) {
+            cout << "components or local models differ after reading" << endl;
+            return 0;
+        }
+        int ok = 1;
+        size_t localModels = 0;
+        for(unsigned i = 0; i < act.localModelSizes.size(); i++)
+            localModels += act.localModelSizes[i];
+        for(unsigned i = 0; i < act.components.size(); i++) {
+            const ModelComponentStats & e = exp.components[i], & a = act.components[i];
+            if(e.name != a.name || e.models != a.models || e.states != a.states || e.featVecs != a.featVecs || e.nonZero != a.nonZero) {
+                cout << "stats of " << e.name << " differ after reading" << endl;
+                ok = 0;
+            }
+            if(a.name == "local-tags" && a.models != localModels) {
+                cout << a.models << " local models but " << localModels << " in the distribution" << endl;
+                ok = 0;
+            }
+        }
+        if(act.components.size() == 0 || act.components[0].models != 1 || act.components[0].nonZero == 0) {
+            cout << "no word segmentation model was measured" << endl;
+            ok = 0;
+        }
+        return ok;
+    }
+
+    int testSharedModel() {
+        kinkaku->getConfig()->setModelFormat(ModelIO::FORMAT_BINARY);
+        kinkaku->writeModel("/tmp/kinkaku-model.bin");
+        KinkakuModelBundle * bundle = KinkakuModelBundle::read("/tmp/kinkaku-model.bin", new KinkakuConfig);
+        // two front ends with different settings use one copy of the model
+        KinkakuConfig * wsConfig = new KinkakuConfig;
+        wsConfig->setDoTags(false);
+        Kinkaku * wsKinkaku = new Kinkaku(wsConfig);
+        wsKinkaku->attachModel(bundle);
+        Kinkaku tagKinkaku;
+        tagKinkaku.attachModel(bundle);
+        bundle->release();
+        if(wsKinkaku->getModelBundle() != tagKinkaku.getModelBundle() || wsConfig->getDoTags() || !tagKinkaku.getConfig()->getDoTags()) {
+            cout << "model was not shared with separate settings" << endl;
+            delete wsKinkaku;
+            return 0;
+        }
+        string text = "東京に行った。これは信頼度の高い入力です。";
+        StringUtil * myUtil = wsKinkaku->getStringUtil();
+        KinkakuString str = myUtil->mapString(text);
+        KinkakuSentence sentence(str, myUtil->normalize(str));
+        wsKinkaku->calculateWS(sentence);
+        int ret = (sentence.words.size() > 0);
+        // the model outlives the instance that is deleted first
+        delete wsKinkaku;
+        string exp = analyzeFull(kinkaku, text), act = analyzeFull(&tagKinkaku, text);
+        if(exp != act) {
+            cout << "shared analysis differs:" << endl << " " << exp << " " << act;
+            ret = 0;
+        }
+        return ret;
+    }
+
+    // Analyze a text with each instance, counting the results that differ
+    // from the expected ones
+    class SharedAnalysisTask : public ParallelTask {
+    public:
+        TestAnalysis * test;
+        vector<Kinkaku*> instances;
+        vector<string> texts, exps;
+        vector<int> errors;
+        void run(unsigned begin, unsigned end) {
+            for(unsigned i = begin; i < end; i++)
+                for(int j = 0; j < 200; j++)
+                    if(test->analyzeFull(instances[i], texts[i]) != exps[i])
+                        errors[i]++;
+        }
+    };
+
+    int testSharedModelThreads() {
+        // readings longer than KinkakuString::INLINE_LENGTH are kept on the
+        // heap and copied out of the shared dictionary by every thread
+        ofstream ofs("/tmp/kinkaku-long-tag-corpus.txt");
+        ofs << "東京都庁/名詞/とうきょうとちょう に/助詞/に 行/動詞/い っ/語尾/っ た/助動詞/た 。/補助記号/。" << endl;
+        ofs << "東京都庁/名詞/とーきょーとちょー に/助詞/に 行/動詞/おこな っ/語尾/っ た/助動詞/た 。/補助記号/。" << endl;
+        ofs << "東京都庁/名詞/とうきょうとちょう で/助詞/で 学習/名詞/がくしゅうしました 。/補助記号/。" << endl;
+        ofs.close();
+        const char* cmd[5] = {"", "-model", "/tmp/kinkaku-long-tag-model.bin", "-full", "/tmp/kinkaku-long-tag-corpus.txt"};
+        KinkakuConfig * config = new KinkakuConfig;
+        config->setDebug(0);
+        config->setOnTraining(true);
+        config->parseTrainCommandLine(5, cmd);
+        Kinkaku trainer(config);
+        trainer.trainAll();
+        config->setOnTraining(false);
+        SharedAnalysisTask task;
+        task.test = this;
+        KinkakuModelBundle * bundle = KinkakuModelBundle::read("/tmp/kinkaku-long-tag-model.bin", new KinkakuConfig);
+        const unsigned numThreads = 4;
+        for(unsigned i = 0; i < numThreads; i++) {
+            task.instances.push_back(new Kinkaku);
+            task.instances[i]->attachModel(bundle);
+            // each thread also adds characters that the shared string util
+            // has not seen, a letter and a run of kanji of its own
+            string text = "東京都庁に行った。東京都庁で学習。";
+            text += (char)('w'+i);
+            for(unsigned j = 0; j < 50; j++) {
+                unsigned c = 0x4E00 + i*50 + j;
+                text += (char)(0xE0 | (c >> 12));
+                text += (char)(0x80 | ((c >> 6) & 0x3F));
+                text += (char)(0x80 | (c & 0x3F));
+            }
+            task.texts.push_back(text);
+            task.exps.push_back(analyzeFull(&trainer, text));
+        }
+        bundle->release();
+        task.errors.resize(numThreads, 0);
+        unsigned threads = getNumThreads();
+        setNumThreads(numThreads);
+        runParallel(task, numThreads);
+        setNumThreads(threads);
+        int ok = 1;
+        for(unsigned i = 0; i < numThreads; i++) {
+            if(task.errors[i]) {
+                cout << "thread " << i << " differed " << task.errors[i] << " times from:" << endl << " " << task.exps[i];
+                ok = 0;
+            }
+            delete task.instances[i];
+        }
+        return ok;
+    }
+
     bool runTest() {
         int done = 0, succeeded = 0;
         done++; cout << "testWordSegmentationSVM()" << endl; if(testWordSegmentationSVM()) succeeded++; else cout << "FAILED!!!" << endl;
@@ -361,10 +818,23 @@ public:
         done++; cout << "testGlobalSelf()" << endl; if(testGlobalSelf()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testNormalizationUnk()" << endl; if(testNormalizationUnk()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testLocalTagging()" << endl; if(testLocalTagging()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testUserDictionary()" << endl; if(testUserDictionary()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testNamedUserDictionaries()" << endl; if(testNamedUserDictionaries()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testPartialSegmentation()" << endl; if(testPartialSegmentation()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testTextIO()" << endl; if(testTextIO()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testBinaryIO()" << endl; if(testBinaryIO()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testMappedIO()" << endl; if(testMappedIO()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testCompactIO()" << endl; if(testCompactIO()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testParallelRead()" << endl; if(testParallelRead()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testSelectiveLoading()" << endl; if(testSelectiveLoading()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testLazyLocalModels()" << endl; if(testLazyLocalModels()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testPruneModel()" << endl; if(testPruneModel()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testEvaluatePrunedModel()" << endl; if(testEvaluatePrunedModel()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testModelStats()" << endl; if(testModelStats()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testSharedModel()" << endl; if(testSharedModel()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testSharedModelThreads()" << endl; if(testSharedModelThreads()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testConfidentInput()" << endl; if(testConfidentInput()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testSteadyStateAllocations()" << endl; if(testSteadyStateAllocations()) succeeded++; else cout << "FAILED!!!" << endl;
         cout << "#### TestAnalysis Finished with "<<succeeded<<"/"<<done<<" tests succeeding ####"<<endl;
         return done == succeeded;
     }
@@ -33,10 +33,43 @@
 #include <kinkaku/corpus-io-raw.h>
 #include <kinkaku/model-io.h>
 #include <kinkaku/kinkaku-util.h>
+#include <kinkaku/kinkaku-lm.h>
+#include <kinkaku/model-io-binary.h>
+#include <kinkaku/model-io-mapped.h>
+#include <kinkaku/kinkaku-thread.h>
 #include <fstream>
 #include <iostream>
 #include <kinkaku/kinkaku-config.h>
 #include <kinkaku/kinkaku.h>
+#include <kinkaku/kinkaku-model-bundle.h>
+#include <kinkaku/kinkaku-eval.h>
+#include <kinkaku/kinkaku-analysis-context.h>
+#include <cstdlib>
+#include <new>
+
+// Every allocation goes through here and is counted, so that tests can
+// check that a piece of code does not allocate
+size_t testAllocCount = 0;
+
+void * operator new(size_t size) {
+    // tests with several threads allocate at the same time
+    __atomic_add_fetch(&testAllocCount, 1, __ATOMIC_RELAXED);
+    void * ret = malloc(size ? size : 1);
+    if(ret == 0)
+        throw std::bad_alloc();
+    return ret;
+}
+
+void operator delete(void * ptr) {
+    free(ptr);
+}
+
+// kept out of line, as gcc takes free() inlined into the containers'
+// sized deallocation to be a mismatch with operator new
+__attribute__((noinline)) void operator delete(void * ptr, size_t) {
+    free(ptr);
+}
+
 #include "test-kinkaku.h"
 #include "test-analysis.h"
 #include "test-corpusio.h"
@@ -28,6 +28,8 @@
 #define TEST_KYTEA__
 
 #include <algorithm>
+#include <set>
+#include <limits>
 
 using namespace std;
 
@@ -49,6 +51,169 @@ public:
         return 1;
     }
     
+    int testGetTypeIds() {
+        StringUtilUtf8 utf8;
+        StringUtilEuc euc;
+        StringUtil * utils[2] = { &utf8, &euc };
+        // includes characters that are also type names
+        const char * text[2] = { "漢カひ。１AKOx", "\xb4\xc1\xa5\xab\xa4\xd2\xa1\xa3\xa3\xb1" "AKOx" };
+        int ok = 1;
+        for(int i = 0; i < 2; i++) {
+            KinkakuString str = utils[i]->mapString(text[i]), act;
+            // every byte of the EUC text must be read as the character meant
+            if(i == 1 && utils[i]->getTypeString(str) != "KTHODRRRR") {
+                cout << "getTypeString " << i << ": " << utils[i]->getTypeString(str) << " != KTHODRRRR" << endl;
+                ok = 0;
+            }
+            KinkakuString exp = utils[i]->mapString(utils[i]->getTypeString(str));
+            utils[i]->getTypeIds(str, act);
+            if(act != exp) {
+                cout << "getTypeIds " << i << ": " << utils[i]->showString(act) << " != " << utils[i]->showString(exp) << endl;
+                ok = 0;
+            }
+        }
+        return ok;
+    }
+
+    // Map new characters and their type ids from several threads at once
+    class TypeIdsTask : public ParallelTask {
+    public:
+        StringUtil * util;
+        vector<int> errors;
+        void run(unsigned begin, unsigned end) {
+            for(unsigned i = begin; i < end; i++) {
+                // the initial characters' types are only given ids here
+                string text = "KTHRDO";
+                for(unsigned j = 0; j < 100; j++) {
+                    unsigned c = 0x3040 + i*100 + j;
+                    text += (char)(0xE0 | (c >> 12));
+                    text += (char)(0x80 | ((c >> 6) & 0x3F));
+                    text += (char)(0x80 | (c & 0x3F));
+                }
+                KinkakuString str = util->mapString(text), ids;
+                util->getTypeIds(str, ids);
+                if(util->showString(ids) != util->getTypeString(str))
+                    errors[i]++;
+            }
+        }
+    };
+
+    int testTypeIdsThreads() {
+        StringUtilUtf8 util;
+        TypeIdsTask task;
+        task.util = &util;
+        task.errors.resize(4, 0);
+        unsigned threads = getNumThreads();
+        setNumThreads(4);
+        runParallel(task, 4);
+        setNumThreads(threads);
+        for(unsigned i = 0; i < 4; i++)
+            if(task.errors[i]) {
+                cout << "type ids of thread " << i << " differ from its type string" << endl;
+                return 0;
+            }
+        return 1;
+    }
+
+    int testMapStringUtf8() {
+        StringUtilUtf8 util;
+        // ascii runs longer than eight bytes, and 2, 3 and 4 byte characters
+        string text = "abcdefghijKLMNOPQR é漢字カナ 𠀋x";
+        const char * chars[] = { "a","b","c","d","e","f","g","h","i","j","K","L","M","N","O","P","Q","R"," ","é","漢","字","カ","ナ"," ","𠀋","x" };
+        KinkakuString str = util.mapString(text);
+        int ok = 1;
+        if(str.length() != sizeof(chars)/sizeof(chars[0])) {
+            cout << "length " << str.length() << " != " << sizeof(chars)/sizeof(chars[0]) << endl;
+            return 0;
+        }
+        for(unsigned i = 0; i < str.length(); i++)
+            if(str[i] != util.mapChar(chars[i])) {
+                cout << "character " << i << " (" << chars[i] << ") has id " << str[i] << endl;
+                ok = 0;
+            }
+        if(util.showString(str) != text) {
+            cout << util.showString(str) << " != " << text << endl;
+            ok = 0;
+        }
+        // malformed sequences are rejected
+        const char * bad[] = { "a\x80" "b", "\xC0\xAF", "\xE0\x80\xAF", "\xE6\xBC", "\xF8\x88\x80\x80\x80", "\xF4\x90\x80\x80" };
+        for(unsigned i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+            try {
+                util.mapString(bad[i]);
+                cout << "malformed string " << i << " was accepted" << endl;
+                ok = 0;
+            } catch(std::exception & e) { }
+        }
+        return ok;
+    }
+
+    int testMapStringDoubleByte() {
+        StringUtilEuc euc;
+        StringUtilSjis sjis;
+        StringUtil * utils[2] = { &euc, &sjis };
+        // ascii runs longer than eight bytes, kanji, kana (half-width in
+        // SJIS) and full-width letters that are normalized
+        const char * chars[2][14] = {
+            { "a","b","c","d","e","f","g","h","i","\xb4\xc1","\xa5\xab","\x8e\xb1","\xa3\xc1","x" },
+            { "a","b","c","d","e","f","g","h","i","\x8a\xbf","\x83\x4a","\xb1","\x82\x60","x" }
+        };
+        int ok = 1;
+        for(int i = 0; i < 2; i++) {
+            string text;
+            for(int j = 0; j < 14; j++)
+                text += chars[i][j];
+            KinkakuString surface, norm;
+            utils[i]->mapString(text, surface, norm);
+            if(surface.length() != 14 || utils[i]->mapString(text) != surface) {
+                cout << "encoding " << i << ": length " << surface.length() << " != 14" << endl;
+                ok = 0;
+                continue;
+            }
+            for(int j = 0; j < 14; j++)
+                if(surface[j] != utils[i]->mapChar(chars[i][j])) {
+                    cout << "encoding " << i << ": character " << j << " has id " << surface[j] << endl;
+                    ok = 0;
+                }
+            if(norm != utils[i]->normalize(surface) || norm == surface) {
+                cout << "encoding " << i << ": bad normalization " << utils[i]->showString(norm) << endl;
+                ok = 0;
+            }
+            if(utils[i]->showString(surface) != text) {
+                cout << "encoding " << i << ": " << utils[i]->showString(surface) << " != " << text << endl;
+                ok = 0;
+            }
+        }
+        return ok;
+    }
+
+    int testNormalizeTable() {
+        StringUtilUtf8 util;
+        KinkakuString surface, norm;
+        util.mapString("ABC123と漢字x", surface, norm);
+        KinkakuString expSurface = util.mapString("ABC123と漢字x");
+        KinkakuString expNorm = util.mapString("ＡＢＣ１２３と漢字ｘ");
+        int ok = 1;
+        if(surface != expSurface) {
+            cout << util.showString(surface) << " != " << util.showString(expSurface) << endl;
+            ok = 0;
+        }
+        if(norm != expNorm || util.normalize(surface) != expNorm) {
+            cout << util.showString(norm) << " != " << util.showString(expNorm) << endl;
+            ok = 0;
+        }
+        // the table agrees with the map, and leaves other characters alone
+        GenericMap<KinkakuChar,KinkakuChar> * normMap = util.getNormMap();
+        const KinkakuChar * table = util.getNormTable();
+        for(unsigned i = 0; i <= std::numeric_limits<KinkakuChar>::max(); i++) {
+            GenericMap<KinkakuChar,KinkakuChar>::const_iterator it = normMap->find(i);
+            if(table[i] != (it == normMap->end() ? i : it->second)) {
+                cout << "character " << i << " normalized to " << table[i] << endl;
+                ok = 0;
+            }
+        }
+        return ok;
+    }
+
     int compareFeatures(vector<KinkakuString> & exp, vector<KinkakuString> & act, StringUtilUtf8 & util) {
         sort(exp.begin(), exp.end());
         sort(act.begin(), act.end());
@@ -72,6 +237,75 @@ public:
         return bad ? 0 : 1;
     }
 
+    int testStringStorage() {
+        StringUtilUtf8 util;
+        KinkakuString shortStr = util.mapString("abc"), longStr = util.mapString("abcdefghij");
+        int ok = 1;
+        if(shortStr.getImpl() != 0 || longStr.getImpl() == 0) {
+            cout << "short strings should be inline and long ones on the heap" << endl;
+            ok = 0;
+        }
+        // copies share the heap block until one is written
+        KinkakuString copy = longStr;
+        const KinkakuString & constCopy = copy, & constLong = longStr;
+        if(constCopy.getImpl() != constLong.getImpl()) {
+            cout << "copy did not share characters" << endl;
+            ok = 0;
+        }
+        copy[0] = util.mapChar("z");
+        KinkakuString shortCopy = shortStr;
+        shortCopy[0] = util.mapChar("z");
+        if(util.showString(longStr) != "abcdefghij" || util.showString(copy) != "zbcdefghij"
+            || util.showString(shortStr) != "abc" || util.showString(shortCopy) != "zbc") {
+            cout << "writing to a copy changed the original" << endl;
+            ok = 0;
+        }
+        // concatenation and substrings crossing the inline length
+        KinkakuString cat = shortStr + shortStr + util.mapChar("d");
+        if(util.showString(cat) != "abcabcd" || cat.getImpl() == 0 || !(cat.substr(3) == util.mapString("abcd"))
+            || util.showString(longStr.substr(2, 7)) != "cdefghi" || cat.getHash() != util.mapString("abcabcd").getHash()) {
+            cout << "concatenation or substring failed: " << util.showString(cat) << endl;
+            ok = 0;
+        }
+        KinkakuString empty;
+        if(empty.length() != 0 || !(empty + shortStr == shortStr) || !(empty < shortStr) || shortStr < empty) {
+            cout << "empty string comparison failed" << endl;
+            ok = 0;
+        }
+        return ok;
+    }
+
+    int testStringView() {
+        StringUtilUtf8 util;
+        KinkakuString sent = util.mapString("the dictionary words");
+        KinkakuStringView view = KinkakuStringView(sent).substr(4, 10);
+        KinkakuString word = util.mapString("dictionary");
+        int ok = 1;
+        if(!(view == word) || view.getHash() != word.getHash() || KinkakuStringHash()(view) != KinkakuStringHash()(word)
+            || !(KinkakuString(view) == word)) {
+            cout << "view does not match its string" << endl;
+            ok = 0;
+        }
+        Dictionary<FeatVec>::WordMap dictMap;
+        dictMap[word] = new FeatVec(1, 1);
+        dictMap[util.mapString("on")] = new FeatVec(1, 2);
+        Dictionary<FeatVec> dict(&util);
+        dict.buildIndex(dictMap);
+        if(dict.findEntry(view) == 0 || dict.findEntry(view.substr(0, 4)) != 0 || dict.match(view).size() != 2) {
+            cout << "lookup in a view failed" << endl;
+            ok = 0;
+        }
+        KinkakuLM lm(3);
+        vector<KinkakuString> corpus(1, sent);
+        lm.train(corpus);
+        if(lm.score(view) != lm.score(word) || lm.scoreSingle(view, 3) != lm.scoreSingle(word, 3)
+            || lm.findProb(view.substr(0, 3)) == 0) {
+            cout << "language model scores of a view differ" << endl;
+            ok = 0;
+        }
+        return ok;
+    }
+
     int testWSNgramFeatures() {
         StringUtilUtf8 util;
         Kinkaku kinkaku;
@@ -207,25 +441,25 @@ public:
         const char* wordStrs[SIZE] = { "漢", "カ", "ひ", "。", "１", "A",
                                        "漢カ", "カひ", "ひ。", "。１", "１A"};
         const int wordPoss[SIZE] = { 5, 4, 3, 2, 1, 0, 4, 3, 2, 1, 0 };
-        typedef Dictionary<vector<FeatVal> >::WordMap WordMap;
+        typedef Dictionary<FeatVec>::WordMap WordMap;
         WordMap wm;
         for(int i = 0; i < SIZE; i++) {
-            pair<WordMap::iterator, bool> it = wm.insert(WordMap::value_type(util.mapString(wordStrs[i]),new vector<FeatVal>(6,0)));
+            pair<WordMap::iterator, bool> it = wm.insert(WordMap::value_type(util.mapString(wordStrs[i]),new FeatVec(6,0)));
             (*it.first->second)[wordPoss[i]] = i+1;
         }
-        Dictionary<vector<FeatVal> > exp(&util);
+        Dictionary<FeatVec> exp(&util);
         exp.buildIndex(wm);
         KinkakuModel * mod = makeFeatureLookup(&util, 2);
         FeatureLookup * look = mod->getFeatureLookup();
-        const Dictionary<vector<FeatVal> > * act = look->getCharDict();
+        const Dictionary<FeatVec> * act = look->getCharDict();
         int ret = 1;
         if((int)act->getEntries().size() != SIZE) {
             cerr << "act->getEntries().size() == "<<act->getEntries().size()<<endl;
             ret = 0;
         } else {
             for(int i = 0; i < SIZE; i++) {
-                const vector<FeatVal> * actVec = act->findEntry(util.mapString(wordStrs[i]));
-                vector<FeatVal> * expVec = exp.findEntry(util.mapString(wordStrs[i]));
+                const FeatVec * actVec = act->findEntry(util.mapString(wordStrs[i]));
+                FeatVec * expVec = exp.findEntry(util.mapString(wordStrs[i]));
                 if(actVec == NULL) {
                     cerr << "actVec["<<i<<"] == NULL"<<endl;
                     ret = 0;
@@ -242,11 +476,11 @@ public:
                 }
             }
         }
-        vector<FeatVal> dictExp(2*5*3, 0);
+        FeatVec dictExp(2*5*3, 0);
         dictExp[0*15+0*3+2] = SIZE+1;
         dictExp[0*15+4*3+1] = SIZE+2;
         dictExp[1*15+4*3+0] = SIZE+3;
-        const vector<FeatVal> & dictAct = *look->getDictVector();
+        const FeatVec & dictAct = *look->getDictVector();
         if(dictExp.size() != dictAct.size()) {
             cerr << "dictExp.size() == "<<dictExp.size()
                  << " dictAct.size() == "<<dictAct.size() <<endl;
@@ -457,9 +691,410 @@ public:
         return ret;
     }
 
+    int testDictionaryDenseGotos() {
+        StringUtilUtf8 util;
+        const char * chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN";
+        vector<string> words;
+        for(const char * c = chars; *c; c++) {
+            words.push_back(string(1,*c));
+            if(*c < 'u') words.push_back(string("x")+*c);
+        }
+        words.push_back("xyz"); words.push_back("yza"); words.push_back("za");
+        Dictionary<ModelTagEntry>::WordMap dictMap;
+        for(unsigned i = 0; i < words.size(); i++) {
+            KinkakuString word = util.mapString(words[i]);
+            dictMap[word] = new ModelTagEntry(word);
+        }
+        Dictionary<ModelTagEntry> dict(&util);
+        dict.buildIndex(dictMap);
+        if(!dict.isDense(0) || !dict.isDense(dict.step(0, util.mapChar("x")))) {
+            cerr << "Dense gotos were not built for high-fanout states" << endl;
+            return 0;
+        }
+        KinkakuString str = util.mapString("xyzaxbQxt");
+        set< pair<unsigned,string> > exp, act;
+        for(unsigned i = 0; i < str.length(); i++)
+            for(unsigned j = 0; j <= i; j++)
+                if(dictMap.find(str.substr(j,i-j+1)) != dictMap.end())
+                    exp.insert(make_pair(i, util.showString(str.substr(j,i-j+1))));
+        Dictionary<ModelTagEntry>::MatchResult res = dict.match(str);
+        for(unsigned i = 0; i < res.size(); i++)
+            act.insert(make_pair(res[i].first, util.showString(res[i].second->word)));
+        if(exp != act || res.size() != act.size()) {
+            cerr << "Dictionary matches (" << res.size() << ") do not match the expected (" << exp.size() << ")" << endl;
+            return 0;
+        }
+        if(dict.findEntry(util.mapString("xt")) == 0 || dict.findEntry(util.mapString("xu")) != 0)
+            return 0;
+        // a root whose few characters are far apart uses the sorted gotos
+        // rather than a table spanning all of the ids between them
+        for(unsigned c = 0x3040; c < 0x3080; c++) {
+            string ch;
+            ch += (char)(0xE0 | (c >> 12));
+            ch += (char)(0x80 | ((c >> 6) & 0x3F));
+            ch += (char)(0x80 | (c & 0x3F));
+            util.mapChar(ch);
+        }
+        Dictionary<ModelTagEntry>::WordMap sparseMap;
+        const char * sparse[2] = { "a", "\xe3\x82\x80" };
+        for(unsigned i = 0; i < 2; i++) {
+            KinkakuString word = util.mapString(sparse[i]);
+            sparseMap[word] = new ModelTagEntry(word);
+        }
+        Dictionary<ModelTagEntry> sparseDict(&util);
+        sparseDict.buildIndex(sparseMap);
+        if(sparseDict.isDense(0) || sparseDict.findEntry(util.mapString(sparse[1])) == 0) {
+            cerr << "Sparse root was given a dense table" << endl;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testDictionaryBuildList() {
+        StringUtilUtf8 util;
+        srand(7);
+        Dictionary<ProbTagEntry>::WordMap dictMap;
+        Dictionary<ProbTagEntry>::WordList dictList;
+        for(unsigned i = 0; i < 30000; i++) {
+            KinkakuString word(2 + rand() % 6);
+            for(unsigned j = 0; j < word.length(); j++)
+                word[j] = util.mapChar(string(1,'a'+rand()%10).c_str());
+            if(dictMap.find(word) != dictMap.end()) continue;
+            dictMap[word] = new ProbTagEntry(word);
+            dictList.push_back(make_pair(word, new ProbTagEntry(word)));
+        }
+        unsigned threads = getNumThreads();
+        setNumThreads(4);
+        Dictionary<ProbTagEntry> mapDict(&util), listDict(&util);
+        mapDict.buildIndex(dictMap);
+        listDict.buildIndex(dictList);
+        setNumThreads(threads);
+        if(mapDict.getStates().size() != listDict.getStates().size()) {
+            cerr << "State sizes don't match" << endl;
+            return 0;
+        }
+        for(unsigned i = 0; i < 100; i++) {
+            KinkakuString str(20);
+            for(unsigned j = 0; j < str.length(); j++)
+                str[j] = util.mapChar(string(1,'a'+rand()%10).c_str());
+            Dictionary<ProbTagEntry>::MatchResult exp = mapDict.match(str), act = listDict.match(str);
+            if(exp.size() != act.size()) {
+                cerr << "Match sizes don't match for " << util.showString(str) << endl;
+                return 0;
+            }
+            for(unsigned j = 0; j < exp.size(); j++) {
+                if(exp[j].first != act[j].first || exp[j].second->word != act[j].second->word) {
+                    cerr << "Match "<<j<<" doesn't match for " << util.showString(str) << endl;
+                    return 0;
+                }
+            }
+        }
+        return 1;
+    }
+
+    int testDictionaryCompiled() {
+        StringUtilUtf8 util;
+        Dictionary<ModelTagEntry>::WordList words;
+        const char* surfs[5] = { "a", "ab", "abc", "bc", "c" };
+        for(unsigned i = 0; i < 5; i++) {
+            ModelTagEntry * ent = new ModelTagEntry(util.mapString(surfs[i]));
+            ent->setNumTags(2);
+            ent->tags[1].push_back(util.mapString(string("t")+surfs[i]));
+            ent->tagInDicts[1].push_back(1);
+            ent->inDict = 1;
+            words.push_back(make_pair(ent->word, ent));
+        }
+        Dictionary<ModelTagEntry> dict(&util);
+        dict.buildIndex(words);
+        dict.setNumDicts(1);
+        dict.writeCompiled("/tmp/kinkaku-compiled-dict.bin");
+        // the same character ids can use the file directly, different ones rebuild
+        StringUtilUtf8 otherUtil;
+        otherUtil.mapChar("c"); otherUtil.mapChar("x");
+        Dictionary<ModelTagEntry> same(&util), other(&otherUtil);
+        same.readCompiled("/tmp/kinkaku-compiled-dict.bin");
+        other.readCompiled("/tmp/kinkaku-compiled-dict.bin");
+        if(!same.isMapped() || other.isMapped()) {
+            cerr << "Mapping was not done as expected" << endl;
+            return 0;
+        }
+        Dictionary<ModelTagEntry>* dicts[2] = { &same, &other };
+        StringUtil* utils[2] = { &util, &otherUtil };
+        for(unsigned i = 0; i < 2; i++) {
+            if(dicts[i]->getNumDicts() != 1) {
+                cerr << "getNumDicts() == " << (int)dicts[i]->getNumDicts() << endl;
+                return 0;
+            }
+            if(dicts[i]->match(utils[i]->mapString("abcx")).size() != 5) {
+                cerr << "Bad match size for dictionary "<<i<<endl;
+                return 0;
+            }
+            const ModelTagEntry * ent = dicts[i]->findEntry(utils[i]->mapString("bc"));
+            if(!ent || ent->tags.size() != 2 || ent->tags[1].size() != 1 || 
+               utils[i]->showString(ent->tags[1][0]) != "tbc" || ent->tagInDicts[1][0] != 1 || ent->inDict != 1) {
+                cerr << "Bad entry for bc in dictionary "<<i<<endl;
+                return 0;
+            }
+        }
+        // a state pointing outside the arrays is caught when reading
+        vector<DictionaryState> states;
+        Dictionary<ModelTagEntry>::Gotos gotos;
+        dict.getPackedArrays(states, gotos);
+        string data;
+        {
+            ifstream in("/tmp/kinkaku-compiled-dict.bin", ios::in | ios::binary);
+            data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        }
+        size_t pos = data.find(string((const char *)&states[1], sizeof(DictionaryState)));
+        if(pos == string::npos) {
+            cerr << "States were not found in the compiled file" << endl;
+            return 0;
+        }
+        DictionaryState bad = states[1];
+        bad.failure = states.size();
+        data.replace(pos, sizeof(DictionaryState), (const char *)&bad, sizeof(DictionaryState));
+        {
+            ofstream out("/tmp/kinkaku-compiled-dict.bin", ios::out | ios::binary);
+            out << data;
+        }
+        Dictionary<ModelTagEntry> corrupted(&util);
+        try {
+            corrupted.readCompiled("/tmp/kinkaku-compiled-dict.bin");
+            cerr << "A corrupted state was read without error" << endl;
+            return 0;
+        } catch(std::exception & e) { }
+        return 1;
+    }
+
+    int testDictionaryOutputLinks() {
+        StringUtilUtf8 util;
+        const char* surfs[7] = { "a", "aa", "aaa", "ba", "baa", "cab", "b" };
+        set<KinkakuString> words;
+        Dictionary<ProbTagEntry>::WordList list;
+        for(unsigned i = 0; i < 7; i++) {
+            KinkakuString word = util.mapString(surfs[i]);
+            words.insert(word);
+            list.push_back(make_pair(word, new ProbTagEntry(word)));
+        }
+        Dictionary<ProbTagEntry> dict(&util);
+        dict.buildIndex(list);
+        // each match position should give every word ending there, longest first
+        KinkakuString str = util.mapString("cabaaab");
+        Dictionary<ProbTagEntry>::MatchResult act = dict.match(str), exp;
+        for(unsigned i = 0; i < str.length(); i++)
+            for(unsigned j = 0; j <= i; j++)
+                if(words.find(str.substr(j, i-j+1)) != words.end())
+                    exp.push_back(make_pair(i, dict.findEntry(str.substr(j, i-j+1))));
+        if(exp.size() != act.size()) {
+            cerr << "exp.size() != act.size() ("<<exp.size()<<" != "<<act.size()<<")"<<endl;
+            return 0;
+        }
+        for(unsigned i = 0; i < exp.size(); i++) {
+            if(exp[i] != act[i]) {
+                cerr << "Match "<<i<<" is "<<util.showString(act[i].second->word)<<"@"<<act[i].first<<", expected "<<util.showString(exp[i].second->word)<<"@"<<exp[i].first<<endl;
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    int testDictionaryCompactEntries() {
+        StringUtilUtf8 util;
+        Dictionary<ProbTagEntry>::WordList list;
+        const char* surfs[3] = { "a", "b", "c" };
+        for(unsigned i = 0; i < 3; i++) {
+            ProbTagEntry * ent = new ProbTagEntry(util.mapString(surfs[i]));
+            ent->setNumTags(1);
+            ent->tags[0].reserve(10);
+            ent->tags[0].push_back(util.mapString("common-noun"));
+            ent->tagInDicts[0].push_back(1);
+            list.push_back(make_pair(ent->word, ent));
+        }
+        vector<ProbTagEntry*> entries(3);
+        for(unsigned i = 0; i < 3; i++)
+            entries[i] = list[i].second;
+        size_t before = Dictionary<ProbTagEntry>::getEntryMemoryUsage(entries);
+        Dictionary<ProbTagEntry> dict(&util);
+        dict.buildIndex(list);
+        size_t after = dict.getEntryMemoryUsage();
+        if(after >= before) {
+            cerr << "Memory was not reduced ("<<before<<" -> "<<after<<")"<<endl;
+            return 0;
+        }
+        // the tags of all entries are consecutive in one pool, in the order of the entries
+        const ProbTagEntry * first = dict.getEntries()[0], * last = dict.getEntries()[2];
+        ProbTagEntry * b = dict.findEntry(util.mapString("b"));
+        const ProbTagEntry * c = dict.findEntry(util.mapString("c"));
+        if(first->tags[0][0].getImpl() != last->tags[0][0].getImpl() || !first->tags.isView() || !first->tags[0].isView() || last->tags[0].data() != first->tags[0].data()+2) {
+            cerr << "Tags were not pooled" << endl;
+            return 0;
+        }
+        // a view that grows is copied out of the pool first
+        b->tags[0].push_back(util.mapString("proper-noun"));
+        b->incrementProb(util.mapString("proper-noun"), 0);
+        if(b->tags[0].isView() || b->probs[0].size() != 2 || b->probs[0][1] != 1 || util.showString(c->tags[0][0]) != "common-noun") {
+            cerr << "A pooled entry did not grow separately" << endl;
+            return 0;
+        }
+        // given an arena, the entries are moved into the pool too
+        MappedArena * arena = new MappedArena(false);
+        dict.compactEntries(arena, false);
+        arena->release();
+        first = dict.getEntries()[0];
+        b = dict.findEntry(util.mapString("b"));
+        if(dict.getEntries()[1] != first+1 || dict.getEntries()[2] != first+2 || b == 0 || b->tags[0].size() != 2 || util.showString(b->tags[0][1]) != "proper-noun" || b->probs[0][1] != 1) {
+            cerr << "Entries were not moved into the arena" << endl;
+            return 0;
+        }
+        return 1;
+    }
+
+    int testDictionaryArena() {
+        StringUtilUtf8 util;
+        const char* words[5] = { "a", "ab", "abc", "b", "bc" };
+        Dictionary<FeatVec>::WordMap dictMap;
+        for(unsigned i = 0; i < 5; i++)
+            dictMap[util.mapString(words[i])] = new FeatVec(i+1, (FeatVal)(i+1));
+        Dictionary<FeatVec> exp(&util);
+        exp.buildIndex(dictMap);
+        stringstream str;
+        BinaryModelIO out(&util, str, true);
+        out.writeVectorDictionary(&exp);
+        BinaryModelIO in(&util, str, false);
+        Dictionary<FeatVec> * act = in.readVectorDictionary();
+        // the automaton and the weights are read into one arena
+        int ret = 1;
+        if(!act->isMapped()) {
+            cerr << "Dictionary was not packed into an arena" << endl;
+            ret = 0;
+        }
+        for(unsigned i = 0; i < 5; i++) {
+            const FeatVec * vec = act->findEntry(util.mapString(words[i]));
+            if(vec == 0 || !vec->isView() || *vec != *exp.findEntry(util.mapString(words[i]))) {
+                cerr << "Bad entry for " << words[i] << endl;
+                ret = 0;
+            }
+        }
+        KinkakuString text = util.mapString("abcbc");
+        if(act->match(text).size() != exp.match(text).size()) {
+            cerr << "Matches in the arena do not match the original" << endl;
+            ret = 0;
+        }
+        delete act;
+        return ret;
+    }
+
+    int testMappedArena() {
+        MappedArena * arena = new MappedArena(false);
+        MappedFile *a, *b, *c;
+        char * blockA = arena->take(13, a);
+        char * blockB = arena->take(40, b);
+        char * blockC = arena->take(4 << 20, c);
+        int ret = 1;
+        // small blocks share a chunk, aligned and without overlapping
+        if(a != b || blockB < blockA+13 || ((size_t)blockB & 7) != 0) {
+            cerr << "Small blocks do not share a chunk" << endl;
+            ret = 0;
+        }
+        if(c == a || c->getSize() < (4 << 20)) {
+            cerr << "Large block was not allocated alone" << endl;
+            ret = 0;
+        }
+        // blocks stay usable after the arena is gone
+        arena->release();
+        memset(blockA, 1, 13);
+        memset(blockB, 2, 40);
+        memset(blockC, 3, 4 << 20);
+        a->release(); b->release(); c->release();
+        return ret;
+    }
+
+    KinkakuModel * makeLocalModel(StringUtil * util, const char * ngram, FeatVal weight) {
+        Dictionary<FeatVec>::WordMap dictMap;
+        dictMap[util->mapString(ngram)] = new FeatVec(4, weight);
+        Dictionary<FeatVec> * charDict = new Dictionary<FeatVec>(util);
+        charDict->buildIndex(dictMap);
+        FeatureLookup * look = new FeatureLookup;
+        look->setCharDict(charDict);
+        look->setBiases(new FeatVec(1, weight));
+        KinkakuModel * mod = new KinkakuModel();
+        mod->setAddFeatures(false);
+        mod->setNumClasses(2);
+        mod->setLabel(0, 1);
+        mod->setLabel(1, 2);
+        mod->setFeatureLookup(look);
+        return mod;
+    }
+
+    int testLocalModelSharing() {
+        StringUtilUtf8 util;
+        const char* words[3] = { "a", "b", "c" };
+        Dictionary<ModelTagEntry>::WordMap dictMap;
+        for(unsigned i = 0; i < 3; i++) {
+            ModelTagEntry * ent = new ModelTagEntry(util.mapString(words[i]));
+            ent->setNumTags(1);
+            ent->tags[0].push_back(util.mapString("x"));
+            ent->tags[0].push_back(util.mapString("y"));
+            ent->tagInDicts[0].resize(2, 0);
+            // a and b have the same model
+            ent->tagMods[0] = makeLocalModel(&util, "xy", (i == 2 ? 3 : 5));
+            dictMap[ent->word] = ent;
+        }
+        Dictionary<ModelTagEntry> exp(&util);
+        exp.buildIndex(dictMap);
+        int ret = 1;
+        for(int mapped = 0; mapped < 2; mapped++) {
+            stringstream str;
+            BinaryModelIO * out = (mapped ? new MappedModelIO(&util, str, true) : new BinaryModelIO(&util, str, true));
+            out->numTags_ = 1;
+            out->writeModelDictionary(&exp);
+            delete out;
+            BinaryModelIO * in = (mapped ? new MappedModelIO(&util, str, false) : new BinaryModelIO(&util, str, false));
+            in->numTags_ = 1;
+            Dictionary<ModelTagEntry> * act = in->readModelDictionary();
+            LocalModelTable * table = in->takeLocalModels();
+            delete in;
+            if(table == 0 || table->getNumModels() != 2) {
+                cerr << "Expected 2 distinct local models, got " << (table ? table->getNumModels() : 0) << endl;
+                delete act;
+                if(table) delete table;
+                return 0;
+            }
+            unsigned slots[3];
+            for(unsigned i = 0; i < 3; i++)
+                slots[i] = act->findEntry(util.mapString(words[i]))->modelSlot;
+            KinkakuModel * a = table->acquire(slots[0]), * b = table->acquire(slots[1]), * c = table->acquire(slots[2]);
+            if(a != b || a == c) {
+                cerr << "Identical local models are not shared" << endl;
+                ret = 0;
+            }
+            for(unsigned i = 0; i < 3; i++) {
+                KinkakuModel * mod = table->readModel(slots[i]);
+                const FeatVec * vec = mod->getFeatureLookup()->getCharDict()->findEntry(util.mapString("xy"));
+                if(vec == 0 || (*vec)[0] != (i == 2 ? 3 : 5) || mod->getFeatureLookup()->getBias(0) != (i == 2 ? 3 : 5)) {
+                    cerr << "Bad local model for " << words[i] << endl;
+                    ret = 0;
+                }
+                delete mod;
+            }
+            for(unsigned i = 0; i < 3; i++)
+                table->release(slots[i]);
+            delete act;
+            delete table;
+        }
+        return ret;
+    }
+
     bool runTest() {
         int done = 0, succeeded = 0;
         done++; cout << "testGetTypeString()" << endl; if(testGetTypeString()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testGetTypeIds()" << endl; if(testGetTypeIds()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testTypeIdsThreads()" << endl; if(testTypeIdsThreads()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testMapStringUtf8()" << endl; if(testMapStringUtf8()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testMapStringDoubleByte()" << endl; if(testMapStringDoubleByte()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testNormalizeTable()" << endl; if(testNormalizeTable()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testStringStorage()" << endl; if(testStringStorage()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testStringView()" << endl; if(testStringView()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testWSNgramFeatures()" << endl; if(testWSNgramFeatures()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testTagNgramFeatures()" << endl; if(testTagNgramFeatures()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testTagSelfFeatures()" << endl; if(testTagSelfFeatures()) succeeded++; else cout << "FAILED!!!" << endl;
@@ -469,6 +1104,14 @@ public:
         done++; cout << "testWSLookupMatchesModel()" << endl; if(testWSLookupMatchesModel()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testTagLookupMatchesModel()" << endl; if(testTagLookupMatchesModel()) succeeded++; else cout << "FAILED!!!" << endl;
         done++; cout << "testFeatureLookupDictionary()" << endl; if(testFeatureLookupDictionary()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryDenseGotos()" << endl; if(testDictionaryDenseGotos()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryBuildList()" << endl; if(testDictionaryBuildList()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryCompiled()" << endl; if(testDictionaryCompiled()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryOutputLinks()" << endl; if(testDictionaryOutputLinks()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryCompactEntries()" << endl; if(testDictionaryCompactEntries()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testDictionaryArena()" << endl; if(testDictionaryArena()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testMappedArena()" << endl; if(testMappedArena()) succeeded++; else cout << "FAILED!!!" << endl;
+        done++; cout << "testLocalModelSharing()" << endl; if(testLocalModelSharing()) succeeded++; else cout << "FAILED!!!" << endl;
         cout << "#### TestKinkaku Finished with "<<succeeded<<"/"<<done<<" tests succeeding ####"<<endl;
         return (done == succeeded);
     }